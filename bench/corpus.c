@@ -0,0 +1,133 @@
+#include "corpus.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    size_t capacity;
+} CorpusBuffer;
+
+static void corpus_reserve(CorpusBuffer *buffer, size_t extra)
+{
+    if (buffer->size + extra + 1 <= buffer->capacity)
+    {
+        return;
+    }
+    size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+    while (capacity < buffer->size + extra + 1)
+    {
+        capacity *= 2;
+    }
+    char *data = (char *)realloc(buffer->data, capacity);
+    if (data == NULL)
+    {
+        fprintf(stderr, "Out of memory while generating the corpus\n");
+        exit(EXIT_FAILURE);
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+}
+
+static void corpus_append(CorpusBuffer *buffer, const char *text, size_t length)
+{
+    corpus_reserve(buffer, length);
+    memcpy(buffer->data + buffer->size, text, length);
+    buffer->size += length;
+    buffer->data[buffer->size] = '\0';
+}
+
+static void corpus_append_string(CorpusBuffer *buffer, const char *text)
+{
+    corpus_append(buffer, text, strlen(text));
+}
+
+static void corpus_append_repeated(CorpusBuffer *buffer, char c, size_t count)
+{
+    corpus_reserve(buffer, count);
+    memset(buffer->data + buffer->size, c, count);
+    buffer->size += count;
+    buffer->data[buffer->size] = '\0';
+}
+
+static uint64_t corpus_random(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static void corpus_append_function_name(CorpusBuffer *buffer, const CorpusOptions *options, size_t index)
+{
+    char name[32];
+    int length = snprintf(name, sizeof(name), "u%zufn%zu", options->unit, index);
+    corpus_append(buffer, name, (size_t)length);
+    // Pad long identifiers after the unique prefix so every name stays distinct.
+    if (options->identifier_length > (size_t)length)
+    {
+        corpus_append_repeated(buffer, 'x', options->identifier_length - (size_t)length);
+    }
+}
+
+static void corpus_append_literal(CorpusBuffer *buffer, const CorpusOptions *options, uint64_t *state)
+{
+    char digits[8];
+    int length = snprintf(digits, sizeof(digits), "%u", (unsigned)(corpus_random(state) % 256));
+    // Huge literals are zero-padded so their value still fits the return type.
+    if (options->literal_digits > (size_t)length)
+    {
+        corpus_append_repeated(buffer, '0', options->literal_digits - (size_t)length);
+    }
+    corpus_append(buffer, digits, (size_t)length);
+}
+
+static void corpus_append_expression(CorpusBuffer *buffer, const CorpusOptions *options, size_t depth, uint64_t *state)
+{
+    // Wrapping uint8 operators, which always type-check and never fail to fold.
+    static const char *const operators[] = {" + ", " - ", " * ", " & ", " | ", " ^ "};
+    if (depth == 0)
+    {
+        corpus_append_literal(buffer, options, state);
+        return;
+    }
+    corpus_append_string(buffer, "(");
+    corpus_append_expression(buffer, options, depth - 1, state);
+    corpus_append_string(buffer, operators[corpus_random(state) % (sizeof(operators) / sizeof(operators[0]))]);
+    corpus_append_expression(buffer, options, depth - 1, state);
+    corpus_append_string(buffer, ")");
+}
+
+char *corpus_generate(const CorpusOptions *options, size_t *size)
+{
+    CorpusBuffer buffer = {NULL, 0, 0};
+    uint64_t state = options->seed != 0 ? options->seed : 0x9E3779B97F4A7C15ull;
+    size_t statements = options->statements == 0 ? 1 : options->statements;
+
+    for (size_t f = 0; f < options->functions; f++)
+    {
+        // Exported so the optimizer cannot discard the otherwise unused functions.
+        corpus_append_string(&buffer, "export ");
+        corpus_append_function_name(&buffer, options, f);
+        corpus_append_string(&buffer, "() -> uint8\n{\n");
+        for (size_t s = 0; s < statements; s++)
+        {
+            corpus_append_string(&buffer, "    return ");
+            corpus_append_expression(&buffer, options, options->expression_depth, &state);
+            corpus_append_string(&buffer, ";\n");
+        }
+        corpus_append_string(&buffer, "}\n\n");
+    }
+    if (options->with_main)
+    {
+        corpus_append_string(&buffer, "main() -> uint8\n{\n    return 0;\n}\n");
+    }
+
+    corpus_reserve(&buffer, 0);
+    *size = buffer.size;
+    return buffer.data;
+}
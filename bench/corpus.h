@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    size_t functions;
+    size_t statements;
+    size_t identifier_length;
+    size_t literal_digits;
+    // Each returned value is a full binary expression tree this deep; 0 returns a literal.
+    size_t expression_depth;
+    // Distinguishes function names between files linked into one program.
+    size_t unit;
+    uint8_t with_main;
+    uint64_t seed;
+} CorpusOptions;
+
+// Generates one synthetic .jpp translation unit. The result is NUL-terminated and
+// owned by the caller.
+char *corpus_generate(const CorpusOptions *options, size_t *size);
@@ -0,0 +1,410 @@
+#include "corpus.h"
+#include "ast.h"
+#include "driver.h"
+#include "lexer.h"
+#include "llvm.h"
+#include "log.h"
+#include "source.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <direct.h>
+#include <windows.h>
+#define MKDIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#define MKDIR(path) mkdir(path, 0755)
+#endif
+
+#define BENCH_DIRECTORY "build/bench"
+#define BENCH_PATH_SIZE 512
+
+typedef struct
+{
+    CorpusOptions corpus;
+    size_t files;
+    size_t repeat;
+    size_t warmup;
+    size_t jobs;
+    OptLevel opt_level;
+    uint8_t skip_e2e;
+    const char *generate_only;
+} BenchOptions;
+
+typedef struct
+{
+    const char *name;
+    const char *unit;
+    double *samples;
+    size_t count;
+} BenchResult;
+
+static double bench_now(void)
+{
+#ifdef PLATFORM_WINDOWS
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+static int compare_doubles(const void *left, const void *right)
+{
+    double a = *(const double *)left;
+    double b = *(const double *)right;
+    return (a > b) - (a < b);
+}
+
+static void print_result(const BenchResult *result)
+{
+    double *sorted = (double *)malloc(result->count * sizeof(double));
+    memcpy(sorted, result->samples, result->count * sizeof(double));
+    qsort(sorted, result->count, sizeof(double), compare_doubles);
+
+    double mean = 0.0;
+    for (size_t i = 0; i < result->count; i++)
+    {
+        mean += sorted[i];
+    }
+    mean /= (double)result->count;
+    double variance = 0.0;
+    for (size_t i = 0; i < result->count; i++)
+    {
+        variance += (sorted[i] - mean) * (sorted[i] - mean);
+    }
+    double stddev = result->count > 1 ? sqrt(variance / (double)(result->count - 1)) : 0.0;
+    double median = result->count % 2 == 1 ? sorted[result->count / 2] : (sorted[result->count / 2 - 1] + sorted[result->count / 2]) / 2.0;
+
+    printf("%-12s %-14s %14.4g %14.4g %14.4g %14.4g %7.2f%%\n", result->name, result->unit, sorted[0], median, mean,
+           sorted[result->count - 1], mean > 0.0 ? 100.0 * stddev / mean : 0.0);
+    free(sorted);
+}
+
+static size_t count_functions(const ASTNode *root)
+{
+    if (root != NULL && root->type == AST_TRANSLATION_UNIT)
+    {
+        return ((const TranslationUnitASTNode *)root)->function_count;
+    }
+    return root != NULL && root->type == AST_FUNCTION ? 1 : 0;
+}
+
+static void bench_lexer(const BenchOptions *options, const SourceBuffer *source, double *tokens_per_second, double *megabytes_per_second)
+{
+    for (size_t r = 0; r < options->warmup + options->repeat; r++)
+    {
+        TokenStream stream;
+        double start = bench_now();
+        if (Lexer_build_from_buffer(source, &stream) != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Lexing the corpus failed\n");
+            exit(EXIT_FAILURE);
+        }
+        double elapsed = bench_now() - start;
+        if (r >= options->warmup)
+        {
+            tokens_per_second[r - options->warmup] = (double)stream.count / elapsed;
+            megabytes_per_second[r - options->warmup] = (double)source->size / elapsed / (1024.0 * 1024.0);
+        }
+        token_stream_free(&stream);
+    }
+}
+
+static void bench_parser(const BenchOptions *options, const SourceBuffer *source, double *nodes_per_second)
+{
+    for (size_t r = 0; r < options->warmup + options->repeat; r++)
+    {
+        double start = bench_now();
+        AST *ast = ast_build_from_source(source);
+        double elapsed = bench_now() - start;
+        if (ast == NULL)
+        {
+            fprintf(stderr, "Parsing the corpus failed\n");
+            exit(EXIT_FAILURE);
+        }
+        if (r >= options->warmup)
+        {
+            nodes_per_second[r - options->warmup] = (double)ast->node_count / elapsed;
+        }
+        ast_destroy(ast);
+    }
+}
+
+static void bench_codegen(const BenchOptions *options, const SourceBuffer *source, double *functions_per_second)
+{
+    AST *ast = ast_build_from_source(source);
+    if (ast == NULL)
+    {
+        fprintf(stderr, "Parsing the corpus failed\n");
+        exit(EXIT_FAILURE);
+    }
+    CodegenOptions codegen_options;
+    codegen_options.opt_level = options->opt_level;
+    codegen_options.profile_generate = NULL;
+    codegen_options.profile = NULL;
+    codegen_options.lto = 0;
+    size_t functions = count_functions(ast->root);
+
+    for (size_t r = 0; r < options->warmup + options->repeat; r++)
+    {
+        ObjectBuffer object = {NULL, 0, NULL, NULL};
+        double start = bench_now();
+        if (generate_code_from_ast(ast->root, "jpp_bench", &object, &codegen_options) != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "Code generation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        double elapsed = bench_now() - start;
+        if (r >= options->warmup)
+        {
+            functions_per_second[r - options->warmup] = (double)functions / elapsed;
+        }
+        object_buffer_dispose(&object);
+    }
+    ast_destroy(ast);
+}
+
+static int write_corpus_files(const BenchOptions *options, const char *directory, char **paths)
+{
+    MKDIR("build");
+    MKDIR(directory);
+    for (size_t f = 0; f < options->files; f++)
+    {
+        CorpusOptions corpus = options->corpus;
+        corpus.unit = f;
+        corpus.with_main = f == 0;
+        corpus.seed = options->corpus.seed + f + 1;
+        size_t size = 0;
+        char *source = corpus_generate(&corpus, &size);
+
+        paths[f] = (char *)malloc(BENCH_PATH_SIZE);
+        snprintf(paths[f], BENCH_PATH_SIZE, "%s/unit%zu.jpp", directory, f);
+        FILE *file = fopen(paths[f], "wb");
+        if (file == NULL || fwrite(source, 1, size, file) != size)
+        {
+            fprintf(stderr, "Could not write %s\n", paths[f]);
+            if (file != NULL)
+                fclose(file);
+            free(source);
+            return EXIT_FAILURE;
+        }
+        fclose(file);
+        free(source);
+    }
+    return EXIT_SUCCESS;
+}
+
+static void bench_end_to_end(const BenchOptions *options, char **paths, double *files_per_second)
+{
+    DriverOptions driver;
+    memset(&driver, 0, sizeof(driver));
+    driver.inputs = (const char **)paths;
+    driver.input_count = options->files;
+    driver.output = "jpp_bench_program";
+    driver.jobs = options->jobs;
+    driver.codegen.opt_level = options->opt_level;
+    driver.linker.driver = "gcc";
+    driver.cache.enabled = 0;
+
+    for (size_t r = 0; r < options->warmup + options->repeat; r++)
+    {
+        double start = bench_now();
+        if (driver_compile(&driver) != EXIT_SUCCESS)
+        {
+            fprintf(stderr, "End-to-end compilation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        double elapsed = bench_now() - start;
+        if (r >= options->warmup)
+        {
+            files_per_second[r - options->warmup] = (double)options->files / elapsed;
+        }
+    }
+}
+
+static void print_usage(void)
+{
+    fprintf(stderr, "Usage: jpp_bench [options]\n");
+    fprintf(stderr, "  --functions=N          functions per generated file (default 2000)\n");
+    fprintf(stderr, "  --statements=N         statements per function body (default 4)\n");
+    fprintf(stderr, "  --identifier-length=N  length of generated function names (default 8)\n");
+    fprintf(stderr, "  --literal-digits=N     digits per number literal, zero-padded (default 1)\n");
+    fprintf(stderr, "  --expression-depth=N   depth of the binary expression each statement returns (default 0)\n");
+    fprintf(stderr, "  --files=N              files in the end-to-end corpus (default 16)\n");
+    fprintf(stderr, "  --repeat=N             measured repetitions per benchmark (default 10)\n");
+    fprintf(stderr, "  --warmup=N             unmeasured repetitions first (default 1)\n");
+    fprintf(stderr, "  --seed=N               corpus random seed (default 1)\n");
+    fprintf(stderr, "  -jN                    end-to-end worker threads (default: one per core)\n");
+    fprintf(stderr, "  -O0 -O1 -O2 -O3 -Os    optimization level for codegen (default -O0)\n");
+    fprintf(stderr, "  --skip-e2e             skip the end-to-end benchmark\n");
+    fprintf(stderr, "  --generate=DIR         only write the corpus files to DIR\n");
+    fprintf(stderr, "  -v                     show compiler log messages\n");
+}
+
+static int parse_size(const char *arg, const char *prefix, size_t *value)
+{
+    size_t length = strlen(prefix);
+    if (strncmp(arg, prefix, length) != 0)
+    {
+        return 0;
+    }
+    char *end = NULL;
+    unsigned long long parsed = strtoull(arg + length, &end, 10);
+    if (arg[length] == '\0' || *end != '\0')
+    {
+        fprintf(stderr, "Invalid value in %s\n", arg);
+        exit(EXIT_FAILURE);
+    }
+    *value = (size_t)parsed;
+    return 1;
+}
+
+static void parse_arguments(int argc, char *argv[], BenchOptions *options)
+{
+    options->corpus.functions = 2000;
+    options->corpus.statements = 4;
+    options->corpus.identifier_length = 8;
+    options->corpus.literal_digits = 1;
+    options->corpus.expression_depth = 0;
+    options->corpus.unit = 0;
+    options->corpus.with_main = 1;
+    options->corpus.seed = 1;
+    options->files = 16;
+    options->repeat = 10;
+    options->warmup = 1;
+    options->jobs = 0;
+    options->opt_level = OPT_LEVEL_O0;
+    options->skip_e2e = 0;
+    options->generate_only = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        size_t seed = 0;
+        if (parse_size(arg, "--functions=", &options->corpus.functions) ||
+            parse_size(arg, "--statements=", &options->corpus.statements) ||
+            parse_size(arg, "--identifier-length=", &options->corpus.identifier_length) ||
+            parse_size(arg, "--literal-digits=", &options->corpus.literal_digits) ||
+            parse_size(arg, "--expression-depth=", &options->corpus.expression_depth) ||
+            parse_size(arg, "--files=", &options->files) ||
+            parse_size(arg, "--repeat=", &options->repeat) ||
+            parse_size(arg, "--warmup=", &options->warmup) ||
+            parse_size(arg, "-j", &options->jobs))
+        {
+            continue;
+        }
+        if (parse_size(arg, "--seed=", &seed))
+        {
+            options->corpus.seed = seed;
+        }
+        else if (strcmp(arg, "-O0") == 0)
+            options->opt_level = OPT_LEVEL_O0;
+        else if (strcmp(arg, "-O1") == 0)
+            options->opt_level = OPT_LEVEL_O1;
+        else if (strcmp(arg, "-O2") == 0)
+            options->opt_level = OPT_LEVEL_O2;
+        else if (strcmp(arg, "-O3") == 0)
+            options->opt_level = OPT_LEVEL_O3;
+        else if (strcmp(arg, "-Os") == 0)
+            options->opt_level = OPT_LEVEL_OS;
+        else if (strcmp(arg, "--skip-e2e") == 0)
+            options->skip_e2e = 1;
+        else if (strncmp(arg, "--generate=", 11) == 0 && arg[11] != '\0')
+            options->generate_only = arg + 11;
+        else if (strcmp(arg, "-v") == 0)
+            set_logger_level(LOG_LEVEL_TRACE);
+        else
+        {
+            print_usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (options->repeat == 0 || options->files == 0)
+    {
+        print_usage();
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    init_logger(LOG_LEVEL_ERROR);
+    BenchOptions options;
+    parse_arguments(argc, argv, &options);
+
+    char **paths = (char **)calloc(options.files, sizeof(char *));
+    if (options.generate_only != NULL)
+    {
+        int result = write_corpus_files(&options, options.generate_only, paths);
+        if (result == EXIT_SUCCESS)
+        {
+            printf("Wrote %zu files to %s\n", options.files, options.generate_only);
+        }
+        return result;
+    }
+
+    size_t size = 0;
+    char *corpus = corpus_generate(&options.corpus, &size);
+    SourceBuffer source = {corpus, size, 0};
+    printf("corpus: %zu functions x %zu statements, %.2f MB, lexer kernel: %s\n", options.corpus.functions,
+           options.corpus.statements, (double)size / (1024.0 * 1024.0), lexer_kernel_name());
+    printf("repetitions: %zu (+%zu warmup)\n\n", options.repeat, options.warmup);
+
+    double *lex_tokens = (double *)calloc(options.repeat, sizeof(double));
+    double *lex_bytes = (double *)calloc(options.repeat, sizeof(double));
+    double *parse_nodes = (double *)calloc(options.repeat, sizeof(double));
+    double *codegen_functions = (double *)calloc(options.repeat, sizeof(double));
+    double *e2e_files = (double *)calloc(options.repeat, sizeof(double));
+
+    initialize_llvm_target();
+    bench_lexer(&options, &source, lex_tokens, lex_bytes);
+    bench_parser(&options, &source, parse_nodes);
+    bench_codegen(&options, &source, codegen_functions);
+
+    printf("%-12s %-14s %14s %14s %14s %14s %8s\n", "benchmark", "unit", "min", "median", "mean", "max", "cv");
+    BenchResult results[] = {
+        {"lex", "tokens/s", lex_tokens, options.repeat},
+        {"lex", "MB/s", lex_bytes, options.repeat},
+        {"parse", "nodes/s", parse_nodes, options.repeat},
+        {"codegen", "functions/s", codegen_functions, options.repeat},
+    };
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++)
+    {
+        print_result(&results[i]);
+    }
+
+    int result = EXIT_SUCCESS;
+    if (!options.skip_e2e)
+    {
+        result = write_corpus_files(&options, BENCH_DIRECTORY, paths);
+        if (result == EXIT_SUCCESS)
+        {
+            bench_end_to_end(&options, paths, e2e_files);
+            BenchResult e2e = {"end-to-end", "files/s", e2e_files, options.repeat};
+            print_result(&e2e);
+        }
+    }
+
+    for (size_t f = 0; f < options.files; f++)
+    {
+        free(paths[f]);
+    }
+    free(paths);
+    free(lex_tokens);
+    free(lex_bytes);
+    free(parse_nodes);
+    free(codegen_functions);
+    free(e2e_files);
+    free(corpus);
+    return result;
+}
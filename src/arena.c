@@ -0,0 +1,86 @@
+#include "arena.h"
+#include "log.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + (ARENA_ALIGNMENT - 1)) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+struct ArenaBlock
+{
+    ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    size_t padding;
+    unsigned char data[];
+};
+
+void arena_init(Arena *arena, size_t block_size)
+{
+    arena->head = NULL;
+    arena->block_size = block_size;
+    arena->total_allocated = 0;
+}
+
+static ArenaBlock *arena_add_block(Arena *arena, size_t minimum)
+{
+    size_t capacity = minimum > arena->block_size ? minimum : arena->block_size;
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + capacity);
+    if (block == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while growing arena by %zu bytes", capacity);
+        exit(EXIT_FAILURE);
+    }
+    block->used = 0;
+    block->capacity = capacity;
+
+    // Oversized requests get a dedicated block behind the current one so the
+    // remaining space in the current block is not wasted.
+    if (arena->head != NULL && minimum > arena->block_size)
+    {
+        block->next = arena->head->next;
+        arena->head->next = block;
+    }
+    else
+    {
+        block->next = arena->head;
+        arena->head = block;
+    }
+    arena->total_allocated += capacity;
+    return block;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size = ARENA_ALIGN(size);
+    ArenaBlock *block = arena->head;
+    if (block == NULL || block->capacity - block->used < size)
+    {
+        block = arena_add_block(arena, size);
+    }
+    void *memory = block->data + block->used;
+    block->used += size;
+    return memory;
+}
+
+char *arena_strndup(Arena *arena, const char *text, size_t length)
+{
+    char *copy = (char *)arena_alloc(arena, length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+void arena_destroy(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->total_allocated = 0;
+}
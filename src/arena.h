@@ -0,0 +1,20 @@
+#pragma once
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator that owns everything allocated from it until arena_destroy.
+typedef struct
+{
+    ArenaBlock *head;
+    size_t block_size;
+    size_t total_allocated;
+} Arena;
+
+void arena_init(Arena *arena, size_t block_size);
+
+void *arena_alloc(Arena *arena, size_t size);
+
+char *arena_strndup(Arena *arena, const char *text, size_t length);
+
+void arena_destroy(Arena *arena);
@@ -1,195 +1,1318 @@
 #include "ast.h"
+#include "bounds.h"
+#include "fold.h"
+#include "interface.h"
 #include "lexer.h"
 #include "log.h"
+#include "sema.h"
+#include "source.h"
+#include "timing.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
-ASTNode *parse_function();
-ASTNode *parse_return_statement();
-ASTNode *parse_literal();
+ASTNode *parse_return_statement(Parser *parser);
+ASTNode *parse_let_statement(Parser *parser);
+ASTNode *parse_if_statement(Parser *parser);
+ASTNode *parse_while_statement(Parser *parser);
+ASTNode *parse_for_statement(Parser *parser);
+ASTNode *parse_assignment(Parser *parser);
+ASTNode *parse_delete_statement(Parser *parser);
+static int expect_token(Parser *parser, Token type, const char *what);
+static const Type *parse_type(Parser *parser);
+ASTNode *parse_cast(Parser *parser);
+ASTNode *parse_unary(Parser *parser);
+ASTNode *parse_postfix(Parser *parser);
+ASTNode *parse_primary(Parser *parser);
+ASTNode *parse_array_literal(Parser *parser);
+ASTNode *parse_new(Parser *parser);
+ASTNode *parse_call(Parser *parser);
+ASTNode *parse_vector(Parser *parser);
+ASTNode *parse_literal(Parser *parser);
 
-ASTNode *ast_build_from_file(char *file)
+static TokenData next_token(Parser *parser)
 {
-    FILE *file_ptr;
-    file_ptr = fopen(file, "r");
-    if (file_ptr == NULL)
+    TokenData token = parser->stream->tokens[parser->position];
+    // The stream always ends in TOKEN_EOF, so the cursor never moves past it.
+    if (token.type != TOKEN_EOF)
     {
-        log_message(LOG_LEVEL_ERROR, "Could not open file %s", file);
+        parser->position++;
+    }
+    return token;
+}
+
+static const TokenData *peek_token(const Parser *parser)
+{
+    return &parser->stream->tokens[parser->position];
+}
+
+// Nodes are stamped with the line of the token consumed last, which is the token
+// that introduced them.
+static void *ast_alloc(Parser *parser, size_t size)
+{
+    parser->ast->node_count++;
+    ASTNode *node = (ASTNode *)arena_alloc(&parser->ast->arena, size);
+    node->line = parser->position > 0 ? parser->stream->tokens[parser->position - 1].line : 1;
+    node->value_type = NULL;
+    return node;
+}
+
+static int scratch_push(Parser *parser, ASTNode *node)
+{
+    if (parser->scratch_count == parser->scratch_capacity)
+    {
+        size_t capacity = parser->scratch_capacity == 0 ? 64 : parser->scratch_capacity * 2;
+        ASTNode **scratch = (ASTNode **)realloc(parser->scratch, capacity * sizeof(ASTNode *));
+        if (scratch == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while parsing");
+            return EXIT_FAILURE;
+        }
+        parser->scratch = scratch;
+        parser->scratch_capacity = capacity;
+    }
+    parser->scratch[parser->scratch_count++] = node;
+    return EXIT_SUCCESS;
+}
+
+// Moves everything pushed since `base` into an arena-owned array.
+static ASTNode **scratch_pop(Parser *parser, size_t base, size_t *count)
+{
+    *count = parser->scratch_count - base;
+    ASTNode **nodes = NULL;
+    if (*count > 0)
+    {
+        nodes = (ASTNode **)arena_alloc(&parser->ast->arena, *count * sizeof(ASTNode *));
+        memcpy(nodes, parser->scratch + base, *count * sizeof(ASTNode *));
+    }
+    parser->scratch_count = base;
+    return nodes;
+}
+
+static const char *intern_lexeme(Parser *parser, const TokenData *token)
+{
+    return intern_string(&parser->ast->strings, token_text(parser->stream, token), token->length);
+}
+
+AST *ast_parse_source(const SourceBuffer *source)
+{
+    TokenStream stream;
+    TimingScope lex_timer = timing_begin("lex", NULL);
+    int lexed = Lexer_build_from_buffer(source, &stream);
+    timing_end(&lex_timer);
+    if (lexed != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+
+    AST *ast = (AST *)malloc(sizeof(AST));
+    if (ast == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while allocating the AST");
+        token_stream_free(&stream);
         return NULL;
     }
+    // Nodes are small, so size the first block by the amount of source rather than
+    // starting tiny and chaining many blocks for large inputs.
+    size_t block_size = source->size < 4096 ? 4096 : source->size;
+    arena_init(&ast->arena, block_size > (1 << 20) ? (1 << 20) : block_size);
+    intern_table_init(&ast->strings, &ast->arena);
+    type_table_init(&ast->types, &ast->arena);
+    ast->root = NULL;
+    ast->node_count = 0;
 
-    char line_buffer[2048];
-    char function_buffer[8192];
-    uint64_t line = 0;
-    ASTNode *ast = NULL;
+    Parser parser = {&stream, 0, ast, NULL, 0, 0};
+    TimingScope parse_timer = timing_begin("parse", NULL);
+    ast->root = parse_translation_unit(&parser);
+    timing_end(&parse_timer);
 
-    function_buffer[0] = '\0';
+    free(parser.scratch);
+    token_stream_free(&stream);
 
-    while (fgets(line_buffer, sizeof(line_buffer), file_ptr) != NULL)
+    if (ast->root == NULL)
     {
-        line += 1;
-        log_message(LOG_LEVEL_TRACE, "Line %llu: %s", line, line_buffer);
+        ast_destroy(ast);
+        return NULL;
+    }
+    return ast;
+}
 
-        if (line_buffer[0] == '\0' || line_buffer[0] == '\n')
+AST *ast_build_with_imports(const SourceBuffer *source, const ImportSet *imports)
+{
+    AST *ast = ast_parse_source(source);
+    if (ast == NULL)
+    {
+        return NULL;
+    }
+    TimingScope import_timer = timing_begin("import", NULL);
+    int imported = resolve_imports(ast, imports);
+    timing_end(&import_timer);
+    if (imported != EXIT_SUCCESS)
+    {
+        ast->root = NULL;
+    }
+
+    if (ast->root != NULL)
+    {
+        TimingScope sema_timer = timing_begin("sema", NULL);
+        int checked = sema_check(ast);
+        timing_end(&sema_timer);
+
+        int result = EXIT_FAILURE;
+        if (checked == EXIT_SUCCESS)
         {
-            log_message(LOG_LEVEL_TRACE, "Skipping empty line %llu", line);
-            continue;
+            TimingScope fold_timer = timing_begin("fold", NULL);
+            result = fold_constants(ast);
+            timing_end(&fold_timer);
         }
+        if (result == EXIT_SUCCESS)
+        {
+            TimingScope bounds_timer = timing_begin("bounds", NULL);
+            result = eliminate_bounds_checks(ast);
+            timing_end(&bounds_timer);
+        }
+        if (result != EXIT_SUCCESS)
+        {
+            ast->root = NULL;
+        }
+    }
+    if (ast->root == NULL)
+    {
+        ast_destroy(ast);
+        return NULL;
+    }
+    log_message(LOG_LEVEL_TRACE, "AST arena holds %zu bytes", ast->arena.total_allocated);
+    return ast;
+}
 
-        strcat(function_buffer, line_buffer);
+AST *ast_build_from_source(const SourceBuffer *source)
+{
+    ImportSet imports;
+    if (import_set_open(source, &imports) != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    AST *ast = ast_build_with_imports(source, &imports);
+    import_set_close(&imports);
+    return ast;
+}
+
+AST *ast_build_from_file(char *file)
+{
+    SourceBuffer source;
+    if (source_buffer_open(file, &source) != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    AST *ast = ast_build_from_source(&source);
+    source_buffer_close(&source);
+    return ast;
+}
+
+void ast_destroy(AST *ast)
+{
+    if (ast == NULL)
+    {
+        return;
+    }
+    intern_table_destroy(&ast->strings);
+    type_table_destroy(&ast->types);
+    arena_destroy(&ast->arena);
+    free(ast);
+}
+
+// import a.b; names the module in a/b.jpp, relative to the working directory.
+static const char *parse_import(Parser *parser)
+{
+    next_token(parser);
+    char path[1024];
+    size_t length = 0;
+    for (;;)
+    {
+        TokenData name = next_token(parser);
+        if (name.type != TOKEN_IDENTIFIER)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Expected a module name at line %u", name.line);
+            return NULL;
+        }
+        if (module_path_append(path, sizeof(path), &length, token_text(parser->stream, &name), name.length) != EXIT_SUCCESS)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Module name is too long at line %u", name.line);
+            return NULL;
+        }
+        if (peek_token(parser)->type != TOKEN_DOT)
+        {
+            break;
+        }
+        next_token(parser);
+    }
+    if (expect_token(parser, TOKEN_SEMICOLON, "';' after an import") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    return intern_string(&parser->ast->strings, path, length + sizeof(".jpp") - 1);
+}
 
-        if (strchr(line_buffer, '}') != NULL)
+static int add_import(Parser *parser, TranslationUnitASTNode *unit, size_t *capacity)
+{
+    const char *path = parse_import(parser);
+    if (path == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < unit->import_count; i++)
+    {
+        if (unit->imports[i] == path)
         {
-            log_message(LOG_LEVEL_TRACE, "End of function found at line %llu", line);
+            return EXIT_SUCCESS;
+        }
+    }
+    if (unit->import_count == *capacity)
+    {
+        *capacity = *capacity == 0 ? 8 : *capacity * 2;
+        const char **imports = (const char **)arena_alloc(&parser->ast->arena, *capacity * sizeof(const char *));
+        if (unit->import_count > 0)
+        {
+            memcpy(imports, unit->imports, unit->import_count * sizeof(const char *));
+        }
+        unit->imports = imports;
+    }
+    unit->imports[unit->import_count++] = path;
+    return EXIT_SUCCESS;
+}
 
-            char *input = function_buffer;
-            ast = parse_function(&input, line);
-            if (ast == NULL)
+ASTNode *parse_translation_unit(Parser *parser)
+{
+    TranslationUnitASTNode *unit = (TranslationUnitASTNode *)ast_alloc(parser, sizeof(TranslationUnitASTNode));
+    unit->base.type = AST_TRANSLATION_UNIT;
+    unit->imports = NULL;
+    unit->import_count = 0;
+    size_t import_capacity = 0;
+
+    size_t base = parser->scratch_count;
+    while (peek_token(parser)->type != TOKEN_EOF)
+    {
+        if (peek_token(parser)->type == TOKEN_IMPORT)
+        {
+            // Imports come first, so the cache can find them without parsing the unit.
+            if (parser->scratch_count > base)
+            {
+                log_message(LOG_LEVEL_ERROR, "Error: Imports must precede the functions at line %u", peek_token(parser)->line);
+                parser->scratch_count = base;
+                return NULL;
+            }
+            if (add_import(parser, unit, &import_capacity) != EXIT_SUCCESS)
             {
-                log_message(LOG_LEVEL_ERROR, "Failed to parse function at line %llu", line);
-                fclose(file_ptr);
+                parser->scratch_count = base;
                 return NULL;
             }
+            continue;
+        }
+        uint32_t line = peek_token(parser)->line;
+        ASTNode *function = parse_function(parser);
+        if (function == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Failed to parse function at line %u", line);
+            parser->scratch_count = base;
+            return NULL;
+        }
+        if (scratch_push(parser, function) != EXIT_SUCCESS)
+        {
+            parser->scratch_count = base;
+            return NULL;
+        }
+    }
+    unit->functions = scratch_pop(parser, base, &unit->function_count);
+    log_message(LOG_LEVEL_TRACE, "Parsed %zu functions and %zu imports", unit->function_count, unit->import_count);
+    return (ASTNode *)unit;
+}
 
-            function_buffer[0] = '\0';
+// Leading keywords: any of export, inline and noinline, or extern for a declaration.
+static int parse_function_flags(Parser *parser, uint32_t *flags)
+{
+    *flags = 0;
+    for (;;)
+    {
+        const TokenData *token = peek_token(parser);
+        uint32_t flag;
+        switch (token->type)
+        {
+        case TOKEN_EXPORT:
+            flag = FUNCTION_EXPORT;
+            break;
+        case TOKEN_EXTERN:
+            flag = FUNCTION_EXTERN;
+            break;
+        case TOKEN_INLINE:
+            flag = FUNCTION_INLINE;
+            break;
+        case TOKEN_NOINLINE:
+            flag = FUNCTION_NOINLINE;
+            break;
+        default:
+            return EXIT_SUCCESS;
         }
+        if (*flags & flag)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Repeated '%.*s' at line %u", (int)token->length, token_text(parser->stream, token), token->line);
+            return EXIT_FAILURE;
+        }
+        *flags |= flag;
+        next_token(parser);
     }
+}
 
-    fclose(file_ptr);
-    return ast;
+static ASTNode *parse_parameter(Parser *parser)
+{
+    TokenData name = next_token(parser);
+    if (name.type != TOKEN_IDENTIFIER)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Expected a parameter name at line %u", name.line);
+        return NULL;
+    }
+    ParameterASTNode *parameter = (ParameterASTNode *)ast_alloc(parser, sizeof(ParameterASTNode));
+    parameter->base.type = AST_PARAMETER;
+    parameter->local.name = intern_lexeme(parser, &name);
+    parameter->local.slot = 0;
+    parameter->local.line = name.line;
+    parameter->local.is_mutable = 1;
+    if (expect_token(parser, TOKEN_COLON, "':'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    parameter->local.type = parse_type(parser);
+    return parameter->local.type != NULL ? (ASTNode *)parameter : NULL;
 }
 
-ASTNode *parse_function(char **input, uint64_t line_number)
+ASTNode *parse_function(Parser *parser)
 {
-    log_message(LOG_LEVEL_TRACE, "Parsing function at line %llu: %s", line_number, *input);
+    uint32_t source_start = peek_token(parser)->offset;
+    uint32_t flags;
+    if (parse_function_flags(parser, &flags) != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
 
-    TokenData token = get_next_token(input, line_number);
-    log_message(LOG_LEVEL_TRACE, "First token (function name): %s (type: %d)", token.lexeme, token.type);
+    TokenData token = next_token(parser);
+    const TokenStream *stream = parser->stream;
+    log_message(LOG_LEVEL_TRACE, "First token (function name): %.*s (type: %d)", (int)token.length, token_text(stream, &token), token.type);
 
     if (token.type != TOKEN_IDENTIFIER)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected function name at line %llu", line_number);
+        log_message(LOG_LEVEL_ERROR, "Error: Expected function name at line %u", token.line);
         return NULL;
     }
 
-    FunctionASTNode *func = (FunctionASTNode *)malloc(sizeof(FunctionASTNode));
+    FunctionASTNode *func = (FunctionASTNode *)ast_alloc(parser, sizeof(FunctionASTNode));
     func->base.type = AST_FUNCTION;
-    func->name = strdup(token.lexeme);
+    func->name = intern_lexeme(parser, &token);
+    func->name_offset = token.offset;
+    func->flags = flags;
 
-    token = get_next_token(input, line_number);
-    log_message(LOG_LEVEL_TRACE, "Next token (expect '('): %s (type: %d)", token.lexeme, token.type);
+    token = next_token(parser);
+    log_message(LOG_LEVEL_TRACE, "Next token (expect '('): %.*s (type: %d)", (int)token.length, token_text(stream, &token), token.type);
     if (token.type != TOKEN_LPAREN)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected '(' at line %llu", line_number);
+        log_message(LOG_LEVEL_ERROR, "Error: Expected '(' at line %u", token.line);
         return NULL;
     }
 
-    token = get_next_token(input, line_number);
-    log_message(LOG_LEVEL_TRACE, "Next token (expect ')'): %s (type: %d)", token.lexeme, token.type);
-    if (token.type != TOKEN_RPAREN)
+    size_t base = parser->scratch_count;
+    while (peek_token(parser)->type != TOKEN_RPAREN)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected ')' at line %llu", line_number);
-        return NULL;
+        if (parser->scratch_count > base && expect_token(parser, TOKEN_COMMA, "',' or ')'") != EXIT_SUCCESS)
+        {
+            parser->scratch_count = base;
+            return NULL;
+        }
+        if (parser->scratch_count - base == FUNCTION_MAX_PARAMETERS)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Function '%s' has more than %d parameters", func->name, FUNCTION_MAX_PARAMETERS);
+            parser->scratch_count = base;
+            return NULL;
+        }
+        ASTNode *parameter = parse_parameter(parser);
+        if (parameter == NULL || scratch_push(parser, parameter) != EXIT_SUCCESS)
+        {
+            parser->scratch_count = base;
+            return NULL;
+        }
     }
+    next_token(parser);
+    func->parameters = scratch_pop(parser, base, &func->parameter_count);
 
-    token = get_next_token(input, line_number);
-    log_message(LOG_LEVEL_TRACE, "Next token (expect '->'): %s (type: %d)", token.lexeme, token.type);
+    token = next_token(parser);
+    log_message(LOG_LEVEL_TRACE, "Next token (expect '->'): %.*s (type: %d)", (int)token.length, token_text(stream, &token), token.type);
     if (token.type != TOKEN_ARROW)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected '->' at line %llu", line_number);
+        log_message(LOG_LEVEL_ERROR, "Error: Expected '->' at line %u", token.line);
         return NULL;
     }
 
-    token = get_next_token(input, line_number);
-    log_message(LOG_LEVEL_TRACE, "Next token (expect return type): %s (type: %d)", token.lexeme, token.type);
-    if (token.type != TOKEN_TYPE)
+    func->return_type = parse_type(parser);
+    if (func->return_type == NULL)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected return type at line %llu", line_number);
         return NULL;
     }
-    func->return_type = strdup(token.lexeme);
 
-    token = get_next_token(input, line_number);
-    log_message(LOG_LEVEL_TRACE, "Next token (expect '{'): %s (type: %d)", token.lexeme, token.type);
+    func->locals = NULL;
+    func->local_count = 0;
+    func->callees = NULL;
+    func->callee_count = 0;
+    func->inline_callees = NULL;
+    func->inline_callee_count = 0;
+    func->body = NULL;
+    const TokenData *signature_last = &stream->tokens[parser->position - 1];
+    func->signature_end = signature_last->offset + signature_last->length;
+    if (flags & FUNCTION_EXTERN)
+    {
+        if (expect_token(parser, TOKEN_SEMICOLON, "';' after an extern declaration") != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        func->body = parse_block(parser);
+        if (func->body == NULL)
+        {
+            return NULL;
+        }
+    }
+    const TokenData *last = &stream->tokens[parser->position - 1];
+    func->end_offset = last->offset + last->length;
+    func->source_hash = hash_bytes(stream->source + source_start, func->end_offset - source_start);
+
+    log_message(LOG_LEVEL_TRACE, "Function successfully parsed: %s", func->name);
+    return (ASTNode *)func;
+}
+
+ASTNode *parse_block(Parser *parser)
+{
+    TokenData token = next_token(parser);
+    log_message(LOG_LEVEL_TRACE, "Next token (expect '{'): %.*s (type: %d)", (int)token.length, token_text(parser->stream, &token), token.type);
     if (token.type != TOKEN_LBRACE)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected '{' at line %llu", line_number);
+        log_message(LOG_LEVEL_ERROR, "Error: Expected '{' at line %u", token.line);
         return NULL;
     }
 
-    log_message(LOG_LEVEL_TRACE, "Parsing function body at line %llu", line_number);
-    func->body = NULL;
-    while (1)
+    BlockASTNode *block = (BlockASTNode *)ast_alloc(parser, sizeof(BlockASTNode));
+    block->base.type = AST_BLOCK;
+
+    size_t base = parser->scratch_count;
+    while (peek_token(parser)->type != TOKEN_RBRACE)
     {
-        token = get_next_token(input, line_number);
-        log_message(LOG_LEVEL_TRACE, "Got token: %s (type: %d)", token.lexeme, token.type);
+        ASTNode *statement = parse_statement(parser);
+        if (statement == NULL || scratch_push(parser, statement) != EXIT_SUCCESS)
+        {
+            parser->scratch_count = base;
+            return NULL;
+        }
+    }
+    token = next_token(parser);
+    log_message(LOG_LEVEL_TRACE, "Block parsed, closing brace '}' found at line %u", token.line);
+
+    block->statements = scratch_pop(parser, base, &block->statement_count);
+    return (ASTNode *)block;
+}
 
-        if (token.type == TOKEN_RBRACE)
+static int expect_token(Parser *parser, Token type, const char *what)
+{
+    TokenData token = next_token(parser);
+    if (token.type != type)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Expected %s at line %u, found '%.*s'", what, token.line, (int)token.length, token_text(parser->stream, &token));
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+ASTNode *parse_statement(Parser *parser)
+{
+    TokenData token = *peek_token(parser);
+    log_message(LOG_LEVEL_TRACE, "Got token: %.*s (type: %d)", (int)token.length, token_text(parser->stream, &token), token.type);
+
+    ASTNode *statement = NULL;
+    switch (token.type)
+    {
+    case TOKEN_RETURN:
+        next_token(parser);
+        statement = parse_return_statement(parser);
+        if (statement == NULL)
         {
-            log_message(LOG_LEVEL_TRACE, "Function body parsed, closing brace '}' found at line %llu", line_number);
-            break;
+            log_message(LOG_LEVEL_ERROR, "Failed to parse return statement at line %u", token.line);
         }
-        else if (token.type == TOKEN_RETURN)
+        return statement;
+    case TOKEN_LET:
+        next_token(parser);
+        return parse_let_statement(parser);
+    case TOKEN_LBRACE:
+        return parse_block(parser);
+    case TOKEN_IF:
+        next_token(parser);
+        return parse_if_statement(parser);
+    case TOKEN_WHILE:
+        next_token(parser);
+        return parse_while_statement(parser);
+    case TOKEN_FOR:
+        next_token(parser);
+        return parse_for_statement(parser);
+    case TOKEN_BREAK:
+    case TOKEN_CONTINUE:
+    {
+        next_token(parser);
+        ASTNode *jump = (ASTNode *)ast_alloc(parser, sizeof(ASTNode));
+        jump->type = token.type == TOKEN_BREAK ? AST_BREAK : AST_CONTINUE;
+        return expect_token(parser, TOKEN_SEMICOLON, "';'") == EXIT_SUCCESS ? jump : NULL;
+    }
+    case TOKEN_DELETE:
+        next_token(parser);
+        return parse_delete_statement(parser);
+    case TOKEN_IDENTIFIER:
+    {
+        Token following = parser->stream->tokens[parser->position + 1].type;
+        if (following == TOKEN_ASSIGN || following == TOKEN_LBRACKET)
         {
-            log_message(LOG_LEVEL_TRACE, "Return statement found at line %llu", line_number);
-
-            func->body = parse_return_statement(input, line_number);
-            if (func->body == NULL)
+            return parse_assignment(parser);
+        }
+        if (following == TOKEN_LPAREN)
+        {
+            ExpressionASTNode *node = (ExpressionASTNode *)ast_alloc(parser, sizeof(ExpressionASTNode));
+            node->base.type = AST_EXPRESSION;
+            node->base.line = token.line;
+            node->expression = parse_expression(parser);
+            if (node->expression == NULL || expect_token(parser, TOKEN_SEMICOLON, "';'") != EXIT_SUCCESS)
             {
-                log_message(LOG_LEVEL_ERROR, "Failed to parse return statement");
                 return NULL;
             }
+            return (ASTNode *)node;
+        }
+        break;
+    }
+    case TOKEN_EOF:
+        log_message(LOG_LEVEL_ERROR, "Error: Unexpected end of file, expected '}'");
+        return NULL;
+    default:
+        break;
+    }
+    log_message(LOG_LEVEL_ERROR, "Error: Unexpected token '%.*s' in function body at line %u", (int)token.length, token_text(parser->stream, &token), token.line);
+    return NULL;
+}
+
+ASTNode *parse_let_statement(Parser *parser)
+{
+    TokenData name = next_token(parser);
+    if (name.type != TOKEN_IDENTIFIER)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Expected a variable name after 'let' at line %u", name.line);
+        return NULL;
+    }
+
+    LetASTNode *let = (LetASTNode *)ast_alloc(parser, sizeof(LetASTNode));
+    let->base.type = AST_LET;
+    let->local.name = intern_lexeme(parser, &name);
+    let->local.type = NULL;
+    let->local.slot = 0;
+    let->local.line = name.line;
+    let->local.is_mutable = 1;
+    let->declared_type = NULL;
+
+    if (peek_token(parser)->type == TOKEN_COLON)
+    {
+        next_token(parser);
+        let->declared_type = parse_type(parser);
+        if (let->declared_type == NULL)
+        {
+            return NULL;
+        }
+    }
+    if (expect_token(parser, TOKEN_ASSIGN, "'='") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    let->value = parse_expression(parser);
+    if (let->value == NULL || expect_token(parser, TOKEN_SEMICOLON, "';'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    return (ASTNode *)let;
+}
+
+ASTNode *parse_if_statement(Parser *parser)
+{
+    IfASTNode *node = (IfASTNode *)ast_alloc(parser, sizeof(IfASTNode));
+    node->base.type = AST_IF;
+    node->else_branch = NULL;
+    node->condition = parse_expression(parser);
+    if (node->condition == NULL)
+    {
+        return NULL;
+    }
+    node->then_block = parse_block(parser);
+    if (node->then_block == NULL)
+    {
+        return NULL;
+    }
+    if (peek_token(parser)->type == TOKEN_ELSE)
+    {
+        next_token(parser);
+        if (peek_token(parser)->type == TOKEN_IF)
+        {
+            next_token(parser);
+            node->else_branch = parse_if_statement(parser);
         }
         else
         {
-            log_message(LOG_LEVEL_ERROR, "Error: Unexpected token '%s' in function body at line %llu", token.lexeme, line_number);
+            node->else_branch = parse_block(parser);
+        }
+        if (node->else_branch == NULL)
+        {
             return NULL;
         }
     }
+    return (ASTNode *)node;
+}
 
-    log_message(LOG_LEVEL_INFO, "Function successfully parsed at line %llu: %s", line_number, func->name);
-    return (ASTNode *)func;
+ASTNode *parse_while_statement(Parser *parser)
+{
+    WhileASTNode *node = (WhileASTNode *)ast_alloc(parser, sizeof(WhileASTNode));
+    node->base.type = AST_WHILE;
+    node->condition = parse_expression(parser);
+    if (node->condition == NULL)
+    {
+        return NULL;
+    }
+    node->body = parse_block(parser);
+    return node->body != NULL ? (ASTNode *)node : NULL;
+}
+
+ASTNode *parse_for_statement(Parser *parser)
+{
+    ForASTNode *node = (ForASTNode *)ast_alloc(parser, sizeof(ForASTNode));
+    node->base.type = AST_FOR;
+
+    TokenData name = next_token(parser);
+    if (name.type != TOKEN_IDENTIFIER)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Expected a loop variable after 'for' at line %u", name.line);
+        return NULL;
+    }
+    node->variable.name = intern_lexeme(parser, &name);
+    node->variable.type = NULL;
+    node->variable.slot = 0;
+    node->variable.line = name.line;
+    node->variable.is_mutable = 0;
+
+    if (expect_token(parser, TOKEN_IN, "'in'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    node->start = parse_expression(parser);
+    if (node->start == NULL || expect_token(parser, TOKEN_DOT_DOT, "'..'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    node->end = parse_expression(parser);
+    if (node->end == NULL)
+    {
+        return NULL;
+    }
+    node->body = parse_block(parser);
+    return node->body != NULL ? (ASTNode *)node : NULL;
+}
+
+ASTNode *parse_assignment(Parser *parser)
+{
+    ASTNode *target = parse_postfix(parser);
+    if (target == NULL || expect_token(parser, TOKEN_ASSIGN, "'='") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    AssignASTNode *assign = (AssignASTNode *)ast_alloc(parser, sizeof(AssignASTNode));
+    assign->base.type = AST_ASSIGN;
+    assign->target = target;
+    assign->value = parse_expression(parser);
+    if (assign->value == NULL || expect_token(parser, TOKEN_SEMICOLON, "';'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    return (ASTNode *)assign;
 }
 
-ASTNode *parse_return_statement(char **input, uint64_t line_number)
+ASTNode *parse_delete_statement(Parser *parser)
 {
-    log_message(LOG_LEVEL_TRACE, "Parsing return statement at line %llu, input: '%s'", line_number, *input);
+    DeleteASTNode *node = (DeleteASTNode *)ast_alloc(parser, sizeof(DeleteASTNode));
+    node->base.type = AST_DELETE;
+    node->value = parse_expression(parser);
+    if (node->value == NULL || expect_token(parser, TOKEN_SEMICOLON, "';'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    return (ASTNode *)node;
+}
 
-    ReturnASTNode *ret = (ReturnASTNode *)malloc(sizeof(ReturnASTNode));
+ASTNode *parse_return_statement(Parser *parser)
+{
+    log_message(LOG_LEVEL_TRACE, "Parsing return statement at line %u", peek_token(parser)->line);
+
+    ReturnASTNode *ret = (ReturnASTNode *)ast_alloc(parser, sizeof(ReturnASTNode));
     ret->base.type = AST_RETURN;
 
-    ret->value = parse_literal(input, line_number);
+    ret->value = parse_expression(parser);
     if (ret->value == NULL)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected a literal value after 'return'");
         return NULL;
     }
 
-    TokenData token = get_next_token(input, line_number);
-    log_message(LOG_LEVEL_TRACE, "Next token after return value: %d with lexeme '%s'", token.type, token.lexeme);
+    TokenData token = next_token(parser);
+    log_message(LOG_LEVEL_TRACE, "Next token after return value: %d with lexeme '%.*s'", token.type, (int)token.length, token_text(parser->stream, &token));
 
     if (token.type != TOKEN_SEMICOLON)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected ';'");
+        log_message(LOG_LEVEL_ERROR, "Error: Expected ';' at line %u", token.line);
         return NULL;
     }
 
     return (ASTNode *)ret;
 }
 
-ASTNode *parse_literal(char **input, uint64_t line_number)
+// Binding strength of a binary operator token, or 0 if the token is not one.
+// Higher binds tighter; all binary operators are left-associative.
+static int binary_precedence(Token type, BinaryOperator *op)
 {
-    TokenData token = get_next_token(input, line_number);
+    switch (type)
+    {
+    case TOKEN_PIPE:
+        *op = BINARY_OR;
+        return 1;
+    case TOKEN_CARET:
+        *op = BINARY_XOR;
+        return 2;
+    case TOKEN_AMPERSAND:
+        *op = BINARY_AND;
+        return 3;
+    case TOKEN_EQUAL_EQUAL:
+        *op = BINARY_EQ;
+        return 4;
+    case TOKEN_NOT_EQUAL:
+        *op = BINARY_NE;
+        return 4;
+    case TOKEN_LESS:
+        *op = BINARY_LT;
+        return 5;
+    case TOKEN_LESS_EQUAL:
+        *op = BINARY_LE;
+        return 5;
+    case TOKEN_GREATER:
+        *op = BINARY_GT;
+        return 5;
+    case TOKEN_GREATER_EQUAL:
+        *op = BINARY_GE;
+        return 5;
+    case TOKEN_SHIFT_LEFT:
+        *op = BINARY_SHL;
+        return 6;
+    case TOKEN_SHIFT_RIGHT:
+        *op = BINARY_SHR;
+        return 6;
+    case TOKEN_PLUS:
+        *op = BINARY_ADD;
+        return 7;
+    case TOKEN_MINUS:
+        *op = BINARY_SUB;
+        return 7;
+    case TOKEN_STAR:
+        *op = BINARY_MUL;
+        return 8;
+    case TOKEN_SLASH:
+        *op = BINARY_DIV;
+        return 8;
+    case TOKEN_PERCENT:
+        *op = BINARY_REM;
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+// Precedence climbing: parses operators binding at least as tightly as
+// `min_precedence`, recursing one level up for each right operand.
+static ASTNode *parse_binary(Parser *parser, int min_precedence)
+{
+    ASTNode *left = parse_cast(parser);
+    if (left == NULL)
+    {
+        return NULL;
+    }
+
+    BinaryOperator op;
+    int precedence;
+    while ((precedence = binary_precedence(peek_token(parser)->type, &op)) >= min_precedence && precedence > 0)
+    {
+        next_token(parser);
+        BinaryASTNode *binary = (BinaryASTNode *)ast_alloc(parser, sizeof(BinaryASTNode));
+        binary->base.type = AST_BINARY;
+        binary->op = op;
+        binary->left = left;
+        binary->right = parse_binary(parser, precedence + 1);
+        if (binary->right == NULL)
+        {
+            return NULL;
+        }
+        left = (ASTNode *)binary;
+    }
+    return left;
+}
+
+ASTNode *parse_expression(Parser *parser)
+{
+    return parse_binary(parser, 1);
+}
+
+static int parse_integer_digits(const TokenData *token, const char *digits, uint64_t *value)
+{
+    *value = 0;
+    for (uint32_t i = 0; i < token->length; i++)
+    {
+        uint64_t digit = (uint64_t)(digits[i] - '0');
+        if (*value > (UINT64_MAX - digit) / 10)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Number literal %.*s at line %u is too large", (int)token->length, digits, token->line);
+            return EXIT_FAILURE;
+        }
+        *value = *value * 10 + digit;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Array lengths and repeat counts are integer literals, known while parsing.
+static int parse_length(Parser *parser, uint64_t *length)
+{
+    TokenData token = next_token(parser);
     if (token.type != TOKEN_NUMBER_LITERAL)
     {
-        log_message(LOG_LEVEL_ERROR, "Error: Expected a literal value");
+        log_message(LOG_LEVEL_ERROR, "Error: Expected an array length at line %u, found '%.*s'", token.line, (int)token.length, token_text(parser->stream, &token));
+        return EXIT_FAILURE;
+    }
+    if (parse_integer_digits(&token, token_text(parser->stream, &token), length) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (*length > UINT32_MAX)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Array length %llu at line %u is too large", (unsigned long long)*length, token.line);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// A type keyword, [element; length] for an array or [element] for a slice.
+// vec and a lane count followed by '<', as in vec4<f32>, starts a vector type.
+// Without the '<', names like vec2 stay ordinary identifiers.
+static int is_vector_type(const Parser *parser, size_t position)
+{
+    const TokenData *token = &parser->stream->tokens[position];
+    if (token->type != TOKEN_IDENTIFIER || token->length <= 3 || memcmp(token_text(parser->stream, token), "vec", 3) != 0)
+    {
+        return 0;
+    }
+    const char *text = token_text(parser->stream, token);
+    for (uint32_t i = 3; i < token->length; i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+        {
+            return 0;
+        }
+    }
+    return parser->stream->tokens[position + 1].type == TOKEN_LESS;
+}
+
+static const Type *parse_type(Parser *parser)
+{
+    TokenData token = next_token(parser);
+    if (token.type == TOKEN_LBRACKET)
+    {
+        const Type *element = parse_type(parser);
+        if (element == NULL)
+        {
+            return NULL;
+        }
+        if (element->kind == TYPE_SLICE)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Slices cannot hold slices at line %u", token.line);
+            return NULL;
+        }
+        if (peek_token(parser)->type == TOKEN_RBRACKET)
+        {
+            next_token(parser);
+            return type_slice(&parser->ast->types, element);
+        }
+        uint64_t length;
+        if (expect_token(parser, TOKEN_SEMICOLON, "';' or ']'") != EXIT_SUCCESS || parse_length(parser, &length) != EXIT_SUCCESS || expect_token(parser, TOKEN_RBRACKET, "']'") != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+        return type_array(&parser->ast->types, element, length);
+    }
+    if (is_vector_type(parser, parser->position - 1))
+    {
+        uint64_t lanes = 0;
+        const char *text = token_text(parser->stream, &token);
+        for (uint32_t i = 3; i < token.length && lanes <= 64; i++)
+        {
+            lanes = lanes * 10 + (uint64_t)(text[i] - '0');
+        }
+        if (!type_is_valid_lane_count(lanes))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Vectors have 2, 4, 8, 16, 32 or 64 lanes, not '%.*s', at line %u", (int)token.length, text, token.line);
+            return NULL;
+        }
+        if (expect_token(parser, TOKEN_LESS, "'<'") != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+        const Type *element = parse_type(parser);
+        if (element == NULL || expect_token(parser, TOKEN_GREATER, "'>'") != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+        if (!type_is_scalar(element))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Vector lanes must be numbers or bool, not %s, at line %u", element->name, token.line);
+            return NULL;
+        }
+        return type_vector(&parser->ast->types, element, lanes);
+    }
+    if (token.type != TOKEN_TYPE)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Expected a type at line %u, found '%.*s'", token.line, (int)token.length, token_text(parser->stream, &token));
+        return NULL;
+    }
+    return type_lookup(token_text(parser->stream, &token), token.length);
+}
+
+// `as` binds tighter than every binary operator but looser than unary ones, so
+// -x as int64 converts the negated value.
+ASTNode *parse_cast(Parser *parser)
+{
+    ASTNode *operand = parse_unary(parser);
+    while (operand != NULL && peek_token(parser)->type == TOKEN_AS)
+    {
+        next_token(parser);
+        CastASTNode *cast = (CastASTNode *)ast_alloc(parser, sizeof(CastASTNode));
+        cast->base.type = AST_CAST;
+        cast->operand = operand;
+        cast->target_type = parse_type(parser);
+        if (cast->target_type == NULL)
+        {
+            return NULL;
+        }
+        operand = (ASTNode *)cast;
+    }
+    return operand;
+}
+
+ASTNode *parse_unary(Parser *parser)
+{
+    UnaryOperator op;
+    switch (peek_token(parser)->type)
+    {
+    case TOKEN_MINUS:
+        op = UNARY_NEGATE;
+        break;
+    case TOKEN_TILDE:
+        op = UNARY_BIT_NOT;
+        break;
+    case TOKEN_BANG:
+        op = UNARY_NOT;
+        break;
+    default:
+        return parse_postfix(parser);
+    }
+
+    next_token(parser);
+    UnaryASTNode *unary = (UnaryASTNode *)ast_alloc(parser, sizeof(UnaryASTNode));
+    unary->base.type = AST_UNARY;
+    unary->op = op;
+    unary->operand = parse_unary(parser);
+    return unary->operand != NULL ? (ASTNode *)unary : NULL;
+}
+
+// Indexing, a[i], and slicing, a[lo..hi] with either bound optional.
+ASTNode *parse_postfix(Parser *parser)
+{
+    ASTNode *node = parse_primary(parser);
+    while (node != NULL && peek_token(parser)->type == TOKEN_LBRACKET)
+    {
+        next_token(parser);
+        ASTNode *start = NULL;
+        if (peek_token(parser)->type != TOKEN_DOT_DOT)
+        {
+            start = parse_expression(parser);
+            if (start == NULL)
+            {
+                return NULL;
+            }
+        }
+        if (start != NULL && peek_token(parser)->type == TOKEN_RBRACKET)
+        {
+            next_token(parser);
+            IndexASTNode *index = (IndexASTNode *)ast_alloc(parser, sizeof(IndexASTNode));
+            index->base.type = AST_INDEX;
+            index->sequence = node;
+            index->index = start;
+            index->bounds_checked = 1;
+            node = (ASTNode *)index;
+            continue;
+        }
+        if (expect_token(parser, TOKEN_DOT_DOT, "']' or '..'") != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+        SliceASTNode *slice = (SliceASTNode *)ast_alloc(parser, sizeof(SliceASTNode));
+        slice->base.type = AST_SLICE;
+        slice->sequence = node;
+        slice->start = start;
+        slice->end = NULL;
+        slice->bounds_checked = 1;
+        if (peek_token(parser)->type != TOKEN_RBRACKET)
+        {
+            slice->end = parse_expression(parser);
+            if (slice->end == NULL)
+            {
+                return NULL;
+            }
+        }
+        if (expect_token(parser, TOKEN_RBRACKET, "']'") != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+        node = (ASTNode *)slice;
+    }
+    return node;
+}
+
+ASTNode *parse_primary(Parser *parser)
+{
+    const TokenData *token = peek_token(parser);
+    if (token->type == TOKEN_NUMBER_LITERAL || token->type == TOKEN_FLOAT_LITERAL || token->type == TOKEN_TRUE || token->type == TOKEN_FALSE)
+    {
+        return parse_literal(parser);
+    }
+    if (token->type == TOKEN_LBRACKET)
+    {
+        return parse_array_literal(parser);
+    }
+    if (token->type == TOKEN_NEW)
+    {
+        return parse_new(parser);
+    }
+    // A lane type after the '<' tells vec2<int32>(x) apart from the comparison vec2 < x.
+    if (is_vector_type(parser, parser->position) && parser->stream->tokens[parser->position + 2].type == TOKEN_TYPE)
+    {
+        return parse_vector(parser);
+    }
+    if (token->type == TOKEN_IDENTIFIER && parser->stream->tokens[parser->position + 1].type == TOKEN_LPAREN)
+    {
+        return parse_call(parser);
+    }
+    if (token->type == TOKEN_IDENTIFIER)
+    {
+        TokenData name = next_token(parser);
+        VariableASTNode *variable = (VariableASTNode *)ast_alloc(parser, sizeof(VariableASTNode));
+        variable->base.type = AST_VARIABLE;
+        variable->name = intern_lexeme(parser, &name);
+        variable->symbol = NULL;
+        return (ASTNode *)variable;
+    }
+    if (token->type == TOKEN_LPAREN)
+    {
+        next_token(parser);
+        ASTNode *inner = parse_expression(parser);
+        if (inner == NULL)
+        {
+            return NULL;
+        }
+        TokenData close = next_token(parser);
+        if (close.type != TOKEN_RPAREN)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Expected ')' at line %u", close.line);
+            return NULL;
+        }
+        return inner;
+    }
+    log_message(LOG_LEVEL_ERROR, "Error: Expected an expression at line %u, found '%.*s'", token->line, (int)token->length, token_text(parser->stream, token));
+    return NULL;
+}
+
+// [a, b, c] or [value; count].
+ASTNode *parse_array_literal(Parser *parser)
+{
+    next_token(parser);
+    ArrayLiteralASTNode *array = (ArrayLiteralASTNode *)ast_alloc(parser, sizeof(ArrayLiteralASTNode));
+    array->base.type = AST_ARRAY_LITERAL;
+    array->elements = NULL;
+    array->element_count = 0;
+    array->repeat_value = NULL;
+    array->repeat_count = 0;
+
+    ASTNode *first = parse_expression(parser);
+    if (first == NULL)
+    {
         return NULL;
     }
-    LiteralASTNode *literal = (LiteralASTNode *)malloc(sizeof(LiteralASTNode));
+    if (peek_token(parser)->type == TOKEN_SEMICOLON)
+    {
+        next_token(parser);
+        array->repeat_value = first;
+        if (parse_length(parser, &array->repeat_count) != EXIT_SUCCESS || expect_token(parser, TOKEN_RBRACKET, "']'") != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+        return (ASTNode *)array;
+    }
+
+    size_t base = parser->scratch_count;
+    ASTNode *element = first;
+    for (;;)
+    {
+        if (scratch_push(parser, element) != EXIT_SUCCESS)
+        {
+            parser->scratch_count = base;
+            return NULL;
+        }
+        if (peek_token(parser)->type != TOKEN_COMMA)
+        {
+            break;
+        }
+        next_token(parser);
+        element = parse_expression(parser);
+        if (element == NULL)
+        {
+            parser->scratch_count = base;
+            return NULL;
+        }
+    }
+    array->elements = scratch_pop(parser, base, &array->element_count);
+    return expect_token(parser, TOKEN_RBRACKET, "']'") == EXIT_SUCCESS ? (ASTNode *)array : NULL;
+}
+
+// new [element; count], where count is any integer expression.
+ASTNode *parse_new(Parser *parser)
+{
+    next_token(parser);
+    NewASTNode *node = (NewASTNode *)ast_alloc(parser, sizeof(NewASTNode));
+    node->base.type = AST_NEW;
+    if (expect_token(parser, TOKEN_LBRACKET, "'['") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    node->element_type = parse_type(parser);
+    if (node->element_type == NULL || expect_token(parser, TOKEN_SEMICOLON, "';'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    node->count = parse_expression(parser);
+    if (node->count == NULL || expect_token(parser, TOKEN_RBRACKET, "']'") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    return (ASTNode *)node;
+}
+
+// A parenthesized, comma-separated expression list; the '(' is already consumed.
+static int parse_arguments(Parser *parser, ASTNode ***arguments, size_t *count)
+{
+    size_t base = parser->scratch_count;
+    while (peek_token(parser)->type != TOKEN_RPAREN)
+    {
+        if (parser->scratch_count > base && expect_token(parser, TOKEN_COMMA, "',' or ')'") != EXIT_SUCCESS)
+        {
+            parser->scratch_count = base;
+            return EXIT_FAILURE;
+        }
+        ASTNode *argument = parse_expression(parser);
+        if (argument == NULL || scratch_push(parser, argument) != EXIT_SUCCESS)
+        {
+            parser->scratch_count = base;
+            return EXIT_FAILURE;
+        }
+    }
+    next_token(parser);
+    *arguments = scratch_pop(parser, base, count);
+    return EXIT_SUCCESS;
+}
+
+ASTNode *parse_call(Parser *parser)
+{
+    TokenData name = next_token(parser);
+    next_token(parser);
+    CallASTNode *call = (CallASTNode *)ast_alloc(parser, sizeof(CallASTNode));
+    call->base.type = AST_CALL;
+    call->name = intern_lexeme(parser, &name);
+    call->builtin = BUILTIN_NONE;
+    call->function = NULL;
+    return parse_arguments(parser, &call->arguments, &call->argument_count) == EXIT_SUCCESS ? (ASTNode *)call : NULL;
+}
+
+// vecN<T>(lanes...) or vecN<T>(value).
+ASTNode *parse_vector(Parser *parser)
+{
+    VectorASTNode *vector = (VectorASTNode *)ast_alloc(parser, sizeof(VectorASTNode));
+    vector->base.type = AST_VECTOR;
+    vector->base.line = peek_token(parser)->line;
+    vector->vector_type = parse_type(parser);
+    if (vector->vector_type == NULL || expect_token(parser, TOKEN_LPAREN, "'('") != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    return parse_arguments(parser, &vector->elements, &vector->element_count) == EXIT_SUCCESS ? (ASTNode *)vector : NULL;
+}
+
+ASTNode *parse_literal(Parser *parser)
+{
+    TokenData token = next_token(parser);
+    const char *digits = token_text(parser->stream, &token);
+    LiteralASTNode *literal = (LiteralASTNode *)ast_alloc(parser, sizeof(LiteralASTNode));
     literal->base.type = AST_LITERAL;
-    literal->value = atoi(token.lexeme);
+    literal->value = 0;
+    literal->float_value = 0.0;
+
+    switch (token.type)
+    {
+    case TOKEN_TRUE:
+    case TOKEN_FALSE:
+        literal->kind = LITERAL_BOOL;
+        literal->value = token.type == TOKEN_TRUE;
+        return (ASTNode *)literal;
+    case TOKEN_FLOAT_LITERAL:
+    {
+        // Token text is not NUL-terminated, and a mapped file may end right after it.
+        char text[64];
+        if (token.length >= sizeof(text))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Float literal at line %u is too long", token.line);
+            return NULL;
+        }
+        memcpy(text, digits, token.length);
+        text[token.length] = '\0';
+        literal->kind = LITERAL_FLOAT;
+        literal->float_value = strtod(text, NULL);
+        return (ASTNode *)literal;
+    }
+    case TOKEN_NUMBER_LITERAL:
+        break;
+    default:
+        log_message(LOG_LEVEL_ERROR, "Error: Expected a literal value at line %u", token.line);
+        return NULL;
+    }
 
+    literal->kind = LITERAL_INTEGER;
+    if (parse_integer_digits(&token, digits, &literal->value) != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
     return (ASTNode *)literal;
-}
\ No newline at end of file
+}
@@ -1,38 +1,384 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
+#include "arena.h"
+#include "hash.h"
+#include "intern.h"
+#include "lexer.h"
+#include "source.h"
+#include "types.h"
 
 typedef enum
 {
+    AST_TRANSLATION_UNIT,
     AST_FUNCTION,
+    AST_PARAMETER,
+    AST_BLOCK,
     AST_RETURN,
+    AST_LET,
+    AST_ASSIGN,
+    AST_IF,
+    AST_WHILE,
+    AST_FOR,
+    AST_BREAK,
+    AST_CONTINUE,
+    AST_DELETE,
+    AST_EXPRESSION,
+    AST_VARIABLE,
+    AST_BINARY,
+    AST_UNARY,
+    AST_CAST,
+    AST_INDEX,
+    AST_SLICE,
+    AST_ARRAY_LITERAL,
+    AST_NEW,
+    AST_CALL,
+    AST_VECTOR,
     AST_LITERAL
 } ASTNodeType;
 
+typedef enum
+{
+    BINARY_ADD,
+    BINARY_SUB,
+    BINARY_MUL,
+    BINARY_DIV,
+    BINARY_REM,
+    BINARY_AND,
+    BINARY_OR,
+    BINARY_XOR,
+    BINARY_SHL,
+    BINARY_SHR,
+    BINARY_EQ,
+    BINARY_NE,
+    BINARY_LT,
+    BINARY_LE,
+    BINARY_GT,
+    BINARY_GE
+} BinaryOperator;
+
+typedef enum
+{
+    UNARY_NEGATE,
+    UNARY_BIT_NOT,
+    UNARY_NOT
+} UnaryOperator;
+
+#define FUNCTION_MAX_PARAMETERS 64
+
+typedef enum
+{
+    // Visible to other object files; everything else gets internal linkage.
+    FUNCTION_EXPORT = 1 << 0,
+    // A declaration of a function defined elsewhere, without a body.
+    FUNCTION_EXTERN = 1 << 1,
+    FUNCTION_INLINE = 1 << 2,
+    FUNCTION_NOINLINE = 1 << 3
+} FunctionFlags;
+
+typedef enum
+{
+    BUILTIN_NONE,
+    BUILTIN_LEN,
+    BUILTIN_SHUFFLE,
+    BUILTIN_SELECT,
+    BUILTIN_REDUCE_ADD,
+    BUILTIN_REDUCE_MUL,
+    BUILTIN_REDUCE_MIN,
+    BUILTIN_REDUCE_MAX,
+    BUILTIN_REDUCE_AND,
+    BUILTIN_REDUCE_OR,
+    BUILTIN_REDUCE_XOR,
+    BUILTIN_VLOAD,
+    BUILTIN_VSTORE
+} Builtin;
+
+typedef enum
+{
+    LITERAL_INTEGER,
+    LITERAL_FLOAT,
+    LITERAL_BOOL
+} LiteralKind;
+
+// A named storage slot in a function. sema_check numbers the slots of each function
+// so codegen can give every one an entry-block alloca.
+typedef struct
+{
+    const char *name;
+    const Type *type;
+    uint32_t slot;
+    uint32_t line;
+    uint8_t is_mutable;
+} LocalSymbol;
+
+// value_type is NULL for statements and is filled in for expressions by sema_check.
 typedef struct ASTNode
 {
     ASTNodeType type;
+    uint32_t line;
+    const Type *value_type;
 } ASTNode;
 
 typedef struct
 {
     ASTNode base;
-    char *name;
-    char *return_type;
+    ASTNode **functions;
+    size_t function_count;
+    // The source paths named by import declarations, e.g. "math/vec.jpp".
+    const char **imports;
+    size_t import_count;
+} TranslationUnitASTNode;
+
+typedef struct
+{
+    ASTNode base;
+    LocalSymbol local;
+} ParameterASTNode;
+
+typedef struct FunctionASTNode
+{
+    ASTNode base;
+    const char *name;
+    ASTNode **parameters;
+    size_t parameter_count;
+    const Type *return_type;
+    uint32_t flags;
+    // NULL for extern declarations.
     ASTNode *body;
+    // Hash of the source text from the first to the last token of the function,
+    // which identifies its code for incremental builds.
+    Hash128 source_hash;
+    // Source offsets of the name, of the end of the signature and of the end of
+    // the function, from which interface files copy its text.
+    uint32_t name_offset;
+    uint32_t signature_end;
+    uint32_t end_offset;
+    // Every local of the function in slot order, parameters first, filled in by
+    // sema_check.
+    LocalSymbol **locals;
+    size_t local_count;
+    // The functions of the unit it calls, each once, filled in by sema_check.
+    const struct FunctionASTNode **callees;
+    size_t callee_count;
+    // The inline functions whose bodies its calls pull in, directly or through
+    // other inline functions.
+    const struct FunctionASTNode **inline_callees;
+    size_t inline_callee_count;
 } FunctionASTNode;
 
+typedef struct
+{
+    ASTNode base;
+    ASTNode **statements;
+    size_t statement_count;
+} BlockASTNode;
+
 typedef struct
 {
     ASTNode base;
     ASTNode *value;
 } ReturnASTNode;
 
+// let name: declared_type = value; declared_type is NULL when it is inferred.
+typedef struct
+{
+    ASTNode base;
+    LocalSymbol local;
+    const Type *declared_type;
+    ASTNode *value;
+} LetASTNode;
+
+typedef struct
+{
+    ASTNode base;
+    ASTNode *target;
+    ASTNode *value;
+} AssignASTNode;
+
+// else_branch is NULL, a BlockASTNode or, for else if, another IfASTNode.
+typedef struct
+{
+    ASTNode base;
+    ASTNode *condition;
+    ASTNode *then_block;
+    ASTNode *else_branch;
+} IfASTNode;
+
+typedef struct
+{
+    ASTNode base;
+    ASTNode *condition;
+    ASTNode *body;
+} WhileASTNode;
+
+// for variable in start..end { body }: an immutable integer counting up from start
+// while it is below end, which is evaluated once before the loop.
+typedef struct
+{
+    ASTNode base;
+    LocalSymbol variable;
+    ASTNode *start;
+    ASTNode *end;
+    ASTNode *body;
+} ForASTNode;
+
+// A call evaluated only for its effects.
+typedef struct
+{
+    ASTNode base;
+    ASTNode *expression;
+} ExpressionASTNode;
+
+// delete value; frees a slice created by new.
+typedef struct
+{
+    ASTNode base;
+    ASTNode *value;
+} DeleteASTNode;
+
+// symbol is resolved by sema_check.
+typedef struct
+{
+    ASTNode base;
+    const char *name;
+    const LocalSymbol *symbol;
+} VariableASTNode;
+
+typedef struct
+{
+    ASTNode base;
+    BinaryOperator op;
+    ASTNode *left;
+    ASTNode *right;
+} BinaryASTNode;
+
+typedef struct
+{
+    ASTNode base;
+    UnaryOperator op;
+    ASTNode *operand;
+} UnaryASTNode;
+
+typedef struct
+{
+    ASTNode base;
+    ASTNode *operand;
+    const Type *target_type;
+} CastASTNode;
+
+// sequence[index] on an array or slice. bounds_checked is cleared by
+// eliminate_bounds_checks when the index is provably in range.
 typedef struct
 {
     ASTNode base;
-    int value;
+    ASTNode *sequence;
+    ASTNode *index;
+    uint8_t bounds_checked;
+} IndexASTNode;
+
+// sequence[start..end], a slice viewing part of an array or slice. Omitted bounds
+// are NULL and mean the start or end of the sequence.
+typedef struct
+{
+    ASTNode base;
+    ASTNode *sequence;
+    ASTNode *start;
+    ASTNode *end;
+    uint8_t bounds_checked;
+} SliceASTNode;
+
+// [a, b, c] lists its elements; [value; count] repeats one value.
+typedef struct
+{
+    ASTNode base;
+    ASTNode **elements;
+    size_t element_count;
+    ASTNode *repeat_value;
+    uint64_t repeat_count;
+} ArrayLiteralASTNode;
+
+// new [element_type; count] allocates a zeroed heap slice.
+typedef struct
+{
+    ASTNode base;
+    const Type *element_type;
+    ASTNode *count;
+} NewASTNode;
+
+// Calls a function of the translation unit or a builtin, as resolved by sema_check.
+typedef struct
+{
+    ASTNode base;
+    const char *name;
+    ASTNode **arguments;
+    size_t argument_count;
+    Builtin builtin;
+    const FunctionASTNode *function;
+} CallASTNode;
+
+// vecN<T>(a, b, ...) with one value per lane, or vecN<T>(x) to broadcast x.
+typedef struct
+{
+    ASTNode base;
+    const Type *vector_type;
+    ASTNode **elements;
+    size_t element_count;
+} VectorASTNode;
+
+// Integer values hold the bit pattern of their type, sign-extended to 64 bits for
+// signed types; bools are 0 or 1.
+typedef struct
+{
+    ASTNode base;
+    LiteralKind kind;
+    uint64_t value;
+    double float_value;
 } LiteralASTNode;
 
-ASTNode *parse_function(char **input, uint64_t line_number);
+// Owns every node and interned string of one translation unit. The root is always
+// a TranslationUnitASTNode.
+typedef struct
+{
+    Arena arena;
+    InternTable strings;
+    TypeTable types;
+    ASTNode *root;
+    size_t node_count;
+} AST;
+
+// Child lists are collected on a shared scratch stack while their parent is being
+// parsed, then copied into the arena once complete, so nested lists need no
+// per-node growable arrays.
+typedef struct
+{
+    const TokenStream *stream;
+    size_t position;
+    AST *ast;
+    ASTNode **scratch;
+    size_t scratch_count;
+    size_t scratch_capacity;
+} Parser;
+
+ASTNode *parse_translation_unit(Parser *parser);
+
+ASTNode *parse_function(Parser *parser);
+
+ASTNode *parse_block(Parser *parser);
+
+ASTNode *parse_statement(Parser *parser);
+
+ASTNode *parse_expression(Parser *parser);
+
+// Lexes and parses only, without resolving imports or checking types.
+AST *ast_parse_source(const SourceBuffer *source);
+
+struct ImportSet;
+
+// Builds a unit whose imports were already opened, see import_set_open.
+AST *ast_build_with_imports(const SourceBuffer *source, const struct ImportSet *imports);
+
+AST *ast_build_from_source(const SourceBuffer *source);
+
+AST *ast_build_from_file(char *file);
 
-ASTNode *ast_build_from_file(char *file);
\ No newline at end of file
+void ast_destroy(AST *ast);
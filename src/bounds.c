@@ -0,0 +1,342 @@
+#include "bounds.h"
+#include "log.h"
+#include <stdlib.h>
+
+// Inside `for counter in start..end` with a non-negative start, the counter is known
+// to be below end. end is either len(sequence), with `sequence` not reassigned in
+// the body, or the constant `bound`.
+typedef struct
+{
+    const LocalSymbol *counter;
+    const LocalSymbol *sequence;
+    uint64_t bound;
+} RangeFact;
+
+typedef struct
+{
+    RangeFact *facts;
+    size_t fact_count;
+    size_t fact_capacity;
+    size_t checks;
+    size_t eliminated;
+    int result;
+} BoundsContext;
+
+static int push_fact(BoundsContext *context, RangeFact fact)
+{
+    if (context->fact_count == context->fact_capacity)
+    {
+        size_t capacity = context->fact_capacity == 0 ? 8 : context->fact_capacity * 2;
+        RangeFact *facts = (RangeFact *)realloc(context->facts, capacity * sizeof(RangeFact));
+        if (facts == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while eliminating bounds checks");
+            context->result = EXIT_FAILURE;
+            return EXIT_FAILURE;
+        }
+        context->facts = facts;
+        context->fact_capacity = capacity;
+    }
+    context->facts[context->fact_count++] = fact;
+    return EXIT_SUCCESS;
+}
+
+static const LocalSymbol *variable_symbol(const ASTNode *node)
+{
+    return node->type == AST_VARIABLE ? ((const VariableASTNode *)node)->symbol : NULL;
+}
+
+// Reads an integer literal as an unsigned index. Negative values are reported as
+// not being an index at all.
+static int constant_index(const ASTNode *node, uint64_t *value)
+{
+    if (node->type != AST_LITERAL)
+    {
+        return 0;
+    }
+    *value = ((const LiteralASTNode *)node)->value;
+    return !node->value_type->is_signed || (int64_t)*value >= 0;
+}
+
+static int is_non_negative(const ASTNode *node)
+{
+    uint64_t value;
+    return !node->value_type->is_signed || constant_index(node, &value);
+}
+
+static int assigns_symbol(const ASTNode *statement, const LocalSymbol *symbol)
+{
+    switch (statement->type)
+    {
+    case AST_ASSIGN:
+        return variable_symbol(((const AssignASTNode *)statement)->target) == symbol;
+    case AST_BLOCK:
+    {
+        const BlockASTNode *block = (const BlockASTNode *)statement;
+        for (size_t i = 0; i < block->statement_count; i++)
+        {
+            if (assigns_symbol(block->statements[i], symbol))
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    case AST_IF:
+    {
+        const IfASTNode *node = (const IfASTNode *)statement;
+        return assigns_symbol(node->then_block, symbol) || (node->else_branch != NULL && assigns_symbol(node->else_branch, symbol));
+    }
+    case AST_WHILE:
+        return assigns_symbol(((const WhileASTNode *)statement)->body, symbol);
+    case AST_FOR:
+        return assigns_symbol(((const ForASTNode *)statement)->body, symbol);
+    default:
+        return 0;
+    }
+}
+
+static int index_is_known_in_range(const BoundsContext *context, const IndexASTNode *index)
+{
+    const Type *sequence_type = index->sequence->value_type;
+    uint64_t value;
+    if (type_has_fixed_length(sequence_type) && constant_index(index->index, &value))
+    {
+        return value < sequence_type->length;
+    }
+    const LocalSymbol *counter = variable_symbol(index->index);
+    if (counter == NULL)
+    {
+        return 0;
+    }
+    for (size_t i = context->fact_count; i > 0; i--)
+    {
+        const RangeFact *fact = &context->facts[i - 1];
+        if (fact->counter != counter)
+        {
+            continue;
+        }
+        if (fact->sequence != NULL ? variable_symbol(index->sequence) == fact->sequence : type_has_fixed_length(sequence_type) && fact->bound <= sequence_type->length)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void visit_expression(BoundsContext *context, ASTNode *node);
+
+static void visit_index(BoundsContext *context, IndexASTNode *index)
+{
+    visit_expression(context, index->sequence);
+    visit_expression(context, index->index);
+    context->checks++;
+    if (index_is_known_in_range(context, index))
+    {
+        index->bounds_checked = 0;
+        context->eliminated++;
+        return;
+    }
+    const Type *sequence_type = index->sequence->value_type;
+    if (type_has_fixed_length(sequence_type) && index->index->type == AST_LITERAL)
+    {
+        int64_t value = (int64_t)((LiteralASTNode *)index->index)->value;
+        if (index->index->value_type->is_signed)
+            log_message(LOG_LEVEL_ERROR, "Error: Index %lld is out of bounds for %s at line %u", (long long)value, sequence_type->name, index->base.line);
+        else
+            log_message(LOG_LEVEL_ERROR, "Error: Index %llu is out of bounds for %s at line %u", (unsigned long long)value, sequence_type->name, index->base.line);
+        context->result = EXIT_FAILURE;
+    }
+}
+
+// Slices of arrays with constant (or omitted) bounds are checked here instead.
+static void visit_slice(BoundsContext *context, SliceASTNode *slice)
+{
+    visit_expression(context, slice->sequence);
+    if (slice->start != NULL)
+        visit_expression(context, slice->start);
+    if (slice->end != NULL)
+        visit_expression(context, slice->end);
+    context->checks++;
+
+    const Type *sequence_type = slice->sequence->value_type;
+    uint64_t start = 0;
+    uint64_t end = sequence_type->length;
+    if (sequence_type->kind != TYPE_ARRAY || (slice->start != NULL && slice->start->type != AST_LITERAL) || (slice->end != NULL && slice->end->type != AST_LITERAL))
+    {
+        return;
+    }
+    if ((slice->start != NULL && !constant_index(slice->start, &start)) || (slice->end != NULL && !constant_index(slice->end, &end)) || start > end || end > sequence_type->length)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Slice bounds are out of range for %s at line %u", sequence_type->name, slice->base.line);
+        context->result = EXIT_FAILURE;
+        return;
+    }
+    slice->bounds_checked = 0;
+    context->eliminated++;
+}
+
+static void visit_expression(BoundsContext *context, ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_INDEX:
+        visit_index(context, (IndexASTNode *)node);
+        break;
+    case AST_SLICE:
+        visit_slice(context, (SliceASTNode *)node);
+        break;
+    case AST_BINARY:
+        visit_expression(context, ((BinaryASTNode *)node)->left);
+        visit_expression(context, ((BinaryASTNode *)node)->right);
+        break;
+    case AST_UNARY:
+        visit_expression(context, ((UnaryASTNode *)node)->operand);
+        break;
+    case AST_CAST:
+        visit_expression(context, ((CastASTNode *)node)->operand);
+        break;
+    case AST_ARRAY_LITERAL:
+    {
+        ArrayLiteralASTNode *array = (ArrayLiteralASTNode *)node;
+        if (array->repeat_value != NULL)
+            visit_expression(context, array->repeat_value);
+        for (size_t i = 0; i < array->element_count; i++)
+            visit_expression(context, array->elements[i]);
+        break;
+    }
+    case AST_NEW:
+        visit_expression(context, ((NewASTNode *)node)->count);
+        break;
+    case AST_CALL:
+    {
+        CallASTNode *call = (CallASTNode *)node;
+        for (size_t i = 0; i < call->argument_count; i++)
+            visit_expression(context, call->arguments[i]);
+        break;
+    }
+    case AST_VECTOR:
+    {
+        VectorASTNode *vector = (VectorASTNode *)node;
+        for (size_t i = 0; i < vector->element_count; i++)
+            visit_expression(context, vector->elements[i]);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Returns 1 and fills in `fact` when the loop's range proves its counter in bounds.
+static int range_fact(const ForASTNode *node, RangeFact *fact)
+{
+    if (!is_non_negative(node->start))
+    {
+        return 0;
+    }
+    fact->counter = &node->variable;
+    fact->sequence = NULL;
+    fact->bound = 0;
+    if (node->end->type == AST_LITERAL)
+    {
+        // A negative end means the loop never runs, so any bound will do.
+        if (!constant_index(node->end, &fact->bound))
+        {
+            fact->bound = 0;
+        }
+        return 1;
+    }
+    if (node->end->type != AST_CALL || ((const CallASTNode *)node->end)->builtin != BUILTIN_LEN)
+    {
+        return 0;
+    }
+    const ASTNode *sequence = ((const CallASTNode *)node->end)->arguments[0];
+    if (type_has_fixed_length(sequence->value_type))
+    {
+        fact->bound = sequence->value_type->length;
+        return 1;
+    }
+    fact->sequence = variable_symbol(sequence);
+    return fact->sequence != NULL && !assigns_symbol(node->body, fact->sequence);
+}
+
+static void visit_statement(BoundsContext *context, ASTNode *statement)
+{
+    switch (statement->type)
+    {
+    case AST_RETURN:
+        visit_expression(context, ((ReturnASTNode *)statement)->value);
+        break;
+    case AST_LET:
+        visit_expression(context, ((LetASTNode *)statement)->value);
+        break;
+    case AST_ASSIGN:
+        visit_expression(context, ((AssignASTNode *)statement)->target);
+        visit_expression(context, ((AssignASTNode *)statement)->value);
+        break;
+    case AST_DELETE:
+        visit_expression(context, ((DeleteASTNode *)statement)->value);
+        break;
+    case AST_EXPRESSION:
+        visit_expression(context, ((ExpressionASTNode *)statement)->expression);
+        break;
+    case AST_IF:
+    {
+        IfASTNode *node = (IfASTNode *)statement;
+        visit_expression(context, node->condition);
+        visit_statement(context, node->then_block);
+        if (node->else_branch != NULL)
+        {
+            visit_statement(context, node->else_branch);
+        }
+        break;
+    }
+    case AST_WHILE:
+        visit_expression(context, ((WhileASTNode *)statement)->condition);
+        visit_statement(context, ((WhileASTNode *)statement)->body);
+        break;
+    case AST_FOR:
+    {
+        ForASTNode *node = (ForASTNode *)statement;
+        visit_expression(context, node->start);
+        visit_expression(context, node->end);
+        size_t fact_count = context->fact_count;
+        RangeFact fact;
+        if (range_fact(node, &fact))
+        {
+            push_fact(context, fact);
+        }
+        visit_statement(context, node->body);
+        context->fact_count = fact_count;
+        break;
+    }
+    case AST_BLOCK:
+    {
+        BlockASTNode *block = (BlockASTNode *)statement;
+        for (size_t i = 0; i < block->statement_count; i++)
+        {
+            visit_statement(context, block->statements[i]);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+int eliminate_bounds_checks(AST *ast)
+{
+    BoundsContext context = {NULL, 0, 0, 0, 0, EXIT_SUCCESS};
+    TranslationUnitASTNode *unit = (TranslationUnitASTNode *)ast->root;
+    for (size_t i = 0; i < unit->function_count; i++)
+    {
+        FunctionASTNode *function = (FunctionASTNode *)unit->functions[i];
+        if (function->body != NULL)
+        {
+            visit_statement(&context, function->body);
+        }
+    }
+    free(context.facts);
+    log_message(LOG_LEVEL_TRACE, "Eliminated %zu of %zu bounds checks", context.eliminated, context.checks);
+    return context.result;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "ast.h"
+
+// Clears IndexASTNode.bounds_checked and SliceASTNode.bounds_checked where the
+// access is provably in range, so codegen emits no compare-and-trap for it:
+// constant indices into arrays, and the counter of a for loop that starts at a
+// non-negative value and stops at len(s) or at a constant no larger than the
+// array being indexed. Constant indices past the end of an array are reported as
+// errors. Runs after fold_constants.
+int eliminate_bounds_checks(AST *ast);
@@ -0,0 +1,185 @@
+#include "cache.h"
+#include "log.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <direct.h>
+#define MKDIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#define MKDIR(path) mkdir(path, 0755)
+#endif
+
+#ifndef JPP_VERSION
+#define JPP_VERSION "unknown"
+#endif
+
+#define CACHE_PATH_SIZE 4096
+
+static void hash_codegen_options(Hasher *hasher, const CodegenOptions *options)
+{
+    uint32_t settings[2] = {(uint32_t)options->opt_level, options->lto};
+    hasher_update(hasher, settings, sizeof(settings));
+    hasher_update_string(hasher, options->profile_generate != NULL ? options->profile_generate : "");
+    if (options->profile != NULL)
+    {
+        hasher_update(hasher, &options->profile->hash, sizeof(options->profile->hash));
+    }
+}
+
+void cache_compute_key(const SourceBuffer *source, const char *module_name, const ImportSet *imports, const CodegenOptions *options, char key[HASH_HEX_SIZE])
+{
+    Hasher hasher;
+    hasher_init(&hasher);
+    hasher_update_string(&hasher, "jpp " JPP_VERSION);
+    hash_target_description(&hasher);
+
+    hash_codegen_options(&hasher, options);
+    if (options->profile_generate != NULL || options->profile != NULL)
+    {
+        hasher_update_string(&hasher, module_name);
+    }
+
+    uint64_t source_size = source->size;
+    hasher_update(&hasher, &source_size, sizeof(source_size));
+    hasher_update(&hasher, source->data, source->size);
+    import_set_hash(imports, &hasher);
+
+    hash_to_hex(hasher_finish(&hasher), key);
+}
+
+static void hash_signature(Hasher *hasher, const FunctionASTNode *function)
+{
+    hasher_update_string(hasher, function->name);
+    uint32_t shape[2] = {function->flags, function->body != NULL};
+    hasher_update(hasher, shape, sizeof(shape));
+    hasher_update_string(hasher, function->return_type->name);
+    for (size_t i = 0; i < function->parameter_count; i++)
+    {
+        hasher_update_string(hasher, ((const ParameterASTNode *)function->parameters[i])->local.type->name);
+    }
+}
+
+static void hash_body(Hasher *hasher, const FunctionASTNode *function)
+{
+    hasher_update(hasher, &function->source_hash, sizeof(function->source_hash));
+    for (size_t i = 0; i < function->callee_count; i++)
+    {
+        hash_signature(hasher, function->callees[i]);
+    }
+}
+
+void cache_compute_function_key(const FunctionASTNode *function, const char *module_name, const CodegenOptions *options, char key[HASH_HEX_SIZE])
+{
+    Hasher hasher;
+    hasher_init(&hasher);
+    hasher_update_string(&hasher, "jpp function " JPP_VERSION);
+    hash_target_description(&hasher);
+
+    hash_codegen_options(&hasher, options);
+    hasher_update_string(&hasher, module_name);
+
+    hash_body(&hasher, function);
+    for (size_t i = 0; i < function->inline_callee_count; i++)
+    {
+        hash_body(&hasher, function->inline_callees[i]);
+    }
+
+    hash_to_hex(hasher_finish(&hasher), key);
+}
+
+int cache_prepare(const CacheOptions *cache)
+{
+    char path[CACHE_PATH_SIZE];
+    if (snprintf(path, sizeof(path), "%s", cache->directory) >= (int)sizeof(path))
+    {
+        log_message(LOG_LEVEL_ERROR, "Cache directory path is too long: %s", cache->directory);
+        return EXIT_FAILURE;
+    }
+
+    // Create every missing component, like mkdir -p.
+    for (char *cursor = path + 1; ; cursor++)
+    {
+        if (*cursor == '/' || *cursor == '\\' || *cursor == '\0')
+        {
+            char separator = *cursor;
+            *cursor = '\0';
+            if (MKDIR(path) != 0 && errno != EEXIST)
+            {
+                log_message(LOG_LEVEL_ERROR, "Could not create cache directory %s", path);
+                return EXIT_FAILURE;
+            }
+            *cursor = separator;
+            if (separator == '\0')
+            {
+                break;
+            }
+        }
+    }
+    log_message(LOG_LEVEL_TRACE, "Using compilation cache in %s", cache->directory);
+    return EXIT_SUCCESS;
+}
+
+static int cache_object_path(const CacheOptions *cache, const char *key, char *path, size_t size)
+{
+    return snprintf(path, size, "%s/%s.o", cache->directory, key) < (int)size ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+char *cache_find_path(const CacheOptions *cache, const char *key)
+{
+    char path[CACHE_PATH_SIZE];
+    if (cache_object_path(cache, key, path, sizeof(path)) != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        log_message(LOG_LEVEL_TRACE, "Cache miss: %s", key);
+        return NULL;
+    }
+    fclose(file);
+    log_message(LOG_LEVEL_TRACE, "Cache hit: %s", key);
+
+    char *result = (char *)malloc(strlen(path) + 1);
+    if (result != NULL)
+    {
+        strcpy(result, path);
+    }
+    return result;
+}
+
+int cache_lookup(const CacheOptions *cache, const char *key, ObjectBuffer *object)
+{
+    char path[CACHE_PATH_SIZE];
+    if (cache_object_path(cache, key, path, sizeof(path)) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (object_buffer_load(path, object) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_TRACE, "Cache miss: %s", key);
+        return EXIT_FAILURE;
+    }
+    log_message(LOG_LEVEL_TRACE, "Cache hit: %s", key);
+    return EXIT_SUCCESS;
+}
+
+void cache_store(const CacheOptions *cache, const char *key, const ObjectBuffer *object)
+{
+    char path[CACHE_PATH_SIZE];
+    if (cache_object_path(cache, key, path, sizeof(path)) != EXIT_SUCCESS)
+    {
+        return;
+    }
+    if (file_write_atomic(path, object->data, object->size) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_WARN, "Could not store cache entry %s", path);
+        return;
+    }
+    log_message(LOG_LEVEL_TRACE, "Stored cache entry %s", path);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "hash.h"
+#include "interface.h"
+#include "llvm.h"
+#include "source.h"
+
+typedef struct
+{
+    uint8_t enabled;
+    const char *directory;
+} CacheOptions;
+
+// The key covers everything that can change the emitted object: the source bytes,
+// the sources of its imports, the host target, the codegen options including the profile and the compiler version,
+// and with a profile option also the module name, which instrumented code refers to.
+void cache_compute_key(const SourceBuffer *source, const char *module_name, const ImportSet *imports, const CodegenOptions *options, char key[HASH_HEX_SIZE]);
+
+// The key of one function's object in an incremental build: its source text, the
+// signatures of the functions it calls and the bodies of the inline ones it pulls in,
+// besides the target, options and version.
+void cache_compute_function_key(const FunctionASTNode *function, const char *module_name, const CodegenOptions *options, char key[HASH_HEX_SIZE]);
+
+int cache_prepare(const CacheOptions *cache);
+
+// Returns the path of the entry, to be freed by the caller, or NULL if there is none.
+char *cache_find_path(const CacheOptions *cache, const char *key);
+
+int cache_lookup(const CacheOptions *cache, const char *key, ObjectBuffer *object);
+
+void cache_store(const CacheOptions *cache, const char *key, const ObjectBuffer *object);
@@ -2,47 +2,259 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include "log.h"
-#include "lexer.h"
-#include "ast.h"
+#include "driver.h"
 #include "llvm.h"
+#include "server.h"
 
-int jpp_cli_init(int argc, char *args[])
+static void print_usage(void)
+{
+    log_message(LOG_LEVEL_WARN, "Make sure you add the the jpp programs you want to compile as well as a name");
+    log_message(LOG_LEVEL_WARN, "Example: jpp [options] <path_to_jpp_file>... <name_of_executable>");
+    log_message(LOG_LEVEL_WARN, "     or: jpp [options] --run <path_to_jpp_file>...");
+    log_message(LOG_LEVEL_WARN, "     or: jpp [options] --server[=<socket>]");
+    log_message(LOG_LEVEL_WARN, "  -v    verbose, print trace messages");
+    log_message(LOG_LEVEL_WARN, "  -q    quiet, only print errors");
+    log_message(LOG_LEVEL_WARN, "  -j N  compile up to N files in parallel (default: one per core)");
+    log_message(LOG_LEVEL_WARN, "  -O0 -O1 -O2 -O3 -Os  optimization level (default: -O0)");
+    log_message(LOG_LEVEL_WARN, "  -flto  optimize all files together as one module before linking");
+    log_message(LOG_LEVEL_WARN, "  --run  JIT-compile the program in-process and exit with the result of main");
+    log_message(LOG_LEVEL_WARN, "  --linker=<driver>  compiler driver used for linking (default: gcc)");
+    log_message(LOG_LEVEL_WARN, "  -fuse-ld=<linker>  linker the driver should use, e.g. lld or gold");
+    log_message(LOG_LEVEL_WARN, "  --cache-dir=<dir>  where compiled objects are cached (default: $JPP_CACHE_DIR or build/cache)");
+    log_message(LOG_LEVEL_WARN, "  --no-cache         always recompile, neither reading nor writing the cache");
+    log_message(LOG_LEVEL_WARN, "  --codegen-partitions=N  split each file into N parts generated on separate threads");
+    log_message(LOG_LEVEL_WARN, "  --incremental      cache one object per function and only recompile functions that changed");
+    log_message(LOG_LEVEL_WARN, "  --profile-generate[=<file>] count branches at run time and append them to <file> (default: default.jppprof)");
+    log_message(LOG_LEVEL_WARN, "  --profile-use=<file>  optimize with the counts of earlier --profile-generate runs");
+    log_message(LOG_LEVEL_WARN, "  --time-report      print wall/CPU time and peak memory per phase and per function");
+    log_message(LOG_LEVEL_WARN, "  --trace-out=<file> write a Chrome trace (chrome://tracing, Perfetto) of all phases");
+    log_message(LOG_LEVEL_WARN, "  --server[=<socket>] compile one job per line from stdin or a Unix socket; other options become defaults");
+}
+
+static uint8_t has_jpp_extension(const char *path)
+{
+    const char *last_dot = strrchr(path, '.');
+    return last_dot != NULL && strcmp(last_dot, ".jpp") == 0;
+}
+
+static int parse_count(const char *value, const char *what, size_t *result)
+{
+    char *end = NULL;
+    long count = strtol(value, &end, 10);
+    if (value[0] == '\0' || *end != '\0' || count <= 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Invalid %s: %s", what, value);
+        return EXIT_FAILURE;
+    }
+    *result = (size_t)count;
+    return EXIT_SUCCESS;
+}
+
+int cli_parse_arguments(int argc, char *args[], DriverOptions *options)
 {
-    if (argc > 2)
+    options->inputs = (const char **)malloc((size_t)argc * sizeof(const char *));
+    options->input_count = 0;
+    options->output = NULL;
+    options->jobs = 0;
+    options->run = 0;
+    options->linker.driver = "gcc";
+    options->linker.fuse_ld = NULL;
+    options->time_report = 0;
+    options->trace_path = NULL;
+    options->cache.enabled = 1;
+    options->incremental = 0;
+    options->partitions = 0;
+    options->profile_use = NULL;
+    options->codegen.profile_generate = NULL;
+    options->codegen.profile = NULL;
+    options->codegen.lto = 0;
+    options->cache.directory = getenv("JPP_CACHE_DIR");
+    if (options->cache.directory == NULL || options->cache.directory[0] == '\0')
+    {
+        options->cache.directory = "build/cache";
+    }
+    options->codegen.opt_level = OPT_LEVEL_O0;
+    if (options->inputs == NULL)
     {
-        log_message(LOG_LEVEL_INFO, "Compiling file: %s", args[1]);
-        char *file_path;
-        uint16_t last_dot_index = 0;
-        uint16_t size = 0;
-        for (file_path = args[1]; *file_path != '\0'; file_path++)
+        log_message(LOG_LEVEL_ERROR, "Out of memory while parsing arguments");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = args[i];
+        if (strcmp(arg, "-v") == 0)
         {
-            if (*file_path == '.')
+            set_logger_level(LOG_LEVEL_TRACE);
+            if (JPP_LOG_MIN_LEVEL > LOG_LEVEL_TRACE)
             {
-                last_dot_index = size;
+                log_message(LOG_LEVEL_WARN, "Trace messages are compiled out of this build, -v has no effect");
             }
-            size++;
         }
-        if (last_dot_index + 4 == size && args[1][last_dot_index + 1] == 'j' && args[1][last_dot_index + 2] == 'p' && args[1][last_dot_index + 3] == 'p')
+        else if (strcmp(arg, "-q") == 0)
+        {
+            set_logger_level(LOG_LEVEL_ERROR);
+        }
+        else if (strncmp(arg, "-j", 2) == 0)
         {
-            log_message(LOG_LEVEL_TRACE, "Valid .jpp file provided");
-            ASTNode *root_node = ast_build_from_file(args[1]);
-            if (root_node == NULL)
+            const char *value = arg[2] != '\0' ? arg + 2 : (i + 1 < argc ? args[++i] : "");
+            if (parse_count(value, "job count", &options->jobs) != EXIT_SUCCESS)
             {
-                log_message(LOG_LEVEL_ERROR, "Failed to parse the file into an AST.");
                 return EXIT_FAILURE;
             }
-            log_message(LOG_LEVEL_INFO, "AST successfully built.");
-            generate_code_from_ast(root_node, args[2]);
-            return EXIT_SUCCESS;
         }
-        log_message(LOG_LEVEL_ERROR, "Invalid file provided. Make sure it has the .jpp extension");
+        else if (strcmp(arg, "--run") == 0)
+        {
+            options->run = 1;
+        }
+        else if (strncmp(arg, "--linker=", 9) == 0 && arg[9] != '\0')
+        {
+            options->linker.driver = arg + 9;
+        }
+        else if (strncmp(arg, "-fuse-ld=", 9) == 0 && arg[9] != '\0')
+        {
+            options->linker.fuse_ld = arg + 9;
+        }
+        else if (strncmp(arg, "--cache-dir=", 12) == 0 && arg[12] != '\0')
+        {
+            options->cache.directory = arg + 12;
+        }
+        else if (strcmp(arg, "--no-cache") == 0)
+        {
+            options->cache.enabled = 0;
+        }
+        else if (strncmp(arg, "--codegen-partitions=", 21) == 0)
+        {
+            if (parse_count(arg + 21, "partition count", &options->partitions) != EXIT_SUCCESS)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(arg, "-flto") == 0)
+        {
+            options->codegen.lto = 1;
+        }
+        else if (strcmp(arg, "--profile-generate") == 0)
+        {
+            options->codegen.profile_generate = "default.jppprof";
+        }
+        else if (strncmp(arg, "--profile-generate=", 19) == 0 && arg[19] != '\0')
+        {
+            options->codegen.profile_generate = arg + 19;
+        }
+        else if (strncmp(arg, "--profile-use=", 14) == 0 && arg[14] != '\0')
+        {
+            options->profile_use = arg + 14;
+        }
+        else if (strcmp(arg, "--incremental") == 0)
+        {
+            options->incremental = 1;
+        }
+        else if (strcmp(arg, "--time-report") == 0)
+        {
+            options->time_report = 1;
+        }
+        else if (strncmp(arg, "--trace-out=", 12) == 0 && arg[12] != '\0')
+        {
+            options->trace_path = arg + 12;
+        }
+        else if (strcmp(arg, "-O0") == 0)
+        {
+            options->codegen.opt_level = OPT_LEVEL_O0;
+        }
+        else if (strcmp(arg, "-O1") == 0)
+        {
+            options->codegen.opt_level = OPT_LEVEL_O1;
+        }
+        else if (strcmp(arg, "-O2") == 0 || strcmp(arg, "-O") == 0)
+        {
+            options->codegen.opt_level = OPT_LEVEL_O2;
+        }
+        else if (strcmp(arg, "-O3") == 0)
+        {
+            options->codegen.opt_level = OPT_LEVEL_O3;
+        }
+        else if (strcmp(arg, "-Os") == 0)
+        {
+            options->codegen.opt_level = OPT_LEVEL_OS;
+        }
+        else if (arg[0] == '-' && arg[1] != '\0')
+        {
+            log_message(LOG_LEVEL_ERROR, "Unknown option: %s", arg);
+            return EXIT_FAILURE;
+        }
+        else if (has_jpp_extension(arg))
+        {
+            options->inputs[options->input_count++] = arg;
+        }
+        else if (options->output == NULL)
+        {
+            options->output = arg;
+        }
+        else
+        {
+            log_message(LOG_LEVEL_ERROR, "Invalid file provided: %s. Make sure it has the .jpp extension", arg);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options->run && options->output != NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "--run does not produce an executable, unexpected argument: %s", options->output);
         return EXIT_FAILURE;
     }
-    else
+    if (options->codegen.profile_generate != NULL && options->run)
     {
-        log_message(LOG_LEVEL_WARN, "Make sure you add the the jpp program you want to compile as well as a name");
-        log_message(LOG_LEVEL_WARN, "Example: jpp <path_to_jpp_file> <name_of_executable>");
+        log_message(LOG_LEVEL_ERROR, "--profile-generate writes the profile when a linked executable exits and cannot be combined with --run");
         return EXIT_FAILURE;
     }
-}
\ No newline at end of file
+    if (options->codegen.lto && (options->run || options->incremental || options->partitions > 1))
+    {
+        log_message(LOG_LEVEL_ERROR, "-flto cannot be combined with %s", options->run ? "--run" : options->incremental ? "--incremental" : "--codegen-partitions");
+        return EXIT_FAILURE;
+    }
+    if (options->incremental && (options->run || !options->cache.enabled))
+    {
+        log_message(LOG_LEVEL_ERROR, "--incremental keeps its objects in the cache and cannot be combined with %s", options->run ? "--run" : "--no-cache");
+        return EXIT_FAILURE;
+    }
+    if (options->partitions > 1 && (options->run || options->incremental))
+    {
+        log_message(LOG_LEVEL_ERROR, "--codegen-partitions cannot be combined with %s", options->run ? "--run" : "--incremental");
+        return EXIT_FAILURE;
+    }
+    if (options->input_count == 0 || (options->output == NULL && !options->run))
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int jpp_cli_init(int argc, char *args[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(args[i], "--server") == 0 || strncmp(args[i], "--server=", 9) == 0)
+        {
+            const char *socket_path = args[i][8] == '=' && args[i][9] != '\0' ? args[i] + 9 : NULL;
+            // The remaining arguments are the defaults of every job.
+            memmove(&args[i], &args[i + 1], (size_t)(argc - i - 1) * sizeof(char *));
+            int result = server_run(argc - 1, args, socket_path);
+            shutdown_llvm_target();
+            return result;
+        }
+    }
+
+    DriverOptions options;
+    int result = cli_parse_arguments(argc, args, &options);
+    if (result == EXIT_SUCCESS)
+    {
+        result = driver_compile(&options);
+    }
+    free(options.inputs);
+    shutdown_llvm_target();
+    return result;
+}
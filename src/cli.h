@@ -1,3 +1,8 @@
 #pragma once
+#include "driver.h"
 
-int jpp_cli_init(int argc, char *args[]);
\ No newline at end of file
+// Fills in `options` from command-line style arguments, args[0] being the program
+// name. The caller frees options->inputs, even on failure.
+int cli_parse_arguments(int argc, char *args[], DriverOptions *options);
+
+int jpp_cli_init(int argc, char *args[]);
@@ -0,0 +1,423 @@
+#include "driver.h"
+#include "ast.h"
+#include "cache.h"
+#include "interface.h"
+#include "linker.h"
+#include "llvm.h"
+#include "log.h"
+#include "thread.h"
+#include "timing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    const char *input;
+    const CodegenOptions *codegen;
+    const CacheOptions *cache;
+    uint8_t keep_ast;
+    uint8_t incremental;
+    size_t partitions;
+    AST *ast;
+    ObjectBuffer object;
+    // One object per function in incremental builds or per partition, instead of object.
+    ObjectBuffer *fragments;
+    size_t fragment_count;
+    int result;
+} CompileJob;
+
+// Gives every function its own cached object, so an edit only recompiles the
+// functions it changed and those that inline them.
+static int compile_functions(CompileJob *job, AST *ast)
+{
+    const TranslationUnitASTNode *unit = (const TranslationUnitASTNode *)ast->root;
+    job->fragments = (ObjectBuffer *)calloc(unit->function_count + 1, sizeof(ObjectBuffer));
+    if (job->fragments == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while compiling the functions of %s", job->input);
+        return EXIT_FAILURE;
+    }
+
+    size_t reused = 0;
+    for (size_t i = 0; i < unit->function_count; i++)
+    {
+        FunctionASTNode *function = (FunctionASTNode *)unit->functions[i];
+        if (function->body == NULL)
+        {
+            continue;
+        }
+        ObjectBuffer *fragment = &job->fragments[job->fragment_count];
+        char key[HASH_HEX_SIZE];
+        TimingScope cache_timer = timing_begin("cache lookup", function->name);
+        cache_compute_function_key(function, job->input, job->codegen, key);
+        fragment->path = cache_find_path(job->cache, key);
+        timing_end(&cache_timer);
+        if (fragment->path != NULL)
+        {
+            job->fragment_count++;
+            reused++;
+            continue;
+        }
+
+        if (generate_partition_object(ast->root, &function, 1, job->input, fragment, job->codegen) != EXIT_SUCCESS)
+        {
+            return EXIT_FAILURE;
+        }
+        job->fragment_count++;
+        cache_timer = timing_begin("cache store", function->name);
+        cache_store(job->cache, key, fragment);
+        timing_end(&cache_timer);
+    }
+    log_message(LOG_LEVEL_INFO, "Reused %zu of %zu function objects for %s.", reused, job->fragment_count, job->input);
+    return EXIT_SUCCESS;
+}
+
+typedef struct
+{
+    CompileJob *job;
+    AST *ast;
+    FunctionASTNode **functions;
+    size_t function_count;
+    int *results;
+} PartitionSet;
+
+static void compile_partition(size_t index, void *user_data)
+{
+    PartitionSet *set = (PartitionSet *)user_data;
+    CompileJob *job = set->job;
+    // Contiguous ranges keep functions that call each other together.
+    size_t begin = set->function_count * index / job->fragment_count;
+    size_t end = set->function_count * (index + 1) / job->fragment_count;
+    set->results[index] = generate_partition_object(set->ast->root, set->functions + begin, end - begin, job->input, &job->fragments[index], job->codegen);
+}
+
+// Splits the unit into partitions with one LLVM context each, which are optimized
+// and emitted concurrently and linked as separate objects.
+static int compile_partitions(CompileJob *job, AST *ast)
+{
+    const TranslationUnitASTNode *unit = (const TranslationUnitASTNode *)ast->root;
+    PartitionSet set = {job, ast, NULL, 0, NULL};
+    set.functions = (FunctionASTNode **)calloc(unit->function_count + 1, sizeof(FunctionASTNode *));
+    for (size_t i = 0; i < unit->function_count && set.functions != NULL; i++)
+    {
+        FunctionASTNode *function = (FunctionASTNode *)unit->functions[i];
+        if (function->body != NULL)
+        {
+            set.functions[set.function_count++] = function;
+        }
+    }
+    size_t partition_count = job->partitions < set.function_count ? job->partitions : set.function_count;
+    if (partition_count == 0)
+    {
+        partition_count = 1;
+    }
+    set.results = (int *)calloc(partition_count, sizeof(int));
+    job->fragments = (ObjectBuffer *)calloc(partition_count, sizeof(ObjectBuffer));
+    if (set.functions == NULL || set.results == NULL || job->fragments == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while partitioning %s", job->input);
+        free(set.functions);
+        free(set.results);
+        return EXIT_FAILURE;
+    }
+    job->fragment_count = partition_count;
+
+    log_message(LOG_LEVEL_TRACE, "Generating %zu functions of %s in %zu partitions", set.function_count, job->input, partition_count);
+    thread_pool_run(partition_count, partition_count, compile_partition, &set);
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < partition_count; i++)
+    {
+        if (set.results[i] != EXIT_SUCCESS)
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+    free(set.functions);
+    free(set.results);
+    return result;
+}
+
+static void compile_file(CompileJob *job)
+{
+    SourceBuffer source;
+    TimingScope read_timer = timing_begin("read source", job->input);
+    // Stamped before reading, for the interface written from this source.
+    FileStamp stamp;
+    int opened = EXIT_FAILURE;
+    if (file_stamp(job->input, &stamp) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not open file %s", job->input);
+    }
+    else
+    {
+        opened = source_buffer_open(job->input, &source);
+    }
+    timing_end(&read_timer);
+    if (opened != EXIT_SUCCESS)
+    {
+        job->result = EXIT_FAILURE;
+        return;
+    }
+    // Opened once here for both the cache key and the AST.
+    ImportSet imports;
+    if (import_set_open(&source, &imports) != EXIT_SUCCESS)
+    {
+        source_buffer_close(&source);
+        job->result = EXIT_FAILURE;
+        return;
+    }
+
+    // The JIT consumes IR rather than objects, so only native compiles go through the cache.
+    uint8_t use_cache = job->cache->enabled && !job->keep_ast && !job->incremental && job->partitions <= 1;
+    char key[HASH_HEX_SIZE];
+    if (use_cache)
+    {
+        TimingScope cache_timer = timing_begin("cache lookup", job->input);
+        cache_compute_key(&source, job->input, &imports, job->codegen, key);
+        int hit = cache_lookup(job->cache, key, &job->object) == EXIT_SUCCESS;
+        timing_end(&cache_timer);
+        if (hit)
+        {
+            log_message(LOG_LEVEL_INFO, "Reusing cached object for %s.", job->input);
+            import_set_close(&imports);
+            source_buffer_close(&source);
+            job->result = EXIT_SUCCESS;
+            return;
+        }
+    }
+
+    AST *ast = ast_build_with_imports(&source, &imports);
+    import_set_close(&imports);
+    if (ast != NULL)
+    {
+        interface_update(ast, &source, job->input, &stamp);
+    }
+    source_buffer_close(&source);
+    if (ast == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Failed to parse %s into an AST.", job->input);
+        job->result = EXIT_FAILURE;
+        return;
+    }
+    log_message(LOG_LEVEL_INFO, "AST successfully built for %s.", job->input);
+
+    // The JIT consumes every unit at once, so it needs the ASTs to outlive the job.
+    if (job->keep_ast)
+    {
+        job->ast = ast;
+        job->result = EXIT_SUCCESS;
+        return;
+    }
+    if (job->incremental)
+    {
+        job->result = compile_functions(job, ast);
+    }
+    else if (job->partitions > 1)
+    {
+        job->result = compile_partitions(job, ast);
+    }
+    else
+    {
+        job->result = generate_code_from_ast(ast->root, job->input, &job->object, job->codegen);
+    }
+    ast_destroy(ast);
+
+    if (use_cache && job->result == EXIT_SUCCESS)
+    {
+        TimingScope cache_timer = timing_begin("cache store", job->input);
+        cache_store(job->cache, key, &job->object);
+        timing_end(&cache_timer);
+    }
+}
+
+static void compile_job(size_t index, void *user_data)
+{
+    CompileJob *job = &((CompileJob *)user_data)[index];
+    log_message(LOG_LEVEL_INFO, "Compiling file: %s", job->input);
+
+    TimingScope timer = timing_begin("compile file", job->input);
+    compile_file(job);
+    timing_end(&timer);
+}
+
+static CompileJob *create_jobs(const DriverOptions *options, const CodegenOptions *codegen)
+{
+    CompileJob *jobs = (CompileJob *)calloc(options->input_count, sizeof(CompileJob));
+    if (jobs == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while setting up the compile jobs");
+        return NULL;
+    }
+    for (size_t i = 0; i < options->input_count; i++)
+    {
+        jobs[i].input = options->inputs[i];
+        jobs[i].codegen = codegen;
+        jobs[i].cache = &options->cache;
+        jobs[i].keep_ast = options->run;
+        jobs[i].incremental = options->incremental;
+        jobs[i].partitions = options->partitions;
+        jobs[i].result = EXIT_FAILURE;
+    }
+    return jobs;
+}
+
+static void destroy_jobs(const DriverOptions *options, CompileJob *jobs)
+{
+    for (size_t i = 0; i < options->input_count; i++)
+    {
+        ast_destroy(jobs[i].ast);
+        object_buffer_dispose(&jobs[i].object);
+        for (size_t f = 0; f < jobs[i].fragment_count; f++)
+        {
+            object_buffer_dispose(&jobs[i].fragments[f]);
+        }
+        free(jobs[i].fragments);
+    }
+    free(jobs);
+}
+
+static int run_jobs(const DriverOptions *options, CompileJob *jobs)
+{
+    // Target registration touches global LLVM state, so it happens once before any worker starts.
+    initialize_llvm_target();
+
+    size_t jobs_to_run = options->jobs == 0 ? hardware_thread_count() : options->jobs;
+    log_message(LOG_LEVEL_TRACE, "Compiling %zu files with up to %zu jobs", options->input_count, jobs_to_run);
+    thread_pool_run(options->input_count, jobs_to_run, compile_job, jobs);
+
+    int result = EXIT_SUCCESS;
+    for (size_t i = 0; i < options->input_count; i++)
+    {
+        if (jobs[i].result != EXIT_SUCCESS)
+        {
+            log_message(LOG_LEVEL_ERROR, "Compilation of %s failed", jobs[i].input);
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}
+
+static int driver_run(const DriverOptions *options, const CodegenOptions *codegen, CompileJob *jobs)
+{
+    ASTNode **roots = (ASTNode **)calloc(options->input_count, sizeof(ASTNode *));
+    if (roots == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while setting up the JIT");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < options->input_count; i++)
+    {
+        roots[i] = jobs[i].ast->root;
+    }
+
+    int exit_code = EXIT_FAILURE;
+    TimingScope timer = timing_begin("jit", NULL);
+    int result = run_jit_from_asts(roots, options->inputs, options->input_count, codegen, &exit_code);
+    timing_end(&timer);
+    free(roots);
+    return result == EXIT_SUCCESS ? exit_code : result;
+}
+
+static int driver_link(const DriverOptions *options, CompileJob *jobs)
+{
+    size_t object_count = 0;
+    for (size_t i = 0; i < options->input_count; i++)
+    {
+        object_count += jobs[i].fragments != NULL ? jobs[i].fragment_count : 1;
+    }
+    ObjectBuffer *objects = (ObjectBuffer *)calloc(object_count + 1, sizeof(ObjectBuffer));
+    if (objects == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while collecting object files");
+        return EXIT_FAILURE;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < options->input_count; i++)
+    {
+        if (jobs[i].fragments == NULL)
+        {
+            objects[count++] = jobs[i].object;
+            continue;
+        }
+        for (size_t f = 0; f < jobs[i].fragment_count; f++)
+        {
+            objects[count++] = jobs[i].fragments[f];
+        }
+    }
+
+    int result = EXIT_SUCCESS;
+    ObjectBuffer program = {NULL, 0, NULL, NULL};
+    if (options->codegen.lto)
+    {
+        TimingScope lto_timer = timing_begin("lto", options->output);
+        result = link_time_optimize(objects, object_count, &program, &options->codegen);
+        timing_end(&lto_timer);
+    }
+
+    ensure_build_directory_exists();
+    if (result == EXIT_SUCCESS)
+    {
+        TimingScope timer = timing_begin("link", options->output);
+        if (options->codegen.lto)
+        {
+            result = link_executable(&program, 1, options->output, &options->linker);
+        }
+        else
+        {
+            result = link_executable(objects, object_count, options->output, &options->linker);
+        }
+        timing_end(&timer);
+    }
+    object_buffer_dispose(&program);
+    free(objects);
+    return result;
+}
+
+int driver_compile(const DriverOptions *options)
+{
+    if (options->time_report || options->trace_path != NULL)
+    {
+        timing_enable(options->time_report, options->trace_path);
+    }
+    TimingScope timer = timing_begin("total", NULL);
+
+    CodegenOptions codegen = options->codegen;
+    Profile profile;
+    int result = EXIT_SUCCESS;
+    if (options->profile_use != NULL)
+    {
+        TimingScope profile_timer = timing_begin("load profile", options->profile_use);
+        result = profile_load(options->profile_use, &profile);
+        timing_end(&profile_timer);
+        codegen.profile = result == EXIT_SUCCESS ? &profile : NULL;
+    }
+
+    CompileJob *jobs = result == EXIT_SUCCESS ? create_jobs(options, &codegen) : NULL;
+    result = jobs != NULL ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (result == EXIT_SUCCESS && options->cache.enabled && !options->run)
+    {
+        result = cache_prepare(&options->cache);
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        result = run_jobs(options, jobs);
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        result = options->run ? driver_run(options, &codegen, jobs) : driver_link(options, jobs);
+    }
+
+    if (jobs != NULL)
+    {
+        destroy_jobs(options, jobs);
+    }
+    if (codegen.profile != NULL)
+    {
+        profile_destroy(&profile);
+    }
+    timing_end(&timer);
+    timing_finish();
+    return result;
+}
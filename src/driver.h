@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "cache.h"
+#include "linker.h"
+#include "llvm.h"
+#include "profile.h"
+
+typedef struct
+{
+    const char **inputs;
+    size_t input_count;
+    const char *output;
+    size_t jobs;
+    uint8_t run;
+    CodegenOptions codegen;
+    LinkerOptions linker;
+    CacheOptions cache;
+    // Cache an object per function and recompile only the functions that changed.
+    uint8_t incremental;
+    // Split every file into up to this many parts that are code-generated on
+    // separate threads; 0 and 1 keep one module per file.
+    size_t partitions;
+    // Profile whose counts are loaded into codegen.profile, or NULL.
+    const char *profile_use;
+    uint8_t time_report;
+    const char *trace_path;
+} DriverOptions;
+
+int driver_compile(const DriverOptions *options);
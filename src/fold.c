@@ -0,0 +1,382 @@
+#include "fold.h"
+#include "log.h"
+#include <math.h>
+#include <stdlib.h>
+
+typedef struct
+{
+    size_t folded;
+    int result;
+} FoldContext;
+
+static int fold_error(FoldContext *context, const ASTNode *node, const char *message)
+{
+    log_message(LOG_LEVEL_ERROR, "Error: %s at line %u", message, node->line);
+    context->result = EXIT_FAILURE;
+    return EXIT_FAILURE;
+}
+
+static double round_to_type(const Type *type, double value)
+{
+    return type->kind == TYPE_F32 ? (double)(float)value : value;
+}
+
+static int compare_values(BinaryOperator op, int order)
+{
+    switch (op)
+    {
+    case BINARY_EQ:
+        return order == 0;
+    case BINARY_NE:
+        return order != 0;
+    case BINARY_LT:
+        return order < 0;
+    case BINARY_LE:
+        return order <= 0;
+    case BINARY_GT:
+        return order > 0;
+    default:
+        return order >= 0;
+    }
+}
+
+static int fold_float_binary(BinaryASTNode *binary, LiteralASTNode *left, const LiteralASTNode *right)
+{
+    const Type *type = binary->left->value_type;
+    double a = left->float_value;
+    double b = right->float_value;
+    double value = 0.0;
+    switch (binary->op)
+    {
+    case BINARY_ADD:
+        value = a + b;
+        break;
+    case BINARY_SUB:
+        value = a - b;
+        break;
+    case BINARY_MUL:
+        value = a * b;
+        break;
+    case BINARY_DIV:
+        value = a / b;
+        break;
+    case BINARY_REM:
+        value = fmod(a, b);
+        break;
+    default:
+        // NaN compares unequal and unordered, matching the ordered predicates codegen uses.
+        if (isnan(a) || isnan(b))
+        {
+            left->value = binary->op == BINARY_NE;
+        }
+        else
+        {
+            left->value = (uint64_t)compare_values(binary->op, (a > b) - (a < b));
+        }
+        left->kind = LITERAL_BOOL;
+        return EXIT_SUCCESS;
+    }
+    left->float_value = round_to_type(type, value);
+    return EXIT_SUCCESS;
+}
+
+static int fold_integer_binary(FoldContext *context, BinaryASTNode *binary, LiteralASTNode *left, const LiteralASTNode *right)
+{
+    const Type *type = binary->left->value_type;
+    uint64_t a = left->value;
+    uint64_t b = right->value;
+    uint64_t value = 0;
+    switch (binary->op)
+    {
+    case BINARY_ADD:
+        value = a + b;
+        break;
+    case BINARY_SUB:
+        value = a - b;
+        break;
+    case BINARY_MUL:
+        value = a * b;
+        break;
+    case BINARY_DIV:
+    case BINARY_REM:
+        if (b == 0)
+        {
+            return fold_error(context, (ASTNode *)binary, "Division by zero");
+        }
+        if (type->is_signed)
+        {
+            // Values are sign-extended, so the minimum of the type is its own negation.
+            if ((int64_t)b == -1 && a == type_wrap_integer(type, UINT64_C(1) << (type->bits - 1)))
+            {
+                return fold_error(context, (ASTNode *)binary, "Signed division overflow");
+            }
+            value = binary->op == BINARY_DIV ? (uint64_t)((int64_t)a / (int64_t)b) : (uint64_t)((int64_t)a % (int64_t)b);
+        }
+        else
+        {
+            value = binary->op == BINARY_DIV ? a / b : a % b;
+        }
+        break;
+    case BINARY_AND:
+        value = a & b;
+        break;
+    case BINARY_OR:
+        value = a | b;
+        break;
+    case BINARY_XOR:
+        value = a ^ b;
+        break;
+    case BINARY_SHL:
+    case BINARY_SHR:
+        if (b >= type->bits)
+        {
+            return fold_error(context, (ASTNode *)binary, "Shift amount exceeds the operand width");
+        }
+        if (binary->op == BINARY_SHL)
+            value = a << b;
+        else
+            value = type->is_signed ? (uint64_t)((int64_t)a >> b) : a >> b;
+        break;
+    default:
+    {
+        int order = type->is_signed ? ((int64_t)a > (int64_t)b) - ((int64_t)a < (int64_t)b) : (a > b) - (a < b);
+        left->value = (uint64_t)compare_values(binary->op, order);
+        left->kind = LITERAL_BOOL;
+        return EXIT_SUCCESS;
+    }
+    }
+    left->value = type_wrap_integer(type, value);
+    return EXIT_SUCCESS;
+}
+
+static int fold_cast(FoldContext *context, const CastASTNode *cast, LiteralASTNode *literal)
+{
+    const Type *source = cast->operand->value_type;
+    const Type *target = cast->target_type;
+    if (type_is_float(target))
+    {
+        double value = type_is_float(source) ? literal->float_value : source->is_signed ? (double)(int64_t)literal->value : (double)literal->value;
+        literal->float_value = round_to_type(target, value);
+        literal->kind = LITERAL_FLOAT;
+        return EXIT_SUCCESS;
+    }
+    if (type_is_float(source))
+    {
+        // fptosi/fptoui are poison outside the target range, so reject those constants.
+        double value = trunc(literal->float_value);
+        double low = target->is_signed ? -ldexp(1.0, target->bits - 1) : 0.0;
+        double high = ldexp(1.0, target->is_signed ? target->bits - 1 : target->bits);
+        if (isnan(value) || value < low || value >= high)
+        {
+            return fold_error(context, (const ASTNode *)cast, "Constant is out of range for the conversion");
+        }
+        literal->value = target->is_signed ? (uint64_t)(int64_t)value : (uint64_t)value;
+    }
+    literal->value = type_wrap_integer(target, literal->value);
+    literal->kind = LITERAL_INTEGER;
+    return EXIT_SUCCESS;
+}
+
+// Returns the node that should replace `node`. Folded results reuse an operand's
+// literal node, so folding never allocates.
+static ASTNode *fold_expression(FoldContext *context, ASTNode *node)
+{
+    LiteralASTNode *literal = NULL;
+    int result = EXIT_FAILURE;
+    switch (node->type)
+    {
+    case AST_UNARY:
+    {
+        UnaryASTNode *unary = (UnaryASTNode *)node;
+        unary->operand = fold_expression(context, unary->operand);
+        if (unary->operand->type != AST_LITERAL)
+        {
+            return node;
+        }
+        literal = (LiteralASTNode *)unary->operand;
+        const Type *type = node->value_type;
+        if (unary->op == UNARY_NOT)
+            literal->value = literal->value == 0;
+        else if (type_is_float(type))
+            literal->float_value = -literal->float_value;
+        else
+            literal->value = type_wrap_integer(type, unary->op == UNARY_NEGATE ? 0 - literal->value : ~literal->value);
+        result = EXIT_SUCCESS;
+        break;
+    }
+    case AST_BINARY:
+    {
+        BinaryASTNode *binary = (BinaryASTNode *)node;
+        binary->left = fold_expression(context, binary->left);
+        binary->right = fold_expression(context, binary->right);
+        if (binary->left->type != AST_LITERAL || binary->right->type != AST_LITERAL)
+        {
+            return node;
+        }
+        literal = (LiteralASTNode *)binary->left;
+        if (type_is_float(binary->left->value_type))
+            result = fold_float_binary(binary, literal, (LiteralASTNode *)binary->right);
+        else
+            result = fold_integer_binary(context, binary, literal, (LiteralASTNode *)binary->right);
+        break;
+    }
+    case AST_CAST:
+    {
+        CastASTNode *cast = (CastASTNode *)node;
+        cast->operand = fold_expression(context, cast->operand);
+        if (cast->operand->type != AST_LITERAL)
+        {
+            return node;
+        }
+        literal = (LiteralASTNode *)cast->operand;
+        result = fold_cast(context, cast, literal);
+        break;
+    }
+    case AST_INDEX:
+    {
+        IndexASTNode *index = (IndexASTNode *)node;
+        index->sequence = fold_expression(context, index->sequence);
+        index->index = fold_expression(context, index->index);
+        return node;
+    }
+    case AST_SLICE:
+    {
+        SliceASTNode *slice = (SliceASTNode *)node;
+        slice->sequence = fold_expression(context, slice->sequence);
+        if (slice->start != NULL)
+            slice->start = fold_expression(context, slice->start);
+        if (slice->end != NULL)
+            slice->end = fold_expression(context, slice->end);
+        return node;
+    }
+    case AST_ARRAY_LITERAL:
+    {
+        ArrayLiteralASTNode *array = (ArrayLiteralASTNode *)node;
+        if (array->repeat_value != NULL)
+            array->repeat_value = fold_expression(context, array->repeat_value);
+        for (size_t i = 0; i < array->element_count; i++)
+            array->elements[i] = fold_expression(context, array->elements[i]);
+        return node;
+    }
+    case AST_NEW:
+    {
+        NewASTNode *new_node = (NewASTNode *)node;
+        new_node->count = fold_expression(context, new_node->count);
+        return node;
+    }
+    case AST_CALL:
+    {
+        CallASTNode *call = (CallASTNode *)node;
+        for (size_t i = 0; i < call->argument_count; i++)
+            call->arguments[i] = fold_expression(context, call->arguments[i]);
+        return node;
+    }
+    case AST_VECTOR:
+    {
+        VectorASTNode *vector = (VectorASTNode *)node;
+        for (size_t i = 0; i < vector->element_count; i++)
+            vector->elements[i] = fold_expression(context, vector->elements[i]);
+        return node;
+    }
+    default:
+        return node;
+    }
+    if (result != EXIT_SUCCESS)
+    {
+        return node;
+    }
+    literal->base.value_type = node->value_type;
+    context->folded++;
+    return (ASTNode *)literal;
+}
+
+static void fold_statement(FoldContext *context, ASTNode *statement)
+{
+    switch (statement->type)
+    {
+    case AST_RETURN:
+    {
+        ReturnASTNode *ret = (ReturnASTNode *)statement;
+        ret->value = fold_expression(context, ret->value);
+        break;
+    }
+    case AST_LET:
+    {
+        LetASTNode *let = (LetASTNode *)statement;
+        let->value = fold_expression(context, let->value);
+        break;
+    }
+    case AST_ASSIGN:
+    {
+        AssignASTNode *assign = (AssignASTNode *)statement;
+        assign->target = fold_expression(context, assign->target);
+        assign->value = fold_expression(context, assign->value);
+        break;
+    }
+    case AST_DELETE:
+    {
+        DeleteASTNode *node = (DeleteASTNode *)statement;
+        node->value = fold_expression(context, node->value);
+        break;
+    }
+    case AST_EXPRESSION:
+    {
+        ExpressionASTNode *node = (ExpressionASTNode *)statement;
+        node->expression = fold_expression(context, node->expression);
+        break;
+    }
+    case AST_IF:
+    {
+        IfASTNode *node = (IfASTNode *)statement;
+        node->condition = fold_expression(context, node->condition);
+        fold_statement(context, node->then_block);
+        if (node->else_branch != NULL)
+        {
+            fold_statement(context, node->else_branch);
+        }
+        break;
+    }
+    case AST_WHILE:
+    {
+        WhileASTNode *node = (WhileASTNode *)statement;
+        node->condition = fold_expression(context, node->condition);
+        fold_statement(context, node->body);
+        break;
+    }
+    case AST_FOR:
+    {
+        ForASTNode *node = (ForASTNode *)statement;
+        node->start = fold_expression(context, node->start);
+        node->end = fold_expression(context, node->end);
+        fold_statement(context, node->body);
+        break;
+    }
+    case AST_BLOCK:
+    {
+        BlockASTNode *block = (BlockASTNode *)statement;
+        for (size_t i = 0; i < block->statement_count; i++)
+        {
+            fold_statement(context, block->statements[i]);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+int fold_constants(AST *ast)
+{
+    FoldContext context = {0, EXIT_SUCCESS};
+    TranslationUnitASTNode *unit = (TranslationUnitASTNode *)ast->root;
+    for (size_t i = 0; i < unit->function_count; i++)
+    {
+        FunctionASTNode *function = (FunctionASTNode *)unit->functions[i];
+        if (function->body != NULL)
+        {
+            fold_statement(&context, function->body);
+        }
+    }
+    log_message(LOG_LEVEL_TRACE, "Folded %zu constant expressions", context.folded);
+    return context.result;
+}
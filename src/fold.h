@@ -0,0 +1,10 @@
+#pragma once
+#include "ast.h"
+
+// Collapses constant subexpressions into literals so codegen never emits IR for
+// arithmetic whose result is already known. Integers wrap to the width of their
+// type, exactly as the emitted instructions would. Fails on constant division by
+// zero, signed division overflow, over-wide shifts and out-of-range float to
+// integer conversions, which would all be undefined at run time. Runs after
+// sema_check.
+int fold_constants(AST *ast);
@@ -0,0 +1,109 @@
+#include "hash.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ull
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME_3 0x165667B19E3779F9ull
+#define HASH_PRIME_4 0x85EBCA77C2B2AE63ull
+
+static inline uint64_t rotate_left(uint64_t value, int shift)
+{
+    return (value << shift) | (value >> (64 - shift));
+}
+
+static inline uint64_t read_word(const unsigned char *bytes)
+{
+    uint64_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+static inline void mix_word(Hasher *hasher, uint64_t word)
+{
+    hasher->lanes[0] = rotate_left(hasher->lanes[0] ^ (word * HASH_PRIME_1), 31) * HASH_PRIME_2;
+    hasher->lanes[1] = rotate_left(hasher->lanes[1] ^ (word * HASH_PRIME_3), 27) * HASH_PRIME_4;
+}
+
+static inline uint64_t avalanche(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xFF51AFD7ED558CCDull;
+    value ^= value >> 33;
+    value *= 0xC4CEB9FE1A85EC53ull;
+    value ^= value >> 33;
+    return value;
+}
+
+void hasher_init(Hasher *hasher)
+{
+    hasher->lanes[0] = HASH_PRIME_1 ^ HASH_PRIME_4;
+    hasher->lanes[1] = HASH_PRIME_2 ^ HASH_PRIME_3;
+    hasher->total_length = 0;
+    hasher->pending_length = 0;
+}
+
+void hasher_update(Hasher *hasher, const void *data, size_t length)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    hasher->total_length += length;
+
+    if (hasher->pending_length > 0)
+    {
+        size_t needed = sizeof(hasher->pending) - hasher->pending_length;
+        size_t taken = length < needed ? length : needed;
+        memcpy(hasher->pending + hasher->pending_length, bytes, taken);
+        hasher->pending_length += taken;
+        bytes += taken;
+        length -= taken;
+        if (hasher->pending_length < sizeof(hasher->pending))
+        {
+            return;
+        }
+        mix_word(hasher, read_word(hasher->pending));
+        hasher->pending_length = 0;
+    }
+
+    while (length >= 8)
+    {
+        mix_word(hasher, read_word(bytes));
+        bytes += 8;
+        length -= 8;
+    }
+
+    memcpy(hasher->pending, bytes, length);
+    hasher->pending_length = length;
+}
+
+void hasher_update_string(Hasher *hasher, const char *text)
+{
+    // Include the terminator so consecutive strings cannot run into each other.
+    hasher_update(hasher, text, strlen(text) + 1);
+}
+
+Hash128 hasher_finish(const Hasher *hasher)
+{
+    Hasher final = *hasher;
+    unsigned char tail[8] = {0};
+    memcpy(tail, final.pending, final.pending_length);
+    mix_word(&final, read_word(tail) ^ ((uint64_t)final.pending_length << 56));
+    mix_word(&final, final.total_length);
+
+    Hash128 hash;
+    hash.low = avalanche(final.lanes[0] + final.lanes[1]);
+    hash.high = avalanche(final.lanes[1] ^ rotate_left(final.lanes[0], 17));
+    return hash;
+}
+
+Hash128 hash_bytes(const void *data, size_t length)
+{
+    Hasher hasher;
+    hasher_init(&hasher);
+    hasher_update(&hasher, data, length);
+    return hasher_finish(&hasher);
+}
+
+void hash_to_hex(Hash128 hash, char out[HASH_HEX_SIZE])
+{
+    snprintf(out, HASH_HEX_SIZE, "%016llx%016llx", (unsigned long long)hash.high, (unsigned long long)hash.low);
+}
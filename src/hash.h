@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_HEX_SIZE 33
+
+typedef struct
+{
+    uint64_t low;
+    uint64_t high;
+} Hash128;
+
+// Streaming 128-bit non-cryptographic hash. Feeding the same bytes in any chunking
+// produces the same result.
+typedef struct
+{
+    uint64_t lanes[2];
+    uint64_t total_length;
+    unsigned char pending[8];
+    size_t pending_length;
+} Hasher;
+
+void hasher_init(Hasher *hasher);
+
+void hasher_update(Hasher *hasher, const void *data, size_t length);
+
+void hasher_update_string(Hasher *hasher, const char *text);
+
+Hash128 hasher_finish(const Hasher *hasher);
+
+Hash128 hash_bytes(const void *data, size_t length);
+
+void hash_to_hex(Hash128 hash, char out[HASH_HEX_SIZE]);
@@ -0,0 +1,704 @@
+#include "interface.h"
+#include "lexer.h"
+#include "log.h"
+#include "sema.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef JPP_VERSION
+#define JPP_VERSION "unknown"
+#endif
+
+#define INTERFACE_PATH_SIZE 4096
+
+static const char interface_magic[4] = {'J', 'P', 'P', 'I'};
+
+int module_path_append(char *path, size_t size, size_t *length, const char *name, size_t name_length)
+{
+    size_t separator = *length > 0;
+    if (*length + separator + name_length + sizeof(".jpp") > size)
+    {
+        return EXIT_FAILURE;
+    }
+    if (separator)
+    {
+        path[(*length)++] = '/';
+    }
+    memcpy(path + *length, name, name_length);
+    *length += name_length;
+    memcpy(path + *length, ".jpp", sizeof(".jpp"));
+    return EXIT_SUCCESS;
+}
+
+static int interface_path(const char *source_path, char *path, size_t size)
+{
+    return snprintf(path, size, "%si", source_path) < (int)size ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static Hash128 interface_source_hash(const SourceBuffer *source)
+{
+    Hasher hasher;
+    hasher_init(&hasher);
+    hasher_update_string(&hasher, "jpp interface " JPP_VERSION);
+    hasher_update(&hasher, source->data, source->size);
+    return hasher_finish(&hasher);
+}
+
+static void visit_calls(ASTNode *node, void (*visit)(CallASTNode *, void *), void *data)
+{
+    if (node == NULL)
+    {
+        return;
+    }
+    switch (node->type)
+    {
+    case AST_BLOCK:
+    {
+        BlockASTNode *block = (BlockASTNode *)node;
+        for (size_t i = 0; i < block->statement_count; i++)
+            visit_calls(block->statements[i], visit, data);
+        break;
+    }
+    case AST_RETURN:
+        visit_calls(((ReturnASTNode *)node)->value, visit, data);
+        break;
+    case AST_LET:
+        visit_calls(((LetASTNode *)node)->value, visit, data);
+        break;
+    case AST_ASSIGN:
+        visit_calls(((AssignASTNode *)node)->target, visit, data);
+        visit_calls(((AssignASTNode *)node)->value, visit, data);
+        break;
+    case AST_IF:
+        visit_calls(((IfASTNode *)node)->condition, visit, data);
+        visit_calls(((IfASTNode *)node)->then_block, visit, data);
+        visit_calls(((IfASTNode *)node)->else_branch, visit, data);
+        break;
+    case AST_WHILE:
+        visit_calls(((WhileASTNode *)node)->condition, visit, data);
+        visit_calls(((WhileASTNode *)node)->body, visit, data);
+        break;
+    case AST_FOR:
+        visit_calls(((ForASTNode *)node)->start, visit, data);
+        visit_calls(((ForASTNode *)node)->end, visit, data);
+        visit_calls(((ForASTNode *)node)->body, visit, data);
+        break;
+    case AST_DELETE:
+        visit_calls(((DeleteASTNode *)node)->value, visit, data);
+        break;
+    case AST_EXPRESSION:
+        visit_calls(((ExpressionASTNode *)node)->expression, visit, data);
+        break;
+    case AST_BINARY:
+        visit_calls(((BinaryASTNode *)node)->left, visit, data);
+        visit_calls(((BinaryASTNode *)node)->right, visit, data);
+        break;
+    case AST_UNARY:
+        visit_calls(((UnaryASTNode *)node)->operand, visit, data);
+        break;
+    case AST_CAST:
+        visit_calls(((CastASTNode *)node)->operand, visit, data);
+        break;
+    case AST_INDEX:
+        visit_calls(((IndexASTNode *)node)->sequence, visit, data);
+        visit_calls(((IndexASTNode *)node)->index, visit, data);
+        break;
+    case AST_SLICE:
+        visit_calls(((SliceASTNode *)node)->sequence, visit, data);
+        visit_calls(((SliceASTNode *)node)->start, visit, data);
+        visit_calls(((SliceASTNode *)node)->end, visit, data);
+        break;
+    case AST_ARRAY_LITERAL:
+    {
+        ArrayLiteralASTNode *array = (ArrayLiteralASTNode *)node;
+        visit_calls(array->repeat_value, visit, data);
+        for (size_t i = 0; i < array->element_count; i++)
+            visit_calls(array->elements[i], visit, data);
+        break;
+    }
+    case AST_NEW:
+        visit_calls(((NewASTNode *)node)->count, visit, data);
+        break;
+    case AST_CALL:
+    {
+        CallASTNode *call = (CallASTNode *)node;
+        for (size_t i = 0; i < call->argument_count; i++)
+            visit_calls(call->arguments[i], visit, data);
+        visit(call, data);
+        break;
+    }
+    case AST_VECTOR:
+    {
+        VectorASTNode *vector = (VectorASTNode *)node;
+        for (size_t i = 0; i < vector->element_count; i++)
+            visit_calls(vector->elements[i], visit, data);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void find_non_builtin_call(CallASTNode *call, void *data)
+{
+    if (!sema_is_builtin(call->name))
+    {
+        *(int *)data = 1;
+    }
+}
+
+// Only inline functions that call nothing but builtins carry their body, since
+// the importer could not resolve the other functions of their module.
+static int exports_body(const FunctionASTNode *function)
+{
+    if (!(function->flags & FUNCTION_INLINE))
+    {
+        return 0;
+    }
+    int calls_functions = 0;
+    visit_calls(function->body, find_non_builtin_call, &calls_functions);
+    return !calls_functions;
+}
+
+static int is_exported_definition(const ASTNode *node)
+{
+    const FunctionASTNode *function = (const FunctionASTNode *)node;
+    return (function->flags & FUNCTION_EXPORT) && function->body != NULL;
+}
+
+static int compare_function_names(const void *a, const void *b)
+{
+    return strcmp((*(const FunctionASTNode *const *)a)->name, (*(const FunctionASTNode *const *)b)->name);
+}
+
+// Lays out the interface of every exported definition in one heap block.
+static int interface_build(const AST *ast, const SourceBuffer *source, const FileStamp *stamp, char **data, size_t *size)
+{
+    const TranslationUnitASTNode *unit = (const TranslationUnitASTNode *)ast->root;
+    const FunctionASTNode **functions = (const FunctionASTNode **)malloc((unit->function_count + 1) * sizeof(FunctionASTNode *));
+    if (functions == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    size_t count = 0;
+    size_t string_size = 0;
+    for (size_t i = 0; i < unit->function_count; i++)
+    {
+        if (is_exported_definition(unit->functions[i]))
+        {
+            const FunctionASTNode *function = (const FunctionASTNode *)unit->functions[i];
+            functions[count++] = function;
+            size_t text_length = exports_body(function) ? sizeof("inline ") - 1 + function->end_offset - function->name_offset : sizeof("extern ") - 1 + function->signature_end - function->name_offset + 1;
+            string_size += strlen(function->name) + 1 + text_length + 1;
+        }
+    }
+    qsort(functions, count, sizeof(FunctionASTNode *), compare_function_names);
+
+    size_t total = sizeof(InterfaceHeader) + count * sizeof(InterfaceEntry) + string_size;
+    char *file = string_size <= UINT32_MAX ? (char *)malloc(total) : NULL;
+    if (file == NULL)
+    {
+        free(functions);
+        return EXIT_FAILURE;
+    }
+    InterfaceHeader *header = (InterfaceHeader *)file;
+    memcpy(header->magic, interface_magic, sizeof(interface_magic));
+    header->version = INTERFACE_VERSION;
+    header->function_count = (uint32_t)count;
+    header->string_size = (uint32_t)string_size;
+    header->source_stamp = *stamp;
+    header->source_hash = interface_source_hash(source);
+
+    InterfaceEntry *entries = (InterfaceEntry *)(file + sizeof(InterfaceHeader));
+    char *strings = (char *)(entries + count);
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const FunctionASTNode *function = functions[i];
+        size_t name_length = strlen(function->name);
+        entries[i].name_offset = (uint32_t)offset;
+        entries[i].name_length = (uint32_t)name_length;
+        memcpy(strings + offset, function->name, name_length + 1);
+        offset += name_length + 1;
+
+        const char *text = source->data + function->name_offset;
+        int with_body = exports_body(function);
+        size_t length = with_body ? function->end_offset - function->name_offset : function->signature_end - function->name_offset;
+        size_t start = offset;
+        entries[i].text_offset = (uint32_t)start;
+        memcpy(strings + offset, with_body ? "inline " : "extern ", sizeof("inline ") - 1);
+        offset += sizeof("inline ") - 1;
+        memcpy(strings + offset, text, length);
+        offset += length;
+        if (!with_body)
+        {
+            strings[offset++] = ';';
+        }
+        entries[i].text_length = (uint32_t)(offset - start);
+        strings[offset++] = '\0';
+    }
+    free(functions);
+    *data = file;
+    *size = total;
+    return EXIT_SUCCESS;
+}
+
+// Takes over `file` if it holds a well-formed interface of the stamped source.
+static int interface_attach(Interface *interface, SourceBuffer *file, const FileStamp *stamp)
+{
+    if (file->size < sizeof(InterfaceHeader))
+    {
+        return EXIT_FAILURE;
+    }
+    const InterfaceHeader *header = (const InterfaceHeader *)file->data;
+    if (memcmp(header->magic, interface_magic, sizeof(interface_magic)) != 0 || header->version != INTERFACE_VERSION)
+    {
+        return EXIT_FAILURE;
+    }
+    if (header->source_stamp.size != stamp->size || header->source_stamp.modified != stamp->modified)
+    {
+        return EXIT_FAILURE;
+    }
+    if ((uint64_t)file->size != sizeof(InterfaceHeader) + (uint64_t)header->function_count * sizeof(InterfaceEntry) + header->string_size)
+    {
+        return EXIT_FAILURE;
+    }
+    interface->file = *file;
+    interface->source_hash = header->source_hash;
+    interface->entries = (const InterfaceEntry *)(file->data + sizeof(InterfaceHeader));
+    interface->function_count = header->function_count;
+    interface->strings = (const char *)(interface->entries + header->function_count);
+    interface->string_size = header->string_size;
+    return EXIT_SUCCESS;
+}
+
+static int interface_map(const char *path, const FileStamp *stamp, Interface *interface)
+{
+    // A missing interface is expected, and source_buffer_open would report it.
+    FILE *probe = fopen(path, "rb");
+    if (probe == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    fclose(probe);
+
+    SourceBuffer file;
+    if (source_buffer_open(path, &file) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    if (interface_attach(interface, &file, stamp) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_TRACE, "Interface %s is out of date", path);
+        source_buffer_close(&file);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void interface_update(const AST *ast, const SourceBuffer *source, const char *source_path, const FileStamp *stamp)
+{
+    const TranslationUnitASTNode *unit = (const TranslationUnitASTNode *)ast->root;
+    size_t exported = 0;
+    for (size_t i = 0; i < unit->function_count; i++)
+    {
+        exported += is_exported_definition(unit->functions[i]);
+    }
+    char path[INTERFACE_PATH_SIZE];
+    if (exported == 0 || interface_path(source_path, path, sizeof(path)) != EXIT_SUCCESS)
+    {
+        return;
+    }
+
+    Interface current;
+    if (interface_map(path, stamp, &current) == EXIT_SUCCESS)
+    {
+        interface_close(&current);
+        return;
+    }
+    char *data = NULL;
+    size_t size = 0;
+    if (interface_build(ast, source, stamp, &data, &size) != EXIT_SUCCESS || file_write_atomic(path, data, size) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_WARN, "Could not write interface %s", path);
+        free(data);
+        return;
+    }
+    free(data);
+    log_message(LOG_LEVEL_TRACE, "Wrote interface %s with %zu functions", path, exported);
+}
+
+int interface_open(const char *source_path, Interface *interface)
+{
+    char path[INTERFACE_PATH_SIZE];
+    if (interface_path(source_path, path, sizeof(path)) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    FileStamp stamp;
+    if (file_stamp(source_path, &stamp) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not open file %s", source_path);
+        return EXIT_FAILURE;
+    }
+    if (interface_map(path, &stamp, interface) == EXIT_SUCCESS)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    // Only the exported signatures are needed, so parsing the module is enough.
+    log_message(LOG_LEVEL_TRACE, "Regenerating interface %s", path);
+    SourceBuffer source;
+    if (source_buffer_open(source_path, &source) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    AST *ast = ast_parse_source(&source);
+    char *data = NULL;
+    size_t size = 0;
+    int built = ast != NULL ? interface_build(ast, &source, &stamp, &data, &size) : EXIT_FAILURE;
+    ast_destroy(ast);
+    source_buffer_close(&source);
+    if (built != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not build the interface of %s", source_path);
+        return EXIT_FAILURE;
+    }
+    if (file_write_atomic(path, data, size) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_WARN, "Could not write interface %s", path);
+    }
+    SourceBuffer file = {data, size, 0};
+    if (interface_attach(interface, &file, &stamp) != EXIT_SUCCESS)
+    {
+        free(data);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+const char *interface_lookup(const Interface *interface, const char *name, size_t *length)
+{
+    size_t low = 0;
+    size_t high = interface->function_count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        const InterfaceEntry *entry = &interface->entries[middle];
+        if ((uint64_t)entry->name_offset + entry->name_length >= interface->string_size ||
+            (uint64_t)entry->text_offset + entry->text_length >= interface->string_size)
+        {
+            log_message(LOG_LEVEL_ERROR, "Malformed interface entry %zu", middle);
+            return NULL;
+        }
+        int order = strncmp(name, interface->strings + entry->name_offset, entry->name_length);
+        if (order == 0 && name[entry->name_length] != '\0')
+        {
+            order = 1;
+        }
+        if (order == 0)
+        {
+            *length = entry->text_length;
+            return interface->strings + entry->text_offset;
+        }
+        if (order < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+void interface_close(Interface *interface)
+{
+    source_buffer_close(&interface->file);
+    memset(interface, 0, sizeof(*interface));
+}
+
+static int import_set_add(ImportSet *imports, const char *path)
+{
+    for (size_t i = 0; i < imports->count; i++)
+    {
+        if (strcmp(imports->paths[i], path) == 0)
+        {
+            return EXIT_SUCCESS;
+        }
+    }
+    char **paths = (char **)realloc(imports->paths, (imports->count + 1) * sizeof(char *));
+    if (paths == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    imports->paths = paths;
+    Interface *interfaces = (Interface *)realloc(imports->interfaces, (imports->count + 1) * sizeof(Interface));
+    if (interfaces == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    imports->interfaces = interfaces;
+    imports->paths[imports->count] = (char *)malloc(strlen(path) + 1);
+    if (imports->paths[imports->count] == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    strcpy(imports->paths[imports->count], path);
+    if (interface_open(path, &imports->interfaces[imports->count]) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Could not import %s", path);
+        free(imports->paths[imports->count]);
+        return EXIT_FAILURE;
+    }
+    imports->count++;
+    return EXIT_SUCCESS;
+}
+
+int import_set_open(const SourceBuffer *source, ImportSet *imports)
+{
+    memset(imports, 0, sizeof(*imports));
+    Lexer lexer;
+    lexer_init(&lexer, source->data, source->size);
+    TokenData token = get_next_token(&lexer);
+    while (token.type == TOKEN_IMPORT)
+    {
+        char path[1024];
+        size_t length = 0;
+        token = get_next_token(&lexer);
+        while (token.type == TOKEN_IDENTIFIER &&
+               module_path_append(path, sizeof(path), &length, source->data + token.offset, token.length) == EXIT_SUCCESS)
+        {
+            token = get_next_token(&lexer);
+            if (token.type != TOKEN_DOT)
+            {
+                break;
+            }
+            token = get_next_token(&lexer);
+        }
+        if (token.type != TOKEN_SEMICOLON || length == 0)
+        {
+            return EXIT_SUCCESS;
+        }
+        if (import_set_add(imports, path) != EXIT_SUCCESS)
+        {
+            import_set_close(imports);
+            return EXIT_FAILURE;
+        }
+        token = get_next_token(&lexer);
+    }
+    return EXIT_SUCCESS;
+}
+
+void import_set_hash(const ImportSet *imports, Hasher *hasher)
+{
+    for (size_t i = 0; i < imports->count; i++)
+    {
+        hasher_update_string(hasher, imports->paths[i]);
+        hasher_update(hasher, &imports->interfaces[i].source_hash, sizeof(Hash128));
+    }
+}
+
+void import_set_close(ImportSet *imports)
+{
+    for (size_t i = 0; i < imports->count; i++)
+    {
+        interface_close(&imports->interfaces[i]);
+        free(imports->paths[i]);
+    }
+    free(imports->interfaces);
+    free(imports->paths);
+    memset(imports, 0, sizeof(*imports));
+}
+
+// Open-addressed set of interned names, compared by pointer.
+typedef struct
+{
+    const char **names;
+    size_t capacity;
+    size_t count;
+} NameSet;
+
+static size_t name_slot(const NameSet *set, const char *name)
+{
+    size_t slot = ((uintptr_t)name >> 3) * 0x9E3779B97F4A7C15ull & (set->capacity - 1);
+    while (set->names[slot] != NULL && set->names[slot] != name)
+    {
+        slot = (slot + 1) & (set->capacity - 1);
+    }
+    return slot;
+}
+
+// Returns 1 if the name was added, 0 if it was present, -1 when out of memory.
+static int name_set_add(NameSet *set, const char *name)
+{
+    if ((set->count + 1) * 2 > set->capacity)
+    {
+        size_t capacity = set->capacity == 0 ? 64 : set->capacity * 2;
+        const char **names = (const char **)calloc(capacity, sizeof(const char *));
+        if (names == NULL)
+        {
+            return -1;
+        }
+        const char **old_names = set->names;
+        size_t old_capacity = set->capacity;
+        set->names = names;
+        set->capacity = capacity;
+        for (size_t i = 0; i < old_capacity; i++)
+        {
+            if (old_names[i] != NULL)
+            {
+                set->names[name_slot(set, old_names[i])] = old_names[i];
+            }
+        }
+        free(old_names);
+    }
+    size_t slot = name_slot(set, name);
+    if (set->names[slot] != NULL)
+    {
+        return 0;
+    }
+    set->names[slot] = name;
+    set->count++;
+    return 1;
+}
+
+typedef struct
+{
+    AST *ast;
+    const TranslationUnitASTNode *unit;
+    // The interface of each import of the unit, in the same order.
+    const Interface **interfaces;
+    NameSet known;
+    ASTNode **imported;
+    size_t imported_count;
+    size_t imported_capacity;
+    int result;
+} ImportContext;
+
+// Parses a declaration from an interface into the unit's arena.
+static ASTNode *parse_interface_text(AST *ast, const char *text, size_t length)
+{
+    SourceBuffer buffer = {text, length, 0};
+    TokenStream stream;
+    if (Lexer_build_from_buffer(&buffer, &stream) != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    Parser parser = {&stream, 0, ast, NULL, 0, 0};
+    ASTNode *function = parse_function(&parser);
+    free(parser.scratch);
+    token_stream_free(&stream);
+    return function;
+}
+
+static void import_callee(CallASTNode *call, void *data)
+{
+    ImportContext *context = (ImportContext *)data;
+    if (context->result != EXIT_SUCCESS || sema_is_builtin(call->name))
+    {
+        return;
+    }
+    int added = name_set_add(&context->known, call->name);
+    if (added <= 0)
+    {
+        context->result = added < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+        return;
+    }
+    // The first import that exports the name wins; unknown names are left for
+    // sema_check to report.
+    for (size_t i = 0; i < context->unit->import_count; i++)
+    {
+        size_t length;
+        const char *text = interface_lookup(context->interfaces[i], call->name, &length);
+        if (text == NULL)
+        {
+            continue;
+        }
+        ASTNode *function = parse_interface_text(context->ast, text, length);
+        if (function == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Could not read '%s' from the interface of %s", call->name, context->unit->imports[i]);
+            context->result = EXIT_FAILURE;
+            return;
+        }
+        if (context->imported_count == context->imported_capacity)
+        {
+            size_t capacity = context->imported_capacity == 0 ? 16 : context->imported_capacity * 2;
+            ASTNode **imported = (ASTNode **)realloc(context->imported, capacity * sizeof(ASTNode *));
+            if (imported == NULL)
+            {
+                context->result = EXIT_FAILURE;
+                return;
+            }
+            context->imported = imported;
+            context->imported_capacity = capacity;
+        }
+        context->imported[context->imported_count++] = function;
+        return;
+    }
+}
+
+int resolve_imports(AST *ast, const ImportSet *imports)
+{
+    TranslationUnitASTNode *unit = (TranslationUnitASTNode *)ast->root;
+    if (unit->import_count == 0)
+    {
+        return EXIT_SUCCESS;
+    }
+    ImportContext context = {ast, unit, NULL, {NULL, 0, 0}, NULL, 0, 0, EXIT_SUCCESS};
+    context.interfaces = (const Interface **)calloc(unit->import_count, sizeof(Interface *));
+    if (context.interfaces == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while resolving imports");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < unit->import_count && context.result == EXIT_SUCCESS; i++)
+    {
+        for (size_t j = 0; j < imports->count && context.interfaces[i] == NULL; j++)
+        {
+            if (strcmp(imports->paths[j], unit->imports[i]) == 0)
+            {
+                context.interfaces[i] = &imports->interfaces[j];
+            }
+        }
+        if (context.interfaces[i] == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Could not import %s", unit->imports[i]);
+            context.result = EXIT_FAILURE;
+        }
+    }
+
+    for (size_t i = 0; i < unit->function_count && context.result == EXIT_SUCCESS; i++)
+    {
+        if (name_set_add(&context.known, ((const FunctionASTNode *)unit->functions[i])->name) < 0)
+        {
+            context.result = EXIT_FAILURE;
+        }
+    }
+    for (size_t i = 0; i < unit->function_count && context.result == EXIT_SUCCESS; i++)
+    {
+        visit_calls(((FunctionASTNode *)unit->functions[i])->body, import_callee, &context);
+    }
+
+    if (context.result == EXIT_SUCCESS && context.imported_count > 0)
+    {
+        size_t count = unit->function_count + context.imported_count;
+        ASTNode **functions = (ASTNode **)arena_alloc(&ast->arena, count * sizeof(ASTNode *));
+        if (unit->function_count > 0)
+        {
+            memcpy(functions, unit->functions, unit->function_count * sizeof(ASTNode *));
+        }
+        memcpy(functions + unit->function_count, context.imported, context.imported_count * sizeof(ASTNode *));
+        unit->functions = functions;
+        unit->function_count = count;
+    }
+    log_message(LOG_LEVEL_TRACE, "Imported %zu functions from %zu modules", context.imported_count, unit->import_count);
+
+    free(context.interfaces);
+    free(context.known.names);
+    free(context.imported);
+    return context.result;
+}
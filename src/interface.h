@@ -0,0 +1,83 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+#include "hash.h"
+#include "source.h"
+
+#define INTERFACE_VERSION 2
+
+// A .jppi file, in native byte order: this header, function_count entries sorted
+// by name, then string_size bytes of NUL-terminated strings.
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t function_count;
+    uint32_t string_size;
+    // The stamp of the module source when the file was written. Importers compare
+    // it with stat() instead of reading the source.
+    FileStamp source_stamp;
+    // Hash of the module source, which importers feed into their cache keys.
+    Hash128 source_hash;
+} InterfaceHeader;
+
+// One exported function. Its text is "extern name(...) -> T;", or for inline
+// functions that call only builtins, "inline " and the whole definition.
+typedef struct
+{
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t text_offset;
+    uint32_t text_length;
+} InterfaceEntry;
+
+typedef struct
+{
+    SourceBuffer file;
+    Hash128 source_hash;
+    const InterfaceEntry *entries;
+    uint32_t function_count;
+    const char *strings;
+    uint32_t string_size;
+} Interface;
+
+// Appends one dotted component of an import to a module path, keeping it
+// terminated by ".jpp".
+int module_path_append(char *path, size_t size, size_t *length, const char *name, size_t name_length);
+
+// Writes the interface of a checked unit next to its source, a.jpp to a.jppi,
+// unless the file there is already current. stamp must be taken before the
+// source was read, so an edit made in between leaves the interface stale.
+void interface_update(const AST *ast, const SourceBuffer *source, const char *source_path, const FileStamp *stamp);
+
+// Maps the interface of a module, first regenerating it if it is missing or the
+// source's size or modification time changed since it was written.
+int interface_open(const char *source_path, Interface *interface);
+
+// Returns the text of the named function, or NULL if the module does not export it.
+const char *interface_lookup(const Interface *interface, const char *name, size_t *length);
+
+void interface_close(Interface *interface);
+
+// The interfaces of the modules one unit imports, opened once per compile.
+typedef struct ImportSet
+{
+    char **paths;
+    Interface *interfaces;
+    size_t count;
+} ImportSet;
+
+// Finds the imports at the top of a unit with a short lexer scan and opens their
+// interfaces. Malformed imports are left for the parser to report.
+int import_set_open(const SourceBuffer *source, ImportSet *imports);
+
+// Feeds the source hashes of the imported modules to the hasher, so cached objects
+// follow changes to their imports.
+void import_set_hash(const ImportSet *imports, Hasher *hasher);
+
+void import_set_close(ImportSet *imports);
+
+// Adds a declaration to the unit for every function it calls from its imports,
+// with the body of those that are inline.
+int resolve_imports(AST *ast, const ImportSet *imports);
@@ -0,0 +1,95 @@
+#include "intern.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define INTERN_INITIAL_CAPACITY 256
+
+static uint32_t intern_hash(const char *text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void intern_table_init(InternTable *table, Arena *arena)
+{
+    table->arena = arena;
+    table->count = 0;
+    table->capacity = INTERN_INITIAL_CAPACITY;
+    table->entries = (InternEntry *)calloc(table->capacity, sizeof(InternEntry));
+    if (table->entries == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while creating the string table");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void intern_table_grow(InternTable *table)
+{
+    size_t capacity = table->capacity * 2;
+    InternEntry *entries = (InternEntry *)calloc(capacity, sizeof(InternEntry));
+    if (entries == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while growing the string table");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < table->capacity; i++)
+    {
+        InternEntry *entry = &table->entries[i];
+        if (entry->text == NULL)
+        {
+            continue;
+        }
+        size_t slot = entry->hash & (capacity - 1);
+        while (entries[slot].text != NULL)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = *entry;
+    }
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+}
+
+const char *intern_string(InternTable *table, const char *text, size_t length)
+{
+    uint32_t hash = intern_hash(text, length);
+    size_t slot = hash & (table->capacity - 1);
+    while (table->entries[slot].text != NULL)
+    {
+        InternEntry *entry = &table->entries[slot];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->text, text, length) == 0)
+        {
+            return entry->text;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
+    }
+
+    InternEntry *entry = &table->entries[slot];
+    entry->text = arena_strndup(table->arena, text, length);
+    entry->length = (uint32_t)length;
+    entry->hash = hash;
+    table->count++;
+
+    const char *interned = entry->text;
+    // Keep the load factor under 3/4 so probe sequences stay short.
+    if (table->count * 4 >= table->capacity * 3)
+    {
+        intern_table_grow(table);
+    }
+    return interned;
+}
+
+void intern_table_destroy(InternTable *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
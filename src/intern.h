@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+typedef struct
+{
+    const char *text;
+    uint32_t length;
+    uint32_t hash;
+} InternEntry;
+
+// Deduplicates strings so equal identifiers share one pointer and can be compared with ==.
+typedef struct
+{
+    Arena *arena;
+    InternEntry *entries;
+    size_t count;
+    size_t capacity;
+} InternTable;
+
+void intern_table_init(InternTable *table, Arena *arena);
+
+const char *intern_string(InternTable *table, const char *text, size_t length);
+
+void intern_table_destroy(InternTable *table);
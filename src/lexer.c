@@ -4,159 +4,611 @@
 #include <string.h>
 #include "log.h"
 
-TokenData get_next_token(char **input, uint64_t line_number)
+#if defined(__x86_64__) || defined(_M_X64)
+#define JPP_LEXER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define JPP_TARGET_AVX2
+#else
+#define JPP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#define CHAR_SPACE 0x01
+#define CHAR_NEWLINE 0x02
+#define CHAR_ALPHA 0x04
+#define CHAR_DIGIT 0x08
+#define CHAR_IDENT (CHAR_ALPHA | CHAR_DIGIT)
+
+#define _S CHAR_SPACE
+#define _N (CHAR_SPACE | CHAR_NEWLINE)
+#define _A CHAR_ALPHA
+#define _D CHAR_DIGIT
+
+static const uint8_t char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, _S, _N, 0, 0, _S, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    _S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    _D, _D, _D, _D, _D, _D, _D, _D, _D, _D, 0, 0, 0, 0, 0, 0,
+    0, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A,
+    _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, 0, 0, 0, 0, _A,
+    0, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A,
+    _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, _A, 0, 0, 0, 0, 0,
+    // Bytes >= 0x80 are never part of a token.
+};
+
+#undef _S
+#undef _N
+#undef _A
+#undef _D
+
+#define CHAR_IS(c, mask) (char_class[(unsigned char)(c)] & (mask))
+
+typedef struct ScannerKernels
 {
-    TokenData token;
-    token.type = TOKEN_UNKNOWN;
-    token.lexeme[0] = '\0';
-    token.line = line_number;
+    const char *name;
+    const char *(*skip_whitespace)(const char *cursor, const char *end, uint32_t *line);
+    const char *(*scan_identifier)(const char *cursor, const char *end);
+    const char *(*scan_digits)(const char *cursor, const char *end);
+} ScannerKernels;
 
-    while (**input == ' ' || **input == '\t' || **input == '\n')
+static const char *skip_whitespace_scalar(const char *cursor, const char *end, uint32_t *line)
+{
+    while (cursor < end && CHAR_IS(*cursor, CHAR_SPACE))
     {
-        (*input)++;
+        *line += CHAR_IS(*cursor, CHAR_NEWLINE) != 0;
+        cursor++;
     }
+    return cursor;
+}
 
-    if (**input == '\0')
+static const char *scan_identifier_scalar(const char *cursor, const char *end)
+{
+    while (cursor < end && CHAR_IS(*cursor, CHAR_IDENT))
     {
-        token.type = TOKEN_EOF;
-        return token;
+        cursor++;
     }
-    if (isalpha(**input))
+    return cursor;
+}
+
+static const char *scan_digits_scalar(const char *cursor, const char *end)
+{
+    while (cursor < end && CHAR_IS(*cursor, CHAR_DIGIT))
     {
-        int i = 0;
-        while (isalnum(**input))
+        cursor++;
+    }
+    return cursor;
+}
+
+#ifndef JPP_LEXER_X86
+static const ScannerKernels scalar_kernels = {
+    "scalar",
+    skip_whitespace_scalar,
+    scan_identifier_scalar,
+    scan_digits_scalar};
+#endif
+
+#ifdef JPP_LEXER_X86
+static inline uint32_t lowest_set_bit(uint32_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (uint32_t)index;
+#else
+    return (uint32_t)__builtin_ctz(mask);
+#endif
+}
+
+static inline uint32_t count_set_bits(uint32_t mask)
+{
+    mask = mask - ((mask >> 1) & 0x55555555u);
+    mask = (mask & 0x33333333u) + ((mask >> 2) & 0x33333333u);
+    return (((mask + (mask >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+}
+
+// Signed byte compares are fine here: every range we test lies in 0x00..0x7F, so
+// bytes >= 0x80 compare as negative and fall outside all of them.
+#define SSE2_IN_RANGE(v, lo, hi) _mm_and_si128(_mm_cmpgt_epi8((v), _mm_set1_epi8((char)((lo) - 1))), _mm_cmplt_epi8((v), _mm_set1_epi8((char)((hi) + 1))))
+#define AVX2_IN_RANGE(v, lo, hi) _mm256_and_si256(_mm256_cmpgt_epi8((v), _mm256_set1_epi8((char)((lo) - 1))), _mm256_cmpgt_epi8(_mm256_set1_epi8((char)((hi) + 1)), (v)))
+
+static const char *skip_whitespace_sse2(const char *cursor, const char *end, uint32_t *line)
+{
+    // Most gaps between tokens are a single space, so only vectorize longer runs.
+    if (cursor + 1 >= end || !CHAR_IS(cursor[0], CHAR_SPACE) || !CHAR_IS(cursor[1], CHAR_SPACE))
+    {
+        return skip_whitespace_scalar(cursor, end, line);
+    }
+    while (end - cursor >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)cursor);
+        __m128i newline = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t')));
+        __m128i space = _mm_or_si128(_mm_or_si128(blank, newline), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+        uint32_t space_mask = (uint32_t)_mm_movemask_epi8(space);
+        uint32_t newline_mask = (uint32_t)_mm_movemask_epi8(newline);
+        if (space_mask != 0xFFFFu)
         {
-            token.lexeme[i++] = **input;
-            (*input)++;
+            uint32_t skipped = lowest_set_bit(~space_mask & 0xFFFFu);
+            *line += count_set_bits(newline_mask & ((1u << skipped) - 1));
+            return cursor + skipped;
         }
-        token.lexeme[i] = '\0';
-        if (strcmp(token.lexeme, "return") == 0)
+        *line += count_set_bits(newline_mask);
+        cursor += 16;
+    }
+    return skip_whitespace_scalar(cursor, end, line);
+}
+
+static const char *scan_identifier_sse2(const char *cursor, const char *end)
+{
+    while (end - cursor >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)cursor);
+        __m128i lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+        __m128i ident = _mm_or_si128(SSE2_IN_RANGE(lower, 'a', 'z'), SSE2_IN_RANGE(chunk, '0', '9'));
+        ident = _mm_or_si128(ident, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_')));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(ident);
+        if (mask != 0xFFFFu)
         {
-            token.type = TOKEN_RETURN;
-            log_message(LOG_LEVEL_TRACE, "Recognized 'return' keyword");
+            return cursor + lowest_set_bit(~mask & 0xFFFFu);
         }
-        else if (strcmp(token.lexeme, "uint8") == 0)
+        cursor += 16;
+    }
+    return scan_identifier_scalar(cursor, end);
+}
+
+static const char *scan_digits_sse2(const char *cursor, const char *end)
+{
+    while (end - cursor >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)cursor);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(SSE2_IN_RANGE(chunk, '0', '9'));
+        if (mask != 0xFFFFu)
         {
-            token.type = TOKEN_TYPE;
-            log_message(LOG_LEVEL_TRACE, "Recognized 'uint8' type");
+            return cursor + lowest_set_bit(~mask & 0xFFFFu);
         }
-        else
+        cursor += 16;
+    }
+    return scan_digits_scalar(cursor, end);
+}
+
+static const ScannerKernels sse2_kernels = {
+    "sse2",
+    skip_whitespace_sse2,
+    scan_identifier_sse2,
+    scan_digits_sse2};
+
+JPP_TARGET_AVX2 static const char *skip_whitespace_avx2(const char *cursor, const char *end, uint32_t *line)
+{
+    if (cursor + 1 >= end || !CHAR_IS(cursor[0], CHAR_SPACE) || !CHAR_IS(cursor[1], CHAR_SPACE))
+    {
+        return skip_whitespace_scalar(cursor, end, line);
+    }
+    while (end - cursor >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)cursor);
+        __m256i newline = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t')));
+        __m256i space = _mm256_or_si256(_mm256_or_si256(blank, newline), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')));
+        uint32_t space_mask = (uint32_t)_mm256_movemask_epi8(space);
+        uint32_t newline_mask = (uint32_t)_mm256_movemask_epi8(newline);
+        if (space_mask != 0xFFFFFFFFu)
         {
-            token.type = TOKEN_IDENTIFIER;
-            log_message(LOG_LEVEL_TRACE, "Recognized identifier: %s", token.lexeme);
+            uint32_t skipped = lowest_set_bit(~space_mask);
+            *line += count_set_bits(newline_mask & ((1u << skipped) - 1));
+            return cursor + skipped;
         }
-        return token;
+        *line += count_set_bits(newline_mask);
+        cursor += 32;
     }
-    if (isdigit(**input))
+    return skip_whitespace_sse2(cursor, end, line);
+}
+
+JPP_TARGET_AVX2 static const char *scan_identifier_avx2(const char *cursor, const char *end)
+{
+    while (end - cursor >= 32)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)cursor);
+        __m256i lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+        __m256i ident = _mm256_or_si256(AVX2_IN_RANGE(lower, 'a', 'z'), AVX2_IN_RANGE(chunk, '0', '9'));
+        ident = _mm256_or_si256(ident, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_')));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(ident);
+        if (mask != 0xFFFFFFFFu)
+        {
+            return cursor + lowest_set_bit(~mask);
+        }
+        cursor += 32;
+    }
+    return scan_identifier_sse2(cursor, end);
+}
+
+JPP_TARGET_AVX2 static const char *scan_digits_avx2(const char *cursor, const char *end)
+{
+    while (end - cursor >= 32)
     {
-        int i = 0;
-        while (isdigit(**input))
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)cursor);
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(AVX2_IN_RANGE(chunk, '0', '9'));
+        if (mask != 0xFFFFFFFFu)
         {
-            token.lexeme[i++] = **input;
-            (*input)++;
+            return cursor + lowest_set_bit(~mask);
         }
-        token.lexeme[i] = '\0';
+        cursor += 32;
+    }
+    return scan_digits_sse2(cursor, end);
+}
+
+static const ScannerKernels avx2_kernels = {
+    "avx2",
+    skip_whitespace_avx2,
+    scan_identifier_avx2,
+    scan_digits_avx2};
+
+static int cpu_supports_avx2(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    int has_osxsave = (info[2] & (1 << 27)) != 0;
+    int has_avx = (info[2] & (1 << 28)) != 0;
+    if (!has_osxsave || !has_avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return 0;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static const ScannerKernels *select_kernels(void)
+{
+#ifdef JPP_LEXER_X86
+    if (cpu_supports_avx2())
+    {
+        return &avx2_kernels;
+    }
+    return &sse2_kernels;
+#else
+    return &scalar_kernels;
+#endif
+}
+
+const char *lexer_kernel_name(void)
+{
+    return select_kernels()->name;
+}
+
+static Token lookup_keyword(const char *lexeme, uint32_t length)
+{
+    switch (length)
+    {
+    case 2:
+        if (memcmp(lexeme, "as", 2) == 0)
+            return TOKEN_AS;
+        if (memcmp(lexeme, "if", 2) == 0)
+            return TOKEN_IF;
+        if (memcmp(lexeme, "in", 2) == 0)
+            return TOKEN_IN;
+        break;
+    case 3:
+        if (memcmp(lexeme, "f32", 3) == 0 || memcmp(lexeme, "f64", 3) == 0)
+            return TOKEN_TYPE;
+        if (memcmp(lexeme, "let", 3) == 0)
+            return TOKEN_LET;
+        if (memcmp(lexeme, "for", 3) == 0)
+            return TOKEN_FOR;
+        if (memcmp(lexeme, "new", 3) == 0)
+            return TOKEN_NEW;
+        break;
+    case 4:
+        if (memcmp(lexeme, "int8", 4) == 0 || memcmp(lexeme, "bool", 4) == 0)
+            return TOKEN_TYPE;
+        if (memcmp(lexeme, "true", 4) == 0)
+            return TOKEN_TRUE;
+        if (memcmp(lexeme, "else", 4) == 0)
+            return TOKEN_ELSE;
+        break;
+    case 5:
+        if (memcmp(lexeme, "uint8", 5) == 0 || memcmp(lexeme, "int16", 5) == 0 || memcmp(lexeme, "int32", 5) == 0 ||
+            memcmp(lexeme, "int64", 5) == 0)
+            return TOKEN_TYPE;
+        if (memcmp(lexeme, "false", 5) == 0)
+            return TOKEN_FALSE;
+        if (memcmp(lexeme, "while", 5) == 0)
+            return TOKEN_WHILE;
+        if (memcmp(lexeme, "break", 5) == 0)
+            return TOKEN_BREAK;
+        break;
+    case 6:
+        if (memcmp(lexeme, "return", 6) == 0)
+            return TOKEN_RETURN;
+        if (memcmp(lexeme, "delete", 6) == 0)
+            return TOKEN_DELETE;
+        if (memcmp(lexeme, "inline", 6) == 0)
+            return TOKEN_INLINE;
+        if (memcmp(lexeme, "export", 6) == 0)
+            return TOKEN_EXPORT;
+        if (memcmp(lexeme, "extern", 6) == 0)
+            return TOKEN_EXTERN;
+        if (memcmp(lexeme, "import", 6) == 0)
+            return TOKEN_IMPORT;
+        if (memcmp(lexeme, "uint16", 6) == 0 || memcmp(lexeme, "uint32", 6) == 0 || memcmp(lexeme, "uint64", 6) == 0)
+            return TOKEN_TYPE;
+        break;
+    case 8:
+        if (memcmp(lexeme, "continue", 8) == 0)
+            return TOKEN_CONTINUE;
+        if (memcmp(lexeme, "noinline", 8) == 0)
+            return TOKEN_NOINLINE;
+        break;
+    default:
+        break;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+static char peek_next(const Lexer *lexer)
+{
+    return lexer->cursor + 1 < lexer->end ? lexer->cursor[1] : '\0';
+}
+
+// Consumes the current character, plus the next one if it equals `expected`.
+static int match_next(Lexer *lexer, char expected)
+{
+    if (peek_next(lexer) == expected)
+    {
+        lexer->cursor += 2;
+        return 1;
+    }
+    lexer->cursor++;
+    return 0;
+}
+
+void lexer_init(Lexer *lexer, const char *source, size_t size)
+{
+    lexer->start = source;
+    lexer->cursor = source;
+    lexer->end = source + size;
+    lexer->line = 1;
+    lexer->kernels = select_kernels();
+}
+
+TokenData get_next_token(Lexer *lexer)
+{
+    TokenData token;
+    token.type = TOKEN_UNKNOWN;
+
+    lexer->cursor = lexer->kernels->skip_whitespace(lexer->cursor, lexer->end, &lexer->line);
+
+    const char *begin = lexer->cursor;
+    token.offset = (uint32_t)(begin - lexer->start);
+    token.length = 0;
+    token.line = lexer->line;
+
+    if (lexer->cursor >= lexer->end || *lexer->cursor == '\0')
+    {
+        token.type = TOKEN_EOF;
+        return token;
+    }
+
+    uint8_t char_type = char_class[(unsigned char)*lexer->cursor];
+    if (char_type & CHAR_ALPHA)
+    {
+        lexer->cursor = lexer->kernels->scan_identifier(lexer->cursor + 1, lexer->end);
+        token.length = (uint32_t)(lexer->cursor - begin);
+        token.type = lookup_keyword(begin, token.length);
+        log_message(LOG_LEVEL_TRACE, "Recognized %s: %.*s", token.type == TOKEN_IDENTIFIER ? "identifier" : "keyword", (int)token.length, begin);
+        return token;
+    }
+    if (char_type & CHAR_DIGIT)
+    {
+        lexer->cursor = lexer->kernels->scan_digits(lexer->cursor + 1, lexer->end);
         token.type = TOKEN_NUMBER_LITERAL;
-        log_message(LOG_LEVEL_TRACE, "Recognized number literal: %s", token.lexeme);
+        // A fraction needs a digit after the '.', which keeps ranges like 0..n integral.
+        if (lexer->cursor + 1 < lexer->end && lexer->cursor[0] == '.' && CHAR_IS(lexer->cursor[1], CHAR_DIGIT))
+        {
+            lexer->cursor = lexer->kernels->scan_digits(lexer->cursor + 2, lexer->end);
+            token.type = TOKEN_FLOAT_LITERAL;
+        }
+        if (lexer->cursor < lexer->end && (*lexer->cursor == 'e' || *lexer->cursor == 'E'))
+        {
+            const char *exponent = lexer->cursor + 1;
+            if (exponent < lexer->end && (*exponent == '+' || *exponent == '-'))
+            {
+                exponent++;
+            }
+            if (exponent < lexer->end && CHAR_IS(*exponent, CHAR_DIGIT))
+            {
+                lexer->cursor = lexer->kernels->scan_digits(exponent + 1, lexer->end);
+                token.type = TOKEN_FLOAT_LITERAL;
+            }
+        }
+        token.length = (uint32_t)(lexer->cursor - begin);
+        log_message(LOG_LEVEL_TRACE, "Recognized number literal: %.*s", (int)token.length, begin);
         return token;
     }
-    switch (**input)
+    switch (*lexer->cursor)
     {
     case '(':
         token.type = TOKEN_LPAREN;
-        token.lexeme[0] = '(';
-        token.lexeme[1] = '\0';
-        (*input)++;
+        lexer->cursor++;
         break;
     case ')':
         token.type = TOKEN_RPAREN;
-        token.lexeme[0] = ')';
-        token.lexeme[1] = '\0';
-        (*input)++;
+        lexer->cursor++;
         break;
     case '{':
         token.type = TOKEN_LBRACE;
-        token.lexeme[0] = '{';
-        token.lexeme[1] = '\0';
-        (*input)++;
+        lexer->cursor++;
         break;
     case '}':
         token.type = TOKEN_RBRACE;
-        token.lexeme[0] = '}';
-        token.lexeme[1] = '\0';
-        (*input)++;
+        lexer->cursor++;
+        break;
+    case '[':
+        token.type = TOKEN_LBRACKET;
+        lexer->cursor++;
+        break;
+    case ']':
+        token.type = TOKEN_RBRACKET;
+        lexer->cursor++;
+        break;
+    case ',':
+        token.type = TOKEN_COMMA;
+        lexer->cursor++;
         break;
     case ';':
         token.type = TOKEN_SEMICOLON;
-        token.lexeme[0] = ';';
-        token.lexeme[1] = '\0';
-        (*input)++;
+        lexer->cursor++;
+        break;
+    case ':':
+        token.type = TOKEN_COLON;
+        lexer->cursor++;
+        break;
+    case '.':
+        token.type = match_next(lexer, '.') ? TOKEN_DOT_DOT : TOKEN_DOT;
         break;
     case '-':
-        if ((*input)[1] == '>')
+        token.type = match_next(lexer, '>') ? TOKEN_ARROW : TOKEN_MINUS;
+        break;
+    case '+':
+        token.type = TOKEN_PLUS;
+        lexer->cursor++;
+        break;
+    case '*':
+        token.type = TOKEN_STAR;
+        lexer->cursor++;
+        break;
+    case '/':
+        token.type = TOKEN_SLASH;
+        lexer->cursor++;
+        break;
+    case '%':
+        token.type = TOKEN_PERCENT;
+        lexer->cursor++;
+        break;
+    case '&':
+        token.type = TOKEN_AMPERSAND;
+        lexer->cursor++;
+        break;
+    case '|':
+        token.type = TOKEN_PIPE;
+        lexer->cursor++;
+        break;
+    case '^':
+        token.type = TOKEN_CARET;
+        lexer->cursor++;
+        break;
+    case '~':
+        token.type = TOKEN_TILDE;
+        lexer->cursor++;
+        break;
+    case '!':
+        token.type = match_next(lexer, '=') ? TOKEN_NOT_EQUAL : TOKEN_BANG;
+        break;
+    case '=':
+        token.type = match_next(lexer, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_ASSIGN;
+        break;
+    case '<':
+        if (peek_next(lexer) == '<')
         {
-            token.type = TOKEN_ARROW;
-            token.lexeme[0] = '-';
-            token.lexeme[1] = '>';
-            token.lexeme[2] = '\0';
-            (*input) += 2;
+            match_next(lexer, '<');
+            token.type = TOKEN_SHIFT_LEFT;
         }
+        else
+            token.type = match_next(lexer, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS;
+        break;
+    case '>':
+        if (peek_next(lexer) == '>')
+        {
+            match_next(lexer, '>');
+            token.type = TOKEN_SHIFT_RIGHT;
+        }
+        else
+            token.type = match_next(lexer, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER;
         break;
     default:
         token.type = TOKEN_UNKNOWN;
-        int i = 0;
-        token.lexeme[i++] = **input;
-        token.lexeme[i] = '\0';
-        (*input)++;
+        lexer->cursor++;
         break;
     }
+    token.length = (uint32_t)(lexer->cursor - begin);
 
-    log_message(LOG_LEVEL_TRACE, "Returning token: %s (type: %d)", token.lexeme, token.type);
+    log_message(LOG_LEVEL_TRACE, "Returning token: %.*s (type: %d)", (int)token.length, begin, token.type);
     return token;
 }
 
-void tokenize_line(char *line, uint64_t line_number)
+static int token_stream_push(TokenStream *stream, TokenData token)
 {
-    char *input = line;
-
-    while (*input != '\0')
+    if (stream->count == stream->capacity)
     {
-        TokenData token_data = get_next_token(&input, line_number);
-
-        if (token_data.type == TOKEN_UNKNOWN)
+        size_t capacity = stream->capacity * 2;
+        TokenData *tokens = (TokenData *)realloc(stream->tokens, capacity * sizeof(TokenData));
+        if (tokens == NULL)
         {
-            log_message(LOG_LEVEL_ERROR, "Unknown token on line %llu: %s", line_number, token_data.lexeme);
-        }
-        else if (token_data.type != TOKEN_EOF)
-        {
-            log_message(LOG_LEVEL_TRACE, "Token on line %llu: %s (type %d)", line_number, token_data.lexeme, token_data.type);
+            log_message(LOG_LEVEL_ERROR, "Out of memory while growing the token stream");
+            return EXIT_FAILURE;
         }
+        stream->tokens = tokens;
+        stream->capacity = capacity;
     }
+    stream->tokens[stream->count++] = token;
+    return EXIT_SUCCESS;
 }
 
-int Lexer_build_from_file(char *file)
+int Lexer_build_from_buffer(const SourceBuffer *buffer, TokenStream *stream)
 {
-    FILE *file_ptr;
-
-    char ch;
+    if (buffer->size > UINT32_MAX)
+    {
+        log_message(LOG_LEVEL_ERROR, "Source file is too large (%zu bytes)", buffer->size);
+        return EXIT_FAILURE;
+    }
 
-    file_ptr = fopen(file, "r");
-    char line_buffer[2048];
-    if (NULL == file_ptr)
+    stream->source = buffer->data;
+    stream->count = 0;
+    // Roughly one token per 4 bytes of source keeps regrowth rare without overcommitting.
+    stream->capacity = buffer->size / 4 + 16;
+    stream->tokens = (TokenData *)malloc(stream->capacity * sizeof(TokenData));
+    if (stream->tokens == NULL)
     {
-        log_message(LOG_LEVEL_ERROR, "Could not open file %s", file);
+        log_message(LOG_LEVEL_ERROR, "Out of memory while allocating the token stream");
         return EXIT_FAILURE;
     }
 
-    uint64_t line = 0;
+    Lexer lexer;
+    lexer_init(&lexer, buffer->data, buffer->size);
 
-    while (fgets(line_buffer, sizeof(line_buffer), file_ptr) != NULL)
+    while (1)
     {
-        line += 1;
-        log_message(LOG_LEVEL_TRACE, "Line %llu: %s", line, line_buffer);
+        TokenData token = get_next_token(&lexer);
 
-        tokenize_line(line_buffer, line);
+        if (token.type == TOKEN_UNKNOWN)
+        {
+            log_message(LOG_LEVEL_ERROR, "Unknown token on line %u: %.*s", token.line, (int)token.length, token_text(stream, &token));
+        }
+        if (token_stream_push(stream, token) != EXIT_SUCCESS)
+        {
+            token_stream_free(stream);
+            return EXIT_FAILURE;
+        }
+        if (token.type == TOKEN_EOF)
+        {
+            break;
+        }
     }
-    fclose(file_ptr);
+
+    log_message(LOG_LEVEL_TRACE, "Lexed %zu tokens from %zu bytes", stream->count, buffer->size);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+
+void token_stream_free(TokenStream *stream)
+{
+    free(stream->tokens);
+    stream->tokens = NULL;
+    stream->count = 0;
+    stream->capacity = 0;
+}
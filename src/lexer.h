@@ -1,31 +1,109 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
-#define LEXEME_MAX_SIZE 256
+#include "source.h"
 
 typedef enum Token
 {
     TOKEN_KEYWORD,
     TOKEN_IDENTIFIER,
     TOKEN_NUMBER_LITERAL,
+    TOKEN_FLOAT_LITERAL,
     TOKEN_ARROW,
     TOKEN_LPAREN,
     TOKEN_RPAREN,
     TOKEN_LBRACE,
     TOKEN_RBRACE,
+    TOKEN_LBRACKET,
+    TOKEN_RBRACKET,
     TOKEN_TYPE,
     TOKEN_RETURN,
+    TOKEN_TRUE,
+    TOKEN_FALSE,
+    TOKEN_AS,
+    TOKEN_LET,
+    TOKEN_IF,
+    TOKEN_ELSE,
+    TOKEN_WHILE,
+    TOKEN_FOR,
+    TOKEN_IN,
+    TOKEN_BREAK,
+    TOKEN_CONTINUE,
+    TOKEN_NEW,
+    TOKEN_DELETE,
+    TOKEN_INLINE,
+    TOKEN_NOINLINE,
+    TOKEN_EXPORT,
+    TOKEN_EXTERN,
+    TOKEN_IMPORT,
     TOKEN_COMMA,
     TOKEN_SEMICOLON,
+    TOKEN_COLON,
+    TOKEN_ASSIGN,
+    TOKEN_DOT,
+    TOKEN_DOT_DOT,
+    TOKEN_PLUS,
+    TOKEN_MINUS,
+    TOKEN_STAR,
+    TOKEN_SLASH,
+    TOKEN_PERCENT,
+    TOKEN_AMPERSAND,
+    TOKEN_PIPE,
+    TOKEN_CARET,
+    TOKEN_TILDE,
+    TOKEN_BANG,
+    TOKEN_SHIFT_LEFT,
+    TOKEN_SHIFT_RIGHT,
+    TOKEN_LESS,
+    TOKEN_LESS_EQUAL,
+    TOKEN_GREATER,
+    TOKEN_GREATER_EQUAL,
+    TOKEN_EQUAL_EQUAL,
+    TOKEN_NOT_EQUAL,
     TOKEN_EOF,
     TOKEN_UNKNOWN
 } Token;
 
+// A token refers back into the source buffer instead of owning a copy of its lexeme.
 typedef struct
 {
     Token type;
-    char lexeme[LEXEME_MAX_SIZE];
-    int line;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t line;
 } TokenData;
 
-int Lexer_build_from_file(char *file);
-TokenData get_next_token(char **input, uint64_t line_number);
\ No newline at end of file
+struct ScannerKernels;
+
+typedef struct
+{
+    const char *start;
+    const char *cursor;
+    const char *end;
+    uint32_t line;
+    const struct ScannerKernels *kernels;
+} Lexer;
+
+// All tokens of one source buffer, always terminated by a TOKEN_EOF token.
+typedef struct
+{
+    const char *source;
+    TokenData *tokens;
+    size_t count;
+    size_t capacity;
+} TokenStream;
+
+void lexer_init(Lexer *lexer, const char *source, size_t size);
+
+const char *lexer_kernel_name(void);
+
+TokenData get_next_token(Lexer *lexer);
+
+int Lexer_build_from_buffer(const SourceBuffer *buffer, TokenStream *stream);
+
+void token_stream_free(TokenStream *stream);
+
+static inline const char *token_text(const TokenStream *stream, const TokenData *token)
+{
+    return stream->source + token->offset;
+}
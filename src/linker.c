@@ -0,0 +1,231 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include "linker.h"
+#include "log.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char **environ;
+#endif
+
+#define LINKER_PATH_SIZE 64
+
+typedef struct
+{
+    char *path;
+    int fd;
+} LinkInput;
+
+static int write_all(FILE *file, const ObjectBuffer *object)
+{
+    return fwrite(object->data, 1, object->size, file) == object->size ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Object files are handed to the linker through anonymous memory files where the
+// platform has them, so nothing is written to disk; otherwise they land in build/.
+static int materialize_object(const ObjectBuffer *object, const char *output_name, size_t index, size_t object_count, LinkInput *input)
+{
+    input->fd = -1;
+    if (object->path != NULL)
+    {
+        input->path = strdup(object->path);
+        if (input->path == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while naming object files");
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+#ifdef __linux__
+    int fd = memfd_create("jpp-object", 0);
+    if (fd >= 0)
+    {
+        const char *cursor = object->data;
+        size_t remaining = object->size;
+        while (remaining > 0)
+        {
+            ssize_t written = write(fd, cursor, remaining);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                break;
+            cursor += written;
+            remaining -= (size_t)written;
+        }
+        if (remaining == 0)
+        {
+            input->path = (char *)malloc(LINKER_PATH_SIZE);
+            if (input->path != NULL)
+            {
+                // /proc/self would resolve to the linker process, so name our own pid.
+                snprintf(input->path, LINKER_PATH_SIZE, "/proc/%ld/fd/%d", (long)getpid(), fd);
+                input->fd = fd;
+                return EXIT_SUCCESS;
+            }
+        }
+        close(fd);
+    }
+    log_message(LOG_LEVEL_TRACE, "Could not pass object %zu through memory, writing it to disk", index);
+#endif
+
+    size_t size = strlen(output_name) + LINKER_PATH_SIZE;
+    input->path = (char *)malloc(size);
+    if (input->path == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while naming object files");
+        return EXIT_FAILURE;
+    }
+    if (object_count == 1)
+    {
+        snprintf(input->path, size, "build/%s.o", output_name);
+    }
+    else
+    {
+        snprintf(input->path, size, "build/%s.%zu.o", output_name, index);
+    }
+
+    FILE *file = fopen(input->path, "wb");
+    if (file == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not write object file %s", input->path);
+        return EXIT_FAILURE;
+    }
+    int result = write_all(file, object);
+    if (fclose(file) != 0 || result != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not write object file %s", input->path);
+        return EXIT_FAILURE;
+    }
+    log_message(LOG_LEVEL_TRACE, "Object file generated: %s", input->path);
+    return EXIT_SUCCESS;
+}
+
+static int spawn_and_wait(char *const argv[])
+{
+    flush_logger();
+#ifdef PLATFORM_WINDOWS
+    intptr_t status = _spawnvp(_P_WAIT, argv[0], (const char *const *)argv);
+    if (status == -1)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not start linker %s", argv[0]);
+        return -1;
+    }
+    return (int)status;
+#else
+    pid_t pid;
+    int error = posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ);
+    if (error != 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not start linker %s: %s", argv[0], strerror(error));
+        return -1;
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            log_message(LOG_LEVEL_ERROR, "Could not wait for linker %s: %s", argv[0], strerror(errno));
+            return -1;
+        }
+    }
+    if (WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    return -1;
+#endif
+}
+
+int link_executable(const ObjectBuffer *objects, size_t object_count, const char *output_name, const LinkerOptions *options)
+{
+    LinkInput *inputs = (LinkInput *)calloc(object_count, sizeof(LinkInput));
+    // driver, -fuse-ld, objects..., -o, output, NULL
+    char **argv = (char **)calloc(object_count + 5, sizeof(char *));
+    char *output_path = (char *)malloc(strlen(output_name) + sizeof("build/"));
+    char *fuse_ld = NULL;
+    int result = EXIT_SUCCESS;
+    if (inputs == NULL || argv == NULL || output_path == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while preparing the link");
+        result = EXIT_FAILURE;
+        object_count = 0;
+    }
+    for (size_t i = 0; i < object_count; i++)
+    {
+        inputs[i].fd = -1;
+    }
+    for (size_t i = 0; i < object_count && result == EXIT_SUCCESS; i++)
+    {
+        result = materialize_object(&objects[i], output_name, i, object_count, &inputs[i]);
+    }
+
+    if (result == EXIT_SUCCESS)
+    {
+        sprintf(output_path, "build/%s", output_name);
+        size_t argc = 0;
+        argv[argc++] = (char *)options->driver;
+        if (options->fuse_ld != NULL)
+        {
+            fuse_ld = (char *)malloc(strlen(options->fuse_ld) + sizeof("-fuse-ld="));
+            if (fuse_ld != NULL)
+            {
+                sprintf(fuse_ld, "-fuse-ld=%s", options->fuse_ld);
+                argv[argc++] = fuse_ld;
+            }
+        }
+        for (size_t i = 0; i < object_count; i++)
+        {
+            argv[argc++] = inputs[i].path;
+        }
+        argv[argc++] = "-o";
+        argv[argc++] = output_path;
+        argv[argc] = NULL;
+
+        if (log_enabled(LOG_LEVEL_TRACE))
+        {
+            for (size_t i = 0; i < argc; i++)
+            {
+                log_message(LOG_LEVEL_TRACE, "Linker argument %zu: %s", i, argv[i]);
+            }
+        }
+
+        int status = spawn_and_wait(argv);
+        if (status != 0)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error during linking. %s exited with code %d.", options->driver, status);
+            result = EXIT_FAILURE;
+        }
+        else
+        {
+            log_message(LOG_LEVEL_INFO, "Executable generated: %s", output_name);
+        }
+    }
+
+    for (size_t i = 0; i < object_count; i++)
+    {
+#ifndef PLATFORM_WINDOWS
+        if (inputs[i].fd >= 0)
+        {
+            close(inputs[i].fd);
+        }
+#endif
+        free(inputs[i].path);
+    }
+    free(fuse_ld);
+    free(output_path);
+    free(argv);
+    free(inputs);
+    return result;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <stddef.h>
+#include "llvm.h"
+
+typedef struct
+{
+    const char *driver;
+    const char *fuse_ld;
+} LinkerOptions;
+
+int link_executable(const ObjectBuffer *objects, size_t object_count, const char *output_name, const LinkerOptions *options);
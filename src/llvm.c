@@ -1,13 +1,21 @@
 #include "llvm.h"
 #include "log.h"
+#include "hash.h"
+#include "thread.h"
+#include "timing.h"
 #include <llvm-c/Core.h>
 #include <llvm-c/Analysis.h>
 #include <llvm-c/ExecutionEngine.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
 #include <llvm-c/Target.h>
 #include <llvm-c/TargetMachine.h>
 #include <llvm-c/Transforms/PassBuilder.h>
+#include <llvm-c/BitReader.h>
 #include <llvm-c/BitWriter.h>
+#include <llvm-c/Linker.h>
 #include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -64,16 +72,108 @@ int asprintf(char **strp, const char *fmt, ...)
 #define MKDIR(path) mkdir(path, 0755)
 #endif
 
-LLVMModuleRef module;
-LLVMBuilderRef builder;
-LLVMContextRef context;
+typedef struct
+{
+    char key[HASH_HEX_SIZE];
+    LLVMValueRef counters;
+    size_t count;
+} ProfileRecord;
+
+typedef struct
+{
+    LLVMContextRef context;
+    LLVMModuleRef module;
+    LLVMBuilderRef builder;
+    // Entry-block allocas of the function being generated, indexed by LocalSymbol.slot.
+    LLVMValueRef *locals;
+    size_t locals_capacity;
+    // Jump targets of the innermost enclosing loop, NULL outside loops.
+    LLVMBasicBlockRef break_block;
+    LLVMBasicBlockRef continue_block;
+    // The function's shared trap block for failed bounds and allocation checks,
+    // created on first use.
+    LLVMBasicBlockRef trap_block;
+    // Set when emitting one function of an incremental build. Functions internal to
+    // the unit then live in separate objects, so they become hidden symbols with this
+    // suffix to keep them apart from same-named functions of other files.
+    const char *symbol_suffix;
+    const char *module_name;
+    const CodegenOptions *options;
+    // Profiling state of the function being generated: its counters when
+    // instrumenting, its recorded counts when optimizing with a profile, and the
+    // number of conditional branches emitted so far.
+    LLVMValueRef counters;
+    const ProfileEntry *profile_entry;
+    size_t branch_index;
+    // The counters of every instrumented function, written out at exit.
+    ProfileRecord *profile_records;
+    size_t profile_record_count;
+    size_t profile_record_capacity;
+} CodegenContext;
+
+#define OPT_LEVEL_COUNT (OPT_LEVEL_OS + 1)
+#define IDLE_TARGET_MACHINES 16
+
+// Host queries and target machines are expensive to create, so both are made once
+// and reused by every compile of the process. A target machine is only ever used
+// by one thread at a time; finished ones wait here for the next compile.
+typedef struct
+{
+    uint8_t initialized;
+    char *triple;
+    char *cpu;
+    char *features;
+    Mutex lock;
+    LLVMTargetMachineRef idle[OPT_LEVEL_COUNT][IDLE_TARGET_MACHINES];
+    size_t idle_count[OPT_LEVEL_COUNT];
+} HostTarget;
+
+static HostTarget host_target = {0};
 
 void initialize_llvm_target()
 {
+    if (host_target.initialized)
+    {
+        return;
+    }
     LLVMInitializeNativeTarget();
     LLVMInitializeNativeAsmPrinter();
     LLVMInitializeNativeAsmParser();
     LLVMInitializeNativeDisassembler();
+    host_target.triple = LLVMGetDefaultTargetTriple();
+    host_target.cpu = LLVMGetHostCPUName();
+    host_target.features = LLVMGetHostCPUFeatures();
+    mutex_init(&host_target.lock);
+    host_target.initialized = 1;
+}
+
+void shutdown_llvm_target()
+{
+    if (!host_target.initialized)
+    {
+        return;
+    }
+    for (size_t level = 0; level < OPT_LEVEL_COUNT; level++)
+    {
+        for (size_t i = 0; i < host_target.idle_count[level]; i++)
+        {
+            LLVMDisposeTargetMachine(host_target.idle[level][i]);
+        }
+        host_target.idle_count[level] = 0;
+    }
+    LLVMDisposeMessage(host_target.features);
+    LLVMDisposeMessage(host_target.cpu);
+    LLVMDisposeMessage(host_target.triple);
+    mutex_destroy(&host_target.lock);
+    host_target.initialized = 0;
+}
+
+void hash_target_description(Hasher *hasher)
+{
+    hasher_update_string(hasher, host_target.triple);
+    hasher_update_string(hasher, host_target.cpu);
+    hasher_update_string(hasher, host_target.features);
+    hasher_update_string(hasher, "pic");
 }
 
 void ensure_build_directory_exists()
@@ -89,104 +189,2087 @@ void ensure_build_directory_exists()
     }
 }
 
-void emit_executable(const char *output_name)
+static const char *opt_level_name(OptLevel level)
+{
+    switch (level)
+    {
+    case OPT_LEVEL_O1:
+        return "O1";
+    case OPT_LEVEL_O2:
+        return "O2";
+    case OPT_LEVEL_O3:
+        return "O3";
+    case OPT_LEVEL_OS:
+        return "Os";
+    case OPT_LEVEL_O0:
+    default:
+        return "O0";
+    }
+}
+
+#define PIPELINE_SIZE 64
+
+// stage is one of LLVM's pipelines: default for ordinary compiles, lto-pre-link for
+// units of an LTO build and lto for the merged module.
+static void opt_level_pipeline(OptLevel level, const char *stage, char pipeline[PIPELINE_SIZE])
+{
+    // Locals are emitted as allocas, so promote them even in unoptimized builds;
+    // it costs little and keeps -O0 code out of memory.
+    const char *prefix = level == OPT_LEVEL_O0 ? "function(mem2reg)," : "";
+    snprintf(pipeline, PIPELINE_SIZE, "%s%s<%s>", prefix, stage, opt_level_name(level));
+}
+
+static LLVMCodeGenOptLevel opt_level_codegen_level(OptLevel level)
+{
+    switch (level)
+    {
+    case OPT_LEVEL_O0:
+        return LLVMCodeGenLevelNone;
+    case OPT_LEVEL_O1:
+        return LLVMCodeGenLevelLess;
+    case OPT_LEVEL_O3:
+        return LLVMCodeGenLevelAggressive;
+    case OPT_LEVEL_O2:
+    case OPT_LEVEL_OS:
+    default:
+        return LLVMCodeGenLevelDefault;
+    }
+}
+
+static LLVMTargetMachineRef create_target_machine(OptLevel level)
 {
-    ensure_build_directory_exists();
     LLVMTargetRef target;
     char *error = NULL;
-
-    if (LLVMGetTargetFromTriple(LLVMGetDefaultTargetTriple(), &target, &error))
+    if (LLVMGetTargetFromTriple(host_target.triple, &target, &error))
     {
         log_message(LOG_LEVEL_ERROR, "Failed to get target: %s", error);
         LLVMDisposeMessage(error);
-        return;
+        return NULL;
     }
-    LLVMTargetMachineRef target_machine = LLVMCreateTargetMachine(
+    return LLVMCreateTargetMachine(
         target,
-        LLVMGetDefaultTargetTriple(),
-        LLVMGetHostCPUName(),
-        LLVMGetHostCPUFeatures(),
-        LLVMCodeGenLevelDefault,
-        LLVMRelocDefault,
+        host_target.triple,
+        host_target.cpu,
+        host_target.features,
+        opt_level_codegen_level(level),
+        // Linkers default to position-independent executables.
+        LLVMRelocPIC,
         LLVMCodeModelDefault);
-    char *object_output;
-    asprintf(&object_output, "build/%s.o", output_name);
+}
+
+static LLVMTargetMachineRef acquire_target_machine(OptLevel level)
+{
+    LLVMTargetMachineRef target_machine = NULL;
+    mutex_lock(&host_target.lock);
+    if (host_target.idle_count[level] > 0)
+    {
+        target_machine = host_target.idle[level][--host_target.idle_count[level]];
+    }
+    mutex_unlock(&host_target.lock);
+    if (target_machine != NULL)
+    {
+        log_message(LOG_LEVEL_TRACE, "Reusing a target machine");
+        return target_machine;
+    }
+    TimingScope timer = timing_begin("create target machine", NULL);
+    target_machine = create_target_machine(level);
+    timing_end(&timer);
+    return target_machine;
+}
+
+static void release_target_machine(OptLevel level, LLVMTargetMachineRef target_machine)
+{
+    mutex_lock(&host_target.lock);
+    if (host_target.idle_count[level] < IDLE_TARGET_MACHINES)
+    {
+        host_target.idle[level][host_target.idle_count[level]++] = target_machine;
+        target_machine = NULL;
+    }
+    mutex_unlock(&host_target.lock);
+    if (target_machine != NULL)
+    {
+        LLVMDisposeTargetMachine(target_machine);
+    }
+}
+
+static void configure_module_for_target(LLVMModuleRef module, LLVMTargetMachineRef target_machine)
+{
+    char *triple = LLVMGetTargetMachineTriple(target_machine);
+    LLVMSetTarget(module, triple);
+    LLVMDisposeMessage(triple);
+
+    LLVMTargetDataRef data_layout = LLVMCreateTargetDataLayout(target_machine);
+    LLVMSetModuleDataLayout(module, data_layout);
+    LLVMDisposeTargetData(data_layout);
+}
 
-    if (LLVMTargetMachineEmitToFile(target_machine, module, object_output, LLVMObjectFile, &error))
+static int optimize_module(LLVMModuleRef module, LLVMTargetMachineRef target_machine, OptLevel level, const char *stage)
+{
+    char pipeline[PIPELINE_SIZE];
+    opt_level_pipeline(level, stage, pipeline);
+    log_message(LOG_LEVEL_TRACE, "Running pass pipeline %s", pipeline);
+
+    LLVMPassBuilderOptionsRef pass_options = LLVMCreatePassBuilderOptions();
+    // Mirror clang: vectorizers and the unroller only run from -O2 up (and at -Os).
+    LLVMBool vectorize = level == OPT_LEVEL_O2 || level == OPT_LEVEL_O3 || level == OPT_LEVEL_OS;
+    LLVMPassBuilderOptionsSetLoopVectorization(pass_options, vectorize);
+    LLVMPassBuilderOptionsSetSLPVectorization(pass_options, vectorize);
+    LLVMPassBuilderOptionsSetLoopUnrolling(pass_options, level != OPT_LEVEL_O0 && level != OPT_LEVEL_OS);
+    LLVMPassBuilderOptionsSetVerifyEach(pass_options, 0);
+
+    TimingScope timer = timing_begin("optimize", NULL);
+    LLVMErrorRef error = LLVMRunPasses(module, pipeline, target_machine, pass_options);
+    timing_end(&timer);
+    LLVMDisposePassBuilderOptions(pass_options);
+    if (error != NULL)
+    {
+        char *message = LLVMGetErrorMessage(error);
+        log_message(LOG_LEVEL_ERROR, "Failed to run pass pipeline %s: %s", pipeline, message);
+        LLVMDisposeErrorMessage(message);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static int emit_object(LLVMModuleRef module, LLVMTargetMachineRef target_machine, ObjectBuffer *object)
+{
+    char *error = NULL;
+    LLVMMemoryBufferRef buffer = NULL;
+    TimingScope timer = timing_begin("emit object", NULL);
+    LLVMBool failed = LLVMTargetMachineEmitToMemoryBuffer(target_machine, module, LLVMObjectFile, &error, &buffer);
+    timing_end(&timer);
+    if (failed)
     {
         log_message(LOG_LEVEL_ERROR, "Failed to emit object file: %s", error);
         LLVMDisposeMessage(error);
-        free(object_output);
+        return EXIT_FAILURE;
+    }
+
+    object->data = LLVMGetBufferStart(buffer);
+    object->size = LLVMGetBufferSize(buffer);
+    object->handle = buffer;
+    object->path = NULL;
+    log_message(LOG_LEVEL_TRACE, "Object generated in memory: %zu bytes", object->size);
+    return EXIT_SUCCESS;
+}
+
+static int emit_bitcode(LLVMModuleRef module, ObjectBuffer *object)
+{
+    TimingScope timer = timing_begin("emit bitcode", NULL);
+    LLVMMemoryBufferRef buffer = LLVMWriteBitcodeToMemoryBuffer(module);
+    timing_end(&timer);
+    if (buffer == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Failed to emit bitcode");
+        return EXIT_FAILURE;
+    }
+    object->data = LLVMGetBufferStart(buffer);
+    object->size = LLVMGetBufferSize(buffer);
+    object->handle = buffer;
+    object->path = NULL;
+    log_message(LOG_LEVEL_TRACE, "Bitcode generated in memory: %zu bytes", object->size);
+    return EXIT_SUCCESS;
+}
+
+int object_buffer_load(const char *path, ObjectBuffer *object)
+{
+    LLVMMemoryBufferRef buffer = NULL;
+    char *error = NULL;
+    if (LLVMCreateMemoryBufferWithContentsOfFile(path, &buffer, &error))
+    {
+        log_message(LOG_LEVEL_TRACE, "Could not load object %s: %s", path, error);
+        LLVMDisposeMessage(error);
+        return EXIT_FAILURE;
+    }
+    object->data = LLVMGetBufferStart(buffer);
+    object->size = LLVMGetBufferSize(buffer);
+    object->handle = buffer;
+    object->path = NULL;
+    return EXIT_SUCCESS;
+}
+
+void object_buffer_dispose(ObjectBuffer *object)
+{
+    if (object->handle != NULL)
+    {
+        LLVMDisposeMemoryBuffer((LLVMMemoryBufferRef)object->handle);
+    }
+    free(object->path);
+    object->data = NULL;
+    object->size = 0;
+    object->handle = NULL;
+    object->path = NULL;
+}
+
+static LLVMTypeRef codegen_type(CodegenContext *codegen, const Type *type)
+{
+    switch (type->kind)
+    {
+    case TYPE_F32:
+        return LLVMFloatTypeInContext(codegen->context);
+    case TYPE_F64:
+        return LLVMDoubleTypeInContext(codegen->context);
+    case TYPE_ARRAY:
+        return LLVMArrayType(codegen_type(codegen, type->element), (unsigned)type->length);
+    case TYPE_SLICE:
+    {
+        // { element *data, i64 length }
+        LLVMTypeRef fields[2] = {LLVMPointerType(codegen_type(codegen, type->element), 0), LLVMInt64TypeInContext(codegen->context)};
+        return LLVMStructTypeInContext(codegen->context, fields, 2, 0);
+    }
+    case TYPE_VECTOR:
+        return LLVMVectorType(codegen_type(codegen, type->element), (unsigned)type->length);
+    default:
+        return LLVMIntTypeInContext(codegen->context, type->bits);
+    }
+}
+
+static LLVMValueRef codegen_runtime_function(CodegenContext *codegen, const char *name, LLVMTypeRef return_type, LLVMTypeRef *parameters, unsigned parameter_count)
+{
+    LLVMValueRef function = LLVMGetNamedFunction(codegen->module, name);
+    if (function == NULL)
+    {
+        function = LLVMAddFunction(codegen->module, name, LLVMFunctionType(return_type, parameters, parameter_count, 0));
+    }
+    return function;
+}
+
+static LLVMBasicBlockRef append_block(CodegenContext *codegen, const char *name);
+
+static LLVMValueRef codegen_expression(CodegenContext *codegen, ASTNode *node);
+
+static LLVMValueRef codegen_lookup_function(CodegenContext *codegen, const FunctionASTNode *func);
+static void codegen_trap_unless(CodegenContext *codegen, LLVMValueRef condition, const char *name);
+
+static LLVMValueRef codegen_float_binary(CodegenContext *codegen, BinaryOperator op, LLVMValueRef left, LLVMValueRef right)
+{
+    LLVMBuilderRef builder = codegen->builder;
+    LLVMRealPredicate predicate;
+    switch (op)
+    {
+    case BINARY_ADD:
+        return LLVMBuildFAdd(builder, left, right, "fadd");
+    case BINARY_SUB:
+        return LLVMBuildFSub(builder, left, right, "fsub");
+    case BINARY_MUL:
+        return LLVMBuildFMul(builder, left, right, "fmul");
+    case BINARY_DIV:
+        return LLVMBuildFDiv(builder, left, right, "fdiv");
+    case BINARY_REM:
+        return LLVMBuildFRem(builder, left, right, "frem");
+    case BINARY_EQ:
+        predicate = LLVMRealOEQ;
+        break;
+    case BINARY_NE:
+        predicate = LLVMRealUNE;
+        break;
+    case BINARY_LT:
+        predicate = LLVMRealOLT;
+        break;
+    case BINARY_LE:
+        predicate = LLVMRealOLE;
+        break;
+    case BINARY_GT:
+        predicate = LLVMRealOGT;
+        break;
+    default:
+        predicate = LLVMRealOGE;
+        break;
+    }
+    return LLVMBuildFCmp(builder, predicate, left, right, "fcmp");
+}
+
+// An integer constant of `type`, repeated in every lane when it is a vector.
+static LLVMValueRef codegen_integer_constant(LLVMTypeRef type, unsigned long long value)
+{
+    if (LLVMGetTypeKind(type) != LLVMVectorTypeKind)
+    {
+        return LLVMConstInt(type, value, 0);
+    }
+    LLVMValueRef lanes[64];
+    unsigned lane_count = LLVMGetVectorSize(type);
+    for (unsigned i = 0; i < lane_count; i++)
+    {
+        lanes[i] = LLVMConstInt(LLVMGetElementType(type), value, 0);
+    }
+    return LLVMConstVector(lanes, lane_count);
+}
+
+// Traps if `invalid` is set in any lane.
+static void codegen_trap_if_any(CodegenContext *codegen, LLVMValueRef invalid, const char *name)
+{
+    LLVMTypeRef type = LLVMTypeOf(invalid);
+    if (LLVMGetTypeKind(type) == LLVMVectorTypeKind)
+    {
+        invalid = LLVMBuildBitCast(codegen->builder, invalid, LLVMIntTypeInContext(codegen->context, LLVMGetVectorSize(type)), "lanes");
+    }
+    codegen_trap_unless(codegen, LLVMBuildICmp(codegen->builder, LLVMIntEQ, invalid, LLVMConstNull(LLVMTypeOf(invalid)), "valid"), name);
+}
+
+// Division by zero, signed division overflow and shifts by the operand width or
+// more are rejected by fold_constants when constant, and trap here otherwise.
+static void codegen_check_integer_operands(CodegenContext *codegen, BinaryOperator op, int is_signed, LLVMValueRef left, LLVMValueRef right)
+{
+    LLVMBuilderRef builder = codegen->builder;
+    LLVMTypeRef type = LLVMTypeOf(right);
+    LLVMTypeRef lane = LLVMGetTypeKind(type) == LLVMVectorTypeKind ? LLVMGetElementType(type) : type;
+    unsigned bits = LLVMGetIntTypeWidth(lane);
+    if (op == BINARY_SHL || op == BINARY_SHR)
+    {
+        codegen_trap_if_any(codegen, LLVMBuildICmp(builder, LLVMIntUGE, right, codegen_integer_constant(type, bits), "shift.wide"), "shift.ok");
+        return;
+    }
+    LLVMValueRef invalid = LLVMBuildICmp(builder, LLVMIntEQ, right, LLVMConstNull(type), "div.zero");
+    if (is_signed)
+    {
+        LLVMValueRef minimum = LLVMBuildICmp(builder, LLVMIntEQ, left, codegen_integer_constant(type, 1ULL << (bits - 1)), "div.min");
+        LLVMValueRef minus_one = LLVMBuildICmp(builder, LLVMIntEQ, right, LLVMConstAllOnes(type), "div.minus.one");
+        invalid = LLVMBuildOr(builder, invalid, LLVMBuildAnd(builder, minimum, minus_one, "div.overflow"), "div.invalid");
+    }
+    codegen_trap_if_any(codegen, invalid, "div.ok");
+}
+
+static LLVMValueRef codegen_integer_binary(CodegenContext *codegen, BinaryOperator op, int is_signed, LLVMValueRef left, LLVMValueRef right)
+{
+    LLVMBuilderRef builder = codegen->builder;
+    LLVMIntPredicate predicate;
+    if (op == BINARY_DIV || op == BINARY_REM || op == BINARY_SHL || op == BINARY_SHR)
+    {
+        codegen_check_integer_operands(codegen, op, is_signed, left, right);
+    }
+    switch (op)
+    {
+    case BINARY_ADD:
+        return LLVMBuildAdd(builder, left, right, "add");
+    case BINARY_SUB:
+        return LLVMBuildSub(builder, left, right, "sub");
+    case BINARY_MUL:
+        return LLVMBuildMul(builder, left, right, "mul");
+    case BINARY_DIV:
+        return is_signed ? LLVMBuildSDiv(builder, left, right, "div") : LLVMBuildUDiv(builder, left, right, "div");
+    case BINARY_REM:
+        return is_signed ? LLVMBuildSRem(builder, left, right, "rem") : LLVMBuildURem(builder, left, right, "rem");
+    case BINARY_AND:
+        return LLVMBuildAnd(builder, left, right, "and");
+    case BINARY_OR:
+        return LLVMBuildOr(builder, left, right, "or");
+    case BINARY_XOR:
+        return LLVMBuildXor(builder, left, right, "xor");
+    case BINARY_SHL:
+        return LLVMBuildShl(builder, left, right, "shl");
+    case BINARY_SHR:
+        return is_signed ? LLVMBuildAShr(builder, left, right, "shr") : LLVMBuildLShr(builder, left, right, "shr");
+    case BINARY_EQ:
+        predicate = LLVMIntEQ;
+        break;
+    case BINARY_NE:
+        predicate = LLVMIntNE;
+        break;
+    case BINARY_LT:
+        predicate = is_signed ? LLVMIntSLT : LLVMIntULT;
+        break;
+    case BINARY_LE:
+        predicate = is_signed ? LLVMIntSLE : LLVMIntULE;
+        break;
+    case BINARY_GT:
+        predicate = is_signed ? LLVMIntSGT : LLVMIntUGT;
+        break;
+    default:
+        predicate = is_signed ? LLVMIntSGE : LLVMIntUGE;
+        break;
+    }
+    return LLVMBuildICmp(builder, predicate, left, right, "cmp");
+}
+
+// Broadcasts a scalar to every lane of `vector_type`.
+static LLVMValueRef codegen_splat(CodegenContext *codegen, LLVMValueRef value, const Type *vector_type)
+{
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(codegen->context);
+    LLVMValueRef undef = LLVMGetUndef(codegen_type(codegen, vector_type));
+    LLVMValueRef vector = LLVMBuildInsertElement(codegen->builder, undef, value, LLVMConstInt(i32, 0, 0), "splat");
+    return LLVMBuildShuffleVector(codegen->builder, vector, undef, LLVMConstNull(LLVMVectorType(i32, (unsigned)vector_type->length)), "splat");
+}
+
+static LLVMValueRef codegen_binary(CodegenContext *codegen, BinaryASTNode *binary)
+{
+    LLVMValueRef left = codegen_expression(codegen, binary->left);
+    LLVMValueRef right = codegen_expression(codegen, binary->right);
+    const Type *operand_type = binary->left->value_type;
+    // A scalar paired with a vector applies to every lane.
+    if (binary->right->value_type->kind == TYPE_VECTOR && operand_type->kind != TYPE_VECTOR)
+    {
+        operand_type = binary->right->value_type;
+        left = codegen_splat(codegen, left, operand_type);
+    }
+    else if (operand_type->kind == TYPE_VECTOR && binary->right->value_type->kind != TYPE_VECTOR)
+    {
+        right = codegen_splat(codegen, right, operand_type);
+    }
+    const Type *lane = type_lane(operand_type);
+    if (type_is_float(lane))
+    {
+        return codegen_float_binary(codegen, binary->op, left, right);
+    }
+    return codegen_integer_binary(codegen, binary->op, lane->is_signed, left, right);
+}
+
+static LLVMValueRef codegen_unary(CodegenContext *codegen, UnaryASTNode *unary)
+{
+    LLVMValueRef operand = codegen_expression(codegen, unary->operand);
+    switch (unary->op)
+    {
+    case UNARY_NEGATE:
+        if (type_is_float(type_lane(unary->base.value_type)))
+        {
+            return LLVMBuildFNeg(codegen->builder, operand, "fneg");
+        }
+        return LLVMBuildNeg(codegen->builder, operand, "neg");
+    default:
+        // On bool (i1) this is logical not.
+        return LLVMBuildNot(codegen->builder, operand, "not");
+    }
+}
+
+static LLVMValueRef codegen_cast(CodegenContext *codegen, CastASTNode *cast)
+{
+    LLVMValueRef value = codegen_expression(codegen, cast->operand);
+    LLVMTypeRef target_type = codegen_type(codegen, cast->target_type);
+    if (cast->operand->value_type == cast->target_type)
+    {
+        return value;
+    }
+    // Vector casts convert lane by lane with the same instructions.
+    const Type *source = type_lane(cast->operand->value_type);
+    const Type *target = type_lane(cast->target_type);
+    if (type_is_float(source) && type_is_float(target))
+    {
+        return LLVMBuildFPCast(codegen->builder, value, target_type, "fpcast");
+    }
+    if (type_is_float(source))
+    {
+        return target->is_signed ? LLVMBuildFPToSI(codegen->builder, value, target_type, "fptosi") : LLVMBuildFPToUI(codegen->builder, value, target_type, "fptoui");
+    }
+    if (type_is_float(target))
+    {
+        return source->is_signed ? LLVMBuildSIToFP(codegen->builder, value, target_type, "sitofp") : LLVMBuildUIToFP(codegen->builder, value, target_type, "uitofp");
+    }
+    return LLVMBuildIntCast2(codegen->builder, value, target_type, source->is_signed, "intcast");
+}
+
+// Branches to a shared llvm.trap block unless `condition` holds, and continues in
+// a fresh block where it does.
+static void codegen_trap_unless(CodegenContext *codegen, LLVMValueRef condition, const char *name)
+{
+    LLVMBasicBlockRef current = LLVMGetInsertBlock(codegen->builder);
+    if (codegen->trap_block == NULL)
+    {
+        unsigned trap_id = LLVMLookupIntrinsicID("llvm.trap", 9);
+        LLVMValueRef trap = LLVMGetIntrinsicDeclaration(codegen->module, trap_id, NULL, 0);
+        codegen->trap_block = append_block(codegen, "trap");
+        LLVMPositionBuilderAtEnd(codegen->builder, codegen->trap_block);
+        LLVMBuildCall2(codegen->builder, LLVMIntrinsicGetType(codegen->context, trap_id, NULL, 0), trap, NULL, 0, "");
+        LLVMBuildUnreachable(codegen->builder);
+        LLVMPositionBuilderAtEnd(codegen->builder, current);
+    }
+    LLVMBasicBlockRef ok = append_block(codegen, name);
+    LLVMBuildCondBr(codegen->builder, condition, ok, codegen->trap_block);
+    LLVMPositionBuilderAtEnd(codegen->builder, ok);
+}
+
+// Indices of any integer type are widened to i64, so negative signed indices
+// become huge and fail the unsigned bounds check.
+static LLVMValueRef codegen_index_operand(CodegenContext *codegen, ASTNode *node)
+{
+    LLVMValueRef value = codegen_expression(codegen, node);
+    return LLVMBuildIntCast2(codegen->builder, value, LLVMInt64TypeInContext(codegen->context), node->value_type->is_signed, "idx");
+}
+
+static LLVMValueRef codegen_address(CodegenContext *codegen, ASTNode *node);
+
+// Produces a pointer to the first element and the length of an array or slice.
+static void codegen_sequence(CodegenContext *codegen, ASTNode *node, LLVMValueRef *data, LLVMValueRef *length)
+{
+    const Type *type = node->value_type;
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+    if (type->kind == TYPE_ARRAY)
+    {
+        LLVMValueRef indices[2] = {LLVMConstInt(i64, 0, 0), LLVMConstInt(i64, 0, 0)};
+        *data = LLVMBuildInBoundsGEP2(codegen->builder, codegen_type(codegen, type), codegen_address(codegen, node), indices, 2, "data");
+        *length = LLVMConstInt(i64, type->length, 0);
         return;
     }
+    LLVMValueRef slice = codegen_expression(codegen, node);
+    *data = LLVMBuildExtractValue(codegen->builder, slice, 0, "data");
+    *length = LLVMBuildExtractValue(codegen->builder, slice, 1, "len");
+}
 
-    log_message(LOG_LEVEL_TRACE, "Object file generated: %s", object_output);
+static LLVMValueRef codegen_element_address(CodegenContext *codegen, IndexASTNode *index)
+{
+    LLVMValueRef data;
+    LLVMValueRef length;
+    codegen_sequence(codegen, index->sequence, &data, &length);
+    LLVMValueRef position = codegen_index_operand(codegen, index->index);
+    if (index->bounds_checked)
+    {
+        codegen_trap_unless(codegen, LLVMBuildICmp(codegen->builder, LLVMIntULT, position, length, "in.bounds"), "bounds.ok");
+    }
+    return LLVMBuildInBoundsGEP2(codegen->builder, codegen_type(codegen, index->base.value_type), data, &position, 1, "elem");
+}
 
-    char *link_command;
-    asprintf(&link_command, "gcc build/%s.o -o build/%s", output_name, output_name);
-    log_message(LOG_LEVEL_TRACE, "Linking with command: %s", link_command);
+// The lane a vector index selects, checked against the lane count.
+static LLVMValueRef codegen_lane_position(CodegenContext *codegen, IndexASTNode *index)
+{
+    LLVMValueRef position = codegen_index_operand(codegen, index->index);
+    if (index->bounds_checked)
+    {
+        LLVMValueRef lanes = LLVMConstInt(LLVMInt64TypeInContext(codegen->context), index->sequence->value_type->length, 0);
+        codegen_trap_unless(codegen, LLVMBuildICmp(codegen->builder, LLVMIntULT, position, lanes, "in.bounds"), "bounds.ok");
+    }
+    return position;
+}
 
-    int result = system(link_command);
-    if (result != 0)
+static LLVMValueRef codegen_address(CodegenContext *codegen, ASTNode *node)
+{
+    if (node->type == AST_INDEX)
     {
-        log_message(LOG_LEVEL_ERROR, "Error during linking. Command exited with code %d.", result);
+        return codegen_element_address(codegen, (IndexASTNode *)node);
     }
-    else
+    return codegen->locals[((VariableASTNode *)node)->symbol->slot];
+}
+
+static LLVMValueRef codegen_make_slice(CodegenContext *codegen, const Type *type, LLVMValueRef data, LLVMValueRef length)
+{
+    LLVMValueRef slice = LLVMGetUndef(codegen_type(codegen, type));
+    slice = LLVMBuildInsertValue(codegen->builder, slice, data, 0, "slice");
+    return LLVMBuildInsertValue(codegen->builder, slice, length, 1, "slice");
+}
+
+static LLVMValueRef codegen_slice(CodegenContext *codegen, SliceASTNode *slice)
+{
+    LLVMValueRef data;
+    LLVMValueRef length;
+    codegen_sequence(codegen, slice->sequence, &data, &length);
+    LLVMValueRef start = slice->start != NULL ? codegen_index_operand(codegen, slice->start) : LLVMConstInt(LLVMInt64TypeInContext(codegen->context), 0, 0);
+    LLVMValueRef end = slice->end != NULL ? codegen_index_operand(codegen, slice->end) : length;
+    if (slice->bounds_checked)
     {
-        log_message(LOG_LEVEL_INFO, "Executable generated: %s", output_name);
+        LLVMValueRef ordered = LLVMBuildICmp(codegen->builder, LLVMIntULE, start, end, "slice.ordered");
+        LLVMValueRef inside = LLVMBuildICmp(codegen->builder, LLVMIntULE, end, length, "slice.inside");
+        codegen_trap_unless(codegen, LLVMBuildAnd(codegen->builder, ordered, inside, "in.bounds"), "bounds.ok");
     }
+    LLVMValueRef first = LLVMBuildInBoundsGEP2(codegen->builder, codegen_type(codegen, slice->base.value_type->element), data, &start, 1, "slice.data");
+    return codegen_make_slice(codegen, slice->base.value_type, first, LLVMBuildNUWSub(codegen->builder, end, start, "slice.len"));
+}
+
+// Heap slices come from calloc, so they start zeroed like every other value.
+static LLVMValueRef codegen_new(CodegenContext *codegen, NewASTNode *node)
+{
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+    LLVMTypeRef bytes = LLVMPointerType(LLVMInt8TypeInContext(codegen->context), 0);
+    LLVMTypeRef parameters[2] = {i64, i64};
+    LLVMValueRef calloc_function = codegen_runtime_function(codegen, "calloc", bytes, parameters, 2);
 
-    free(link_command);
-    free(object_output);
-    LLVMDisposeTargetMachine(target_machine);
+    LLVMValueRef count = codegen_index_operand(codegen, node->count);
+    LLVMTypeRef element = codegen_type(codegen, node->element_type);
+    LLVMValueRef arguments[2] = {count, LLVMSizeOf(element)};
+    LLVMValueRef memory = LLVMBuildCall2(codegen->builder, LLVMGlobalGetValueType(calloc_function), calloc_function, arguments, 2, "new");
+    // An empty request may legitimately return NULL; any other NULL is out of memory.
+    LLVMValueRef allocated = LLVMBuildICmp(codegen->builder, LLVMIntNE, memory, LLVMConstNull(bytes), "allocated");
+    LLVMValueRef empty = LLVMBuildICmp(codegen->builder, LLVMIntEQ, count, LLVMConstInt(i64, 0, 0), "empty");
+    codegen_trap_unless(codegen, LLVMBuildOr(codegen->builder, allocated, empty, "new.valid"), "new.ok");
+    LLVMValueRef data = LLVMBuildBitCast(codegen->builder, memory, LLVMPointerType(element, 0), "new.data");
+    return codegen_make_slice(codegen, node->base.value_type, data, count);
 }
 
-LLVMValueRef codegen_return_statement(LLVMBuilderRef builder, ReturnASTNode *ret)
+static void codegen_delete(CodegenContext *codegen, DeleteASTNode *node)
 {
-    LiteralASTNode *literal = (LiteralASTNode *)ret->value;
-    log_message(LOG_LEVEL_TRACE, "Generating return statement with value: %d", literal->value);
+    LLVMTypeRef bytes = LLVMPointerType(LLVMInt8TypeInContext(codegen->context), 0);
+    LLVMValueRef free_function = codegen_runtime_function(codegen, "free", LLVMVoidTypeInContext(codegen->context), &bytes, 1);
+    LLVMValueRef data = LLVMBuildExtractValue(codegen->builder, codegen_expression(codegen, node->value), 0, "data");
+    LLVMValueRef memory = LLVMBuildBitCast(codegen->builder, data, bytes, "memory");
+    LLVMBuildCall2(codegen->builder, LLVMGlobalGetValueType(free_function), free_function, &memory, 1, "");
+}
 
-    return LLVMConstInt(LLVMInt8TypeInContext(context), literal->value, 0);
+static LLVMValueRef codegen_vector(CodegenContext *codegen, VectorASTNode *vector)
+{
+    const Type *type = vector->base.value_type;
+    if (vector->element_count == 1)
+    {
+        return codegen_splat(codegen, codegen_expression(codegen, vector->elements[0]), type);
+    }
+    LLVMValueRef lanes[64];
+    int is_constant = 1;
+    for (size_t i = 0; i < vector->element_count; i++)
+    {
+        lanes[i] = codegen_expression(codegen, vector->elements[i]);
+        is_constant = is_constant && LLVMIsConstant(lanes[i]);
+    }
+    if (is_constant)
+    {
+        return LLVMConstVector(lanes, (unsigned)vector->element_count);
+    }
+    LLVMValueRef result = LLVMGetUndef(codegen_type(codegen, type));
+    for (size_t i = 0; i < vector->element_count; i++)
+    {
+        result = LLVMBuildInsertElement(codegen->builder, result, lanes[i], LLVMConstInt(LLVMInt32TypeInContext(codegen->context), i, 0), "vec");
+    }
+    return result;
 }
 
-LLVMValueRef codegen_function(FunctionASTNode *func)
+static LLVMValueRef codegen_shuffle(CodegenContext *codegen, CallASTNode *call)
 {
-    log_message(LOG_LEVEL_TRACE, "Generating function: %s", func->name);
+    LLVMValueRef first = codegen_expression(codegen, call->arguments[0]);
+    LLVMValueRef second = LLVMGetUndef(LLVMTypeOf(first));
+    size_t first_index = 1;
+    if (call->arguments[1]->type != AST_LITERAL)
+    {
+        second = codegen_expression(codegen, call->arguments[1]);
+        first_index = 2;
+    }
+    LLVMValueRef mask[64];
+    for (size_t i = first_index; i < call->argument_count; i++)
+    {
+        mask[i - first_index] = LLVMConstInt(LLVMInt32TypeInContext(codegen->context), ((LiteralASTNode *)call->arguments[i])->value, 0);
+    }
+    return LLVMBuildShuffleVector(codegen->builder, first, second, LLVMConstVector(mask, (unsigned)(call->argument_count - first_index)), "shuffle");
+}
 
-    LLVMTypeRef return_type = LLVMInt8TypeInContext(context);
-    LLVMTypeRef func_type = LLVMFunctionType(return_type, NULL, 0, 0);
-    LLVMValueRef llvm_function = LLVMAddFunction(module, func->name, func_type);
-    LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(context, llvm_function, "entry");
-    LLVMPositionBuilderAtEnd(builder, block);
+static LLVMValueRef codegen_vector_intrinsic(CodegenContext *codegen, const char *name, LLVMValueRef vector)
+{
+    unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+    LLVMTypeRef type = LLVMTypeOf(vector);
+    LLVMValueRef function = LLVMGetIntrinsicDeclaration(codegen->module, id, &type, 1);
+    return LLVMBuildCall2(codegen->builder, LLVMIntrinsicGetType(codegen->context, id, &type, 1), function, &vector, 1, "reduce");
+}
 
-    LLVMValueRef return_value = codegen_return_statement(builder, (ReturnASTNode *)func->body);
-    LLVMBuildRet(builder, return_value);
-    LLVMVerifyFunction(llvm_function, LLVMAbortProcessAction);
+// Integer and min/max reductions use the llvm.vector.reduce intrinsics. The float
+// add and mul intrinsics are strictly ordered unless the call carries the reassoc
+// flag, which the C API cannot set, so those halve the vector until one lane is
+// left, adding or multiplying lanes pairwise.
+static LLVMValueRef codegen_reduce(CodegenContext *codegen, CallASTNode *call)
+{
+    LLVMValueRef vector = codegen_expression(codegen, call->arguments[0]);
+    const Type *lane = call->arguments[0]->value_type->element;
+    int is_float = type_is_float(lane);
+    switch (call->builtin)
+    {
+    case BUILTIN_REDUCE_ADD:
+        if (!is_float)
+            return codegen_vector_intrinsic(codegen, "llvm.vector.reduce.add", vector);
+        break;
+    case BUILTIN_REDUCE_MUL:
+        if (!is_float)
+            return codegen_vector_intrinsic(codegen, "llvm.vector.reduce.mul", vector);
+        break;
+    case BUILTIN_REDUCE_MIN:
+        return codegen_vector_intrinsic(codegen, is_float ? "llvm.vector.reduce.fmin" : lane->is_signed ? "llvm.vector.reduce.smin" : "llvm.vector.reduce.umin", vector);
+    case BUILTIN_REDUCE_MAX:
+        return codegen_vector_intrinsic(codegen, is_float ? "llvm.vector.reduce.fmax" : lane->is_signed ? "llvm.vector.reduce.smax" : "llvm.vector.reduce.umax", vector);
+    case BUILTIN_REDUCE_AND:
+        return codegen_vector_intrinsic(codegen, "llvm.vector.reduce.and", vector);
+    case BUILTIN_REDUCE_OR:
+        return codegen_vector_intrinsic(codegen, "llvm.vector.reduce.or", vector);
+    default:
+        return codegen_vector_intrinsic(codegen, "llvm.vector.reduce.xor", vector);
+    }
 
-    log_message(LOG_LEVEL_INFO, "Finished generating function: %s", func->name);
-    return llvm_function;
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(codegen->context);
+    LLVMValueRef undef = LLVMGetUndef(LLVMTypeOf(vector));
+    LLVMValueRef low_mask[32];
+    LLVMValueRef high_mask[32];
+    for (unsigned lanes = (unsigned)call->arguments[0]->value_type->length / 2; lanes > 0; lanes /= 2)
+    {
+        for (unsigned i = 0; i < lanes; i++)
+        {
+            low_mask[i] = LLVMConstInt(i32, i, 0);
+            high_mask[i] = LLVMConstInt(i32, lanes + i, 0);
+        }
+        LLVMValueRef low = LLVMBuildShuffleVector(codegen->builder, vector, undef, LLVMConstVector(low_mask, lanes), "reduce.low");
+        LLVMValueRef high = LLVMBuildShuffleVector(codegen->builder, vector, undef, LLVMConstVector(high_mask, lanes), "reduce.high");
+        vector = call->builtin == BUILTIN_REDUCE_ADD ? LLVMBuildFAdd(codegen->builder, low, high, "reduce") : LLVMBuildFMul(codegen->builder, low, high, "reduce");
+        undef = LLVMGetUndef(LLVMTypeOf(vector));
+    }
+    return LLVMBuildExtractElement(codegen->builder, vector, LLVMConstInt(i32, 0, 0), "reduce");
+}
+
+// vload and vstore access the elements [i, i + lanes) of an array or slice through
+// one vector pointer, aligned only as much as a single element.
+static LLVMValueRef codegen_vector_memory(CodegenContext *codegen, CallASTNode *call)
+{
+    const Type *vector_type = call->base.value_type;
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+    LLVMValueRef data;
+    LLVMValueRef length;
+    codegen_sequence(codegen, call->arguments[0], &data, &length);
+    LLVMValueRef position = codegen_index_operand(codegen, call->arguments[1]);
+    LLVMValueRef lanes = LLVMConstInt(i64, vector_type->length, 0);
+    // length - lanes cannot wrap once length >= lanes holds.
+    LLVMValueRef fits = LLVMBuildICmp(codegen->builder, LLVMIntUGE, length, lanes, "vec.fits");
+    LLVMValueRef last = LLVMBuildSub(codegen->builder, length, lanes, "vec.last");
+    LLVMValueRef inside = LLVMBuildICmp(codegen->builder, LLVMIntULE, position, last, "vec.inside");
+    codegen_trap_unless(codegen, LLVMBuildAnd(codegen->builder, fits, inside, "in.bounds"), "bounds.ok");
+
+    LLVMTypeRef type = codegen_type(codegen, vector_type);
+    LLVMValueRef element = LLVMBuildInBoundsGEP2(codegen->builder, codegen_type(codegen, vector_type->element), data, &position, 1, "vec.elem");
+    LLVMValueRef address = LLVMBuildBitCast(codegen->builder, element, LLVMPointerType(type, 0), "vec.addr");
+    LLVMValueRef access;
+    LLVMValueRef value;
+    if (call->builtin == BUILTIN_VLOAD)
+    {
+        value = access = LLVMBuildLoad2(codegen->builder, type, address, "vload");
+    }
+    else
+    {
+        value = codegen_expression(codegen, call->arguments[2]);
+        access = LLVMBuildStore(codegen->builder, value, address);
+    }
+    LLVMSetAlignment(access, vector_type->element->bits / 8);
+    return value;
 }
 
-void generate_code_from_ast(ASTNode *root_node, const char *output_name)
+static LLVMValueRef codegen_call(CodegenContext *codegen, CallASTNode *call)
 {
-    log_message(LOG_LEVEL_TRACE, "Starting LLVM code generation...");
+    if (call->function != NULL)
+    {
+        LLVMValueRef callee = codegen_lookup_function(codegen, call->function);
+        LLVMValueRef arguments[FUNCTION_MAX_PARAMETERS];
+        for (size_t i = 0; i < call->argument_count; i++)
+        {
+            arguments[i] = codegen_expression(codegen, call->arguments[i]);
+        }
+        return LLVMBuildCall2(codegen->builder, LLVMGlobalGetValueType(callee), callee, arguments, (unsigned)call->argument_count, "call");
+    }
+
+    switch (call->builtin)
+    {
+    case BUILTIN_LEN:
+        break;
+    case BUILTIN_SHUFFLE:
+        return codegen_shuffle(codegen, call);
+    case BUILTIN_SELECT:
+    {
+        LLVMValueRef mask = codegen_expression(codegen, call->arguments[0]);
+        LLVMValueRef then_value = codegen_expression(codegen, call->arguments[1]);
+        LLVMValueRef else_value = codegen_expression(codegen, call->arguments[2]);
+        return LLVMBuildSelect(codegen->builder, mask, then_value, else_value, "select");
+    }
+    case BUILTIN_VLOAD:
+    case BUILTIN_VSTORE:
+        return codegen_vector_memory(codegen, call);
+    default:
+        return codegen_reduce(codegen, call);
+    }
 
-    context = LLVMContextCreate();
-    module = LLVMModuleCreateWithNameInContext("jpp_module", context);
-    builder = LLVMCreateBuilderInContext(context);
+    // An array's or vector's length is part of its type.
+    ASTNode *sequence = call->arguments[0];
+    if (type_has_fixed_length(sequence->value_type))
+    {
+        return LLVMConstInt(LLVMInt64TypeInContext(codegen->context), sequence->value_type->length, 0);
+    }
+    return LLVMBuildExtractValue(codegen->builder, codegen_expression(codegen, sequence), 1, "len");
+}
 
-    initialize_llvm_target();
-    if (root_node->type == AST_FUNCTION)
+// Zero-filled array literals become a single memset.
+static int is_zero_value(const ASTNode *node)
+{
+    if (node->type == AST_ARRAY_LITERAL)
+    {
+        const ArrayLiteralASTNode *array = (const ArrayLiteralASTNode *)node;
+        return array->repeat_value != NULL && is_zero_value(array->repeat_value);
+    }
+    if (node->type != AST_LITERAL)
     {
-        codegen_function((FunctionASTNode *)root_node);
+        return 0;
     }
-    LLVMDumpModule(module);
+    const LiteralASTNode *literal = (const LiteralASTNode *)node;
+    // -0.0 is not all zero bits.
+    return literal->kind == LITERAL_FLOAT ? literal->float_value == 0.0 && !signbit(literal->float_value) : literal->value == 0;
+}
 
-    emit_executable(output_name);
+static void codegen_store(CodegenContext *codegen, LLVMValueRef address, ASTNode *value);
 
-    log_message(LOG_LEVEL_INFO, "Successfully wrote to file: %s\n", output_name);
+static LLVMValueRef codegen_array_element(CodegenContext *codegen, LLVMTypeRef array_type, LLVMValueRef address, LLVMValueRef position)
+{
+    LLVMValueRef indices[2] = {LLVMConstInt(LLVMInt64TypeInContext(codegen->context), 0, 0), position};
+    return LLVMBuildInBoundsGEP2(codegen->builder, array_type, address, indices, 2, "elem");
+}
 
-    LLVMDisposeBuilder(builder);
-    LLVMDisposeModule(module);
-    LLVMContextDispose(context);
+// [value; count]: the value is evaluated once into element 0 and then copied to
+// the rest by a loop, so long repeats do not unroll into straight-line stores.
+static void codegen_repeat_literal(CodegenContext *codegen, LLVMValueRef address, ArrayLiteralASTNode *array)
+{
+    const Type *type = array->base.value_type;
+    LLVMTypeRef array_type = codegen_type(codegen, type);
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+    if (is_zero_value(array->repeat_value))
+    {
+        LLVMBuildMemSet(codegen->builder, address, LLVMConstInt(LLVMInt8TypeInContext(codegen->context), 0, 0), LLVMSizeOf(array_type), 0);
+        return;
+    }
+    if (type->length == 0)
+    {
+        return;
+    }
+
+    LLVMValueRef first = codegen_array_element(codegen, array_type, address, LLVMConstInt(i64, 0, 0));
+    codegen_store(codegen, first, array->repeat_value);
+    if (type->length == 1)
+    {
+        return;
+    }
+    LLVMTypeRef element_type = codegen_type(codegen, type->element);
+    LLVMValueRef value = type->element->kind != TYPE_ARRAY ? LLVMBuildLoad2(codegen->builder, element_type, first, "repeat.value") : NULL;
+
+    LLVMBasicBlockRef entry = LLVMGetInsertBlock(codegen->builder);
+    LLVMBasicBlockRef body = append_block(codegen, "repeat.body");
+    LLVMBasicBlockRef end = append_block(codegen, "repeat.end");
+    LLVMBuildBr(codegen->builder, body);
+    LLVMPositionBuilderAtEnd(codegen->builder, body);
+    LLVMValueRef position = LLVMBuildPhi(codegen->builder, i64, "repeat.index");
+    LLVMValueRef element = codegen_array_element(codegen, array_type, address, position);
+    if (value != NULL)
+        LLVMBuildStore(codegen->builder, value, element);
+    else
+        LLVMBuildMemCpy(codegen->builder, element, 0, first, 0, LLVMSizeOf(element_type));
+    LLVMValueRef next = LLVMBuildNUWAdd(codegen->builder, position, LLVMConstInt(i64, 1, 0), "repeat.next");
+    LLVMValueRef more = LLVMBuildICmp(codegen->builder, LLVMIntULT, next, LLVMConstInt(i64, type->length, 0), "repeat.cond");
+    LLVMBuildCondBr(codegen->builder, more, body, end);
+
+    LLVMValueRef incoming_values[2] = {LLVMConstInt(i64, 1, 0), next};
+    LLVMBasicBlockRef incoming_blocks[2] = {entry, body};
+    LLVMAddIncoming(position, incoming_values, incoming_blocks, 2);
+    LLVMPositionBuilderAtEnd(codegen->builder, end);
+}
+
+// Arrays never live in registers: they are written straight into their
+// destination, element by element, or copied from another array's storage.
+static void codegen_store(CodegenContext *codegen, LLVMValueRef address, ASTNode *value)
+{
+    const Type *type = value->value_type;
+    if (type->kind != TYPE_ARRAY)
+    {
+        LLVMBuildStore(codegen->builder, codegen_expression(codegen, value), address);
+        return;
+    }
+    if (value->type != AST_ARRAY_LITERAL)
+    {
+        LLVMBuildMemCpy(codegen->builder, address, 0, codegen_address(codegen, value), 0, LLVMSizeOf(codegen_type(codegen, type)));
+        return;
+    }
+    ArrayLiteralASTNode *array = (ArrayLiteralASTNode *)value;
+    if (array->repeat_value != NULL)
+    {
+        codegen_repeat_literal(codegen, address, array);
+        return;
+    }
+    LLVMTypeRef array_type = codegen_type(codegen, type);
+    for (size_t i = 0; i < array->element_count; i++)
+    {
+        LLVMValueRef element = codegen_array_element(codegen, array_type, address, LLVMConstInt(LLVMInt64TypeInContext(codegen->context), i, 0));
+        codegen_store(codegen, element, array->elements[i]);
+    }
+}
+
+// A scratch slot at the top of the entry block, beside the locals.
+static LLVMValueRef codegen_entry_alloca(CodegenContext *codegen, LLVMTypeRef type, const char *name)
+{
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(LLVMGetBasicBlockParent(LLVMGetInsertBlock(codegen->builder)));
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(codegen->context);
+    LLVMValueRef first = LLVMGetFirstInstruction(entry);
+    if (first != NULL)
+        LLVMPositionBuilderBefore(builder, first);
+    else
+        LLVMPositionBuilderAtEnd(builder, entry);
+    LLVMValueRef slot = LLVMBuildAlloca(builder, type, name);
+    LLVMDisposeBuilder(builder);
+    return slot;
+}
+
+static void codegen_assign(CodegenContext *codegen, AssignASTNode *assign)
+{
+    // An array literal may read the array it overwrites, as in a = [a[1], a[0]], so
+    // it is built in a temporary first.
+    if (assign->value->type == AST_ARRAY_LITERAL)
+    {
+        LLVMTypeRef type = codegen_type(codegen, assign->value->value_type);
+        LLVMValueRef temporary = codegen_entry_alloca(codegen, type, "array.tmp");
+        codegen_store(codegen, temporary, assign->value);
+        LLVMBuildMemCpy(codegen->builder, codegen_address(codegen, assign->target), 0, temporary, 0, LLVMSizeOf(type));
+        return;
+    }
+    // A vector lane is replaced in a copy of the whole vector.
+    IndexASTNode *index = (IndexASTNode *)assign->target;
+    if (assign->target->type == AST_INDEX && index->sequence->value_type->kind == TYPE_VECTOR)
+    {
+        LLVMValueRef address = codegen_address(codegen, index->sequence);
+        LLVMValueRef position = codegen_lane_position(codegen, index);
+        LLVMValueRef value = codegen_expression(codegen, assign->value);
+        LLVMValueRef vector = LLVMBuildLoad2(codegen->builder, codegen_type(codegen, index->sequence->value_type), address, "vec");
+        LLVMBuildStore(codegen->builder, LLVMBuildInsertElement(codegen->builder, vector, value, position, "lane"), address);
+        return;
+    }
+    codegen_store(codegen, codegen_address(codegen, assign->target), assign->value);
+}
+
+static LLVMValueRef codegen_expression(CodegenContext *codegen, ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_VARIABLE:
+    {
+        const LocalSymbol *symbol = ((VariableASTNode *)node)->symbol;
+        return LLVMBuildLoad2(codegen->builder, codegen_type(codegen, symbol->type), codegen->locals[symbol->slot], symbol->name);
+    }
+    case AST_BINARY:
+        return codegen_binary(codegen, (BinaryASTNode *)node);
+    case AST_UNARY:
+        return codegen_unary(codegen, (UnaryASTNode *)node);
+    case AST_CAST:
+        return codegen_cast(codegen, (CastASTNode *)node);
+    case AST_INDEX:
+    {
+        IndexASTNode *index = (IndexASTNode *)node;
+        if (index->sequence->value_type->kind == TYPE_VECTOR)
+        {
+            LLVMValueRef vector = codegen_expression(codegen, index->sequence);
+            return LLVMBuildExtractElement(codegen->builder, vector, codegen_lane_position(codegen, index), "lane");
+        }
+        return LLVMBuildLoad2(codegen->builder, codegen_type(codegen, node->value_type), codegen_element_address(codegen, index), "load");
+    }
+    case AST_SLICE:
+        return codegen_slice(codegen, (SliceASTNode *)node);
+    case AST_NEW:
+        return codegen_new(codegen, (NewASTNode *)node);
+    case AST_CALL:
+        return codegen_call(codegen, (CallASTNode *)node);
+    case AST_VECTOR:
+        return codegen_vector(codegen, (VectorASTNode *)node);
+    default:
+    {
+        LiteralASTNode *literal = (LiteralASTNode *)node;
+        LLVMTypeRef type = codegen_type(codegen, node->value_type);
+        if (literal->kind == LITERAL_FLOAT)
+        {
+            return LLVMConstReal(type, literal->float_value);
+        }
+        return LLVMConstInt(type, literal->value, 0);
+    }
+    }
+}
+
+LLVMValueRef codegen_return_statement(CodegenContext *codegen, ReturnASTNode *ret)
+{
+    log_message(LOG_LEVEL_TRACE, "Generating return statement at line %u", ret->base.line);
+    return LLVMBuildRet(codegen->builder, codegen_expression(codegen, ret->value));
+}
+
+static int codegen_statement(CodegenContext *codegen, ASTNode *statement);
+
+// Returns 1 once the block has emitted a terminator; anything after it is unreachable
+// and skipped.
+static int codegen_block(CodegenContext *codegen, BlockASTNode *block)
+{
+    for (size_t i = 0; i < block->statement_count; i++)
+    {
+        if (codegen_statement(codegen, block->statements[i]))
+        {
+            if (i + 1 < block->statement_count)
+            {
+                log_message(LOG_LEVEL_TRACE, "Skipping %zu unreachable statements", block->statement_count - i - 1);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static LLVMBasicBlockRef append_block(CodegenContext *codegen, const char *name)
+{
+    LLVMValueRef function = LLVMGetBasicBlockParent(LLVMGetInsertBlock(codegen->builder));
+    return LLVMAppendBasicBlockInContext(codegen->context, function, name);
+}
+
+// Join blocks are created before the code that branches to them, so move them back
+// to the end to keep the block order close to source order for -O0 code layout.
+static void move_block_to_end(LLVMBasicBlockRef block)
+{
+    LLVMBasicBlockRef last = LLVMGetLastBasicBlock(LLVMGetBasicBlockParent(block));
+    if (last != block)
+    {
+        LLVMMoveBasicBlockAfter(block, last);
+    }
+}
+
+static void codegen_increment_counter(CodegenContext *codegen, LLVMValueRef index)
+{
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+    LLVMValueRef indices[2] = {LLVMConstInt(i64, 0, 0), index};
+    LLVMValueRef slot = LLVMBuildInBoundsGEP2(codegen->builder, LLVMGlobalGetValueType(codegen->counters), codegen->counters, indices, 2, "prof.slot");
+    LLVMValueRef count = LLVMBuildLoad2(codegen->builder, i64, slot, "prof.count");
+    LLVMBuildStore(codegen->builder, LLVMBuildAdd(codegen->builder, count, LLVMConstInt(i64, 1, 0), "prof.next"), slot);
+}
+
+static void set_branch_weights(CodegenContext *codegen, LLVMValueRef branch, uint64_t taken, uint64_t not_taken)
+{
+    if (taken == 0 && not_taken == 0)
+    {
+        return;
+    }
+    // Weights are 32-bit, so large counts are scaled down together; a weight of one
+    // rather than zero keeps a branch that was never taken merely unlikely.
+    uint64_t largest = taken > not_taken ? taken : not_taken;
+    unsigned shift = 0;
+    while ((largest >> shift) >= UINT32_MAX)
+    {
+        shift++;
+    }
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(codegen->context);
+    LLVMMetadataRef operands[3] = {
+        LLVMMDStringInContext2(codegen->context, "branch_weights", 14),
+        LLVMValueAsMetadata(LLVMConstInt(i32, (taken >> shift) + 1, 0)),
+        LLVMValueAsMetadata(LLVMConstInt(i32, (not_taken >> shift) + 1, 0))};
+    unsigned kind = LLVMGetMDKindIDInContext(codegen->context, "prof", 4);
+    LLVMSetMetadata(branch, kind, LLVMMetadataAsValue(codegen->context, LLVMMDNodeInContext2(codegen->context, operands, 3)));
+}
+
+// Every conditional branch of the source goes through here. It owns two counters,
+// for the times it went each way.
+static void codegen_branch(CodegenContext *codegen, LLVMValueRef condition, LLVMBasicBlockRef then_block, LLVMBasicBlockRef else_block)
+{
+    size_t counter = 1 + 2 * codegen->branch_index++;
+    if (codegen->counters != NULL)
+    {
+        LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+        LLVMValueRef index = LLVMBuildSelect(codegen->builder, condition, LLVMConstInt(i64, counter, 0), LLVMConstInt(i64, counter + 1, 0), "prof.index");
+        codegen_increment_counter(codegen, index);
+    }
+    LLVMValueRef branch = LLVMBuildCondBr(codegen->builder, condition, then_block, else_block);
+    if (codegen->profile_entry != NULL)
+    {
+        set_branch_weights(codegen, branch, codegen->profile_entry->counts[counter], codegen->profile_entry->counts[counter + 1]);
+    }
+}
+
+static int codegen_if(CodegenContext *codegen, IfASTNode *node)
+{
+    LLVMValueRef condition = codegen_expression(codegen, node->condition);
+    LLVMBasicBlockRef then_block = append_block(codegen, "if.then");
+    LLVMBasicBlockRef else_block = node->else_branch != NULL ? append_block(codegen, "if.else") : NULL;
+    LLVMBasicBlockRef end_block = append_block(codegen, "if.end");
+    codegen_branch(codegen, condition, then_block, else_block != NULL ? else_block : end_block);
+
+    LLVMPositionBuilderAtEnd(codegen->builder, then_block);
+    int then_terminated = codegen_block(codegen, (BlockASTNode *)node->then_block);
+    if (!then_terminated)
+    {
+        LLVMBuildBr(codegen->builder, end_block);
+    }
+
+    int else_terminated = 0;
+    if (else_block != NULL)
+    {
+        LLVMPositionBuilderAtEnd(codegen->builder, else_block);
+        else_terminated = codegen_statement(codegen, node->else_branch);
+        if (!else_terminated)
+        {
+            LLVMBuildBr(codegen->builder, end_block);
+        }
+    }
+
+    if (then_terminated && else_terminated)
+    {
+        // Both arms left the function or the loop, so nothing reaches the join.
+        LLVMDeleteBasicBlock(end_block);
+        return 1;
+    }
+    move_block_to_end(end_block);
+    LLVMPositionBuilderAtEnd(codegen->builder, end_block);
+    return 0;
+}
+
+// Loops are emitted already rotated, in the canonical form LoopVectorize and the
+// unroller expect: a guard, a dedicated preheader, the body, a single latch that
+// tests for the next iteration, and a dedicated exit. Breaks jump to the exit and
+// continues to the latch.
+typedef struct
+{
+    LLVMBasicBlockRef preheader;
+    LLVMBasicBlockRef body;
+    LLVMBasicBlockRef latch;
+    LLVMBasicBlockRef exit;
+    LLVMBasicBlockRef end;
+} LoopBlocks;
+
+static LoopBlocks begin_loop(CodegenContext *codegen, const char *kind, LLVMValueRef guard)
+{
+    char name[32];
+    LoopBlocks loop;
+    snprintf(name, sizeof(name), "%s.preheader", kind);
+    loop.preheader = append_block(codegen, name);
+    snprintf(name, sizeof(name), "%s.body", kind);
+    loop.body = append_block(codegen, name);
+    snprintf(name, sizeof(name), "%s.latch", kind);
+    loop.latch = append_block(codegen, name);
+    snprintf(name, sizeof(name), "%s.exit", kind);
+    loop.exit = append_block(codegen, name);
+    snprintf(name, sizeof(name), "%s.end", kind);
+    loop.end = append_block(codegen, name);
+
+    codegen_branch(codegen, guard, loop.preheader, loop.end);
+    LLVMPositionBuilderAtEnd(codegen->builder, loop.preheader);
+    LLVMBuildBr(codegen->builder, loop.body);
+    LLVMPositionBuilderAtEnd(codegen->builder, loop.body);
+    return loop;
+}
+
+static void codegen_loop_body(CodegenContext *codegen, const LoopBlocks *loop, BlockASTNode *body)
+{
+    LLVMBasicBlockRef outer_break = codegen->break_block;
+    LLVMBasicBlockRef outer_continue = codegen->continue_block;
+    codegen->break_block = loop->exit;
+    codegen->continue_block = loop->latch;
+    if (!codegen_block(codegen, body))
+    {
+        LLVMBuildBr(codegen->builder, loop->latch);
+    }
+    codegen->break_block = outer_break;
+    codegen->continue_block = outer_continue;
+    move_block_to_end(loop->latch);
+    LLVMPositionBuilderAtEnd(codegen->builder, loop->latch);
+}
+
+static void end_loop(CodegenContext *codegen, const LoopBlocks *loop, LLVMValueRef next)
+{
+    codegen_branch(codegen, next, loop->body, loop->exit);
+    move_block_to_end(loop->exit);
+    move_block_to_end(loop->end);
+    LLVMPositionBuilderAtEnd(codegen->builder, loop->exit);
+    LLVMBuildBr(codegen->builder, loop->end);
+    LLVMPositionBuilderAtEnd(codegen->builder, loop->end);
+}
+
+static void codegen_while(CodegenContext *codegen, WhileASTNode *node)
+{
+    // The condition is emitted twice, as the guard and in the latch, which
+    // evaluates it exactly as often as a test at the loop header would.
+    LoopBlocks loop = begin_loop(codegen, "while", codegen_expression(codegen, node->condition));
+    codegen_loop_body(codegen, &loop, (BlockASTNode *)node->body);
+    end_loop(codegen, &loop, codegen_expression(codegen, node->condition));
+}
+
+static void codegen_for(CodegenContext *codegen, ForASTNode *node)
+{
+    const Type *type = node->variable.type;
+    LLVMValueRef counter = codegen->locals[node->variable.slot];
+    LLVMValueRef start = codegen_expression(codegen, node->start);
+    LLVMValueRef end = codegen_expression(codegen, node->end);
+    LLVMBuildStore(codegen->builder, start, counter);
+    LLVMIntPredicate below = type->is_signed ? LLVMIntSLT : LLVMIntULT;
+
+    LoopBlocks loop = begin_loop(codegen, "for", LLVMBuildICmp(codegen->builder, below, start, end, "for.guard"));
+    codegen_loop_body(codegen, &loop, (BlockASTNode *)node->body);
+
+    // The counter is below end on entry to the latch, so the increment cannot wrap;
+    // saying so lets SCEV compute the trip count.
+    LLVMTypeRef llvm_type = codegen_type(codegen, type);
+    LLVMValueRef current = LLVMBuildLoad2(codegen->builder, llvm_type, counter, node->variable.name);
+    LLVMValueRef one = LLVMConstInt(llvm_type, 1, 0);
+    LLVMValueRef next = type->is_signed ? LLVMBuildNSWAdd(codegen->builder, current, one, "for.next") : LLVMBuildNUWAdd(codegen->builder, current, one, "for.next");
+    LLVMBuildStore(codegen->builder, next, counter);
+    end_loop(codegen, &loop, LLVMBuildICmp(codegen->builder, below, next, end, "for.cond"));
+}
+
+static int codegen_statement(CodegenContext *codegen, ASTNode *statement)
+{
+    switch (statement->type)
+    {
+    case AST_RETURN:
+        codegen_return_statement(codegen, (ReturnASTNode *)statement);
+        return 1;
+    case AST_LET:
+    {
+        LetASTNode *let = (LetASTNode *)statement;
+        codegen_store(codegen, codegen->locals[let->local.slot], let->value);
+        return 0;
+    }
+    case AST_ASSIGN:
+        codegen_assign(codegen, (AssignASTNode *)statement);
+        return 0;
+    case AST_DELETE:
+        codegen_delete(codegen, (DeleteASTNode *)statement);
+        return 0;
+    case AST_EXPRESSION:
+        codegen_expression(codegen, ((ExpressionASTNode *)statement)->expression);
+        return 0;
+    case AST_IF:
+        return codegen_if(codegen, (IfASTNode *)statement);
+    case AST_WHILE:
+        codegen_while(codegen, (WhileASTNode *)statement);
+        return 0;
+    case AST_FOR:
+        codegen_for(codegen, (ForASTNode *)statement);
+        return 0;
+    case AST_BREAK:
+        LLVMBuildBr(codegen->builder, codegen->break_block);
+        return 1;
+    case AST_CONTINUE:
+        LLVMBuildBr(codegen->builder, codegen->continue_block);
+        return 1;
+    case AST_BLOCK:
+        return codegen_block(codegen, (BlockASTNode *)statement);
+    default:
+        return 0;
+    }
+}
+
+// Every local gets one alloca at the top of the entry block, which is the shape
+// mem2reg and SROA promote to SSA registers.
+static int codegen_locals(CodegenContext *codegen, FunctionASTNode *func)
+{
+    if (func->local_count > codegen->locals_capacity)
+    {
+        LLVMValueRef *locals = (LLVMValueRef *)realloc(codegen->locals, func->local_count * sizeof(LLVMValueRef));
+        if (locals == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while generating %s", func->name);
+            return EXIT_FAILURE;
+        }
+        codegen->locals = locals;
+        codegen->locals_capacity = func->local_count;
+    }
+    for (size_t i = 0; i < func->local_count; i++)
+    {
+        const LocalSymbol *local = func->locals[i];
+        codegen->locals[i] = LLVMBuildAlloca(codegen->builder, codegen_type(codegen, local->type), local->name);
+    }
+    return EXIT_SUCCESS;
+}
+
+static void add_function_attribute(CodegenContext *codegen, LLVMValueRef function, LLVMAttributeIndex index, const char *name)
+{
+    unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    LLVMAddAttributeAtIndex(function, index, LLVMCreateEnumAttribute(codegen->context, kind, 0));
+}
+
+static int is_internal_function(const FunctionASTNode *func)
+{
+    return func->body != NULL && !(func->flags & FUNCTION_EXPORT) && strcmp(func->name, "main") != 0;
+}
+
+// Returns func->name, or a name to be freed by the caller for internal functions of
+// an incremental build.
+static char *codegen_symbol_name(CodegenContext *codegen, const FunctionASTNode *func)
+{
+    char *name = NULL;
+    if (codegen->symbol_suffix == NULL || !is_internal_function(func))
+    {
+        return (char *)func->name;
+    }
+    if (asprintf(&name, "%s.%s", func->name, codegen->symbol_suffix) < 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while naming function '%s'", func->name);
+        return NULL;
+    }
+    return name;
+}
+
+static LLVMValueRef codegen_lookup_function(CodegenContext *codegen, const FunctionASTNode *func)
+{
+    char *name = codegen_symbol_name(codegen, func);
+    if (name == NULL)
+    {
+        return NULL;
+    }
+    LLVMValueRef function = LLVMGetNamedFunction(codegen->module, name);
+    if (name != func->name)
+    {
+        free(name);
+    }
+    return function;
+}
+
+// Only exported functions and main are visible outside the module. Everything else
+// is internal, so the optimizer sees every call site and may inline the function
+// into all of them and then delete it.
+static LLVMValueRef codegen_declare_function(CodegenContext *codegen, const FunctionASTNode *func)
+{
+    char *name = codegen_symbol_name(codegen, func);
+    if (name == NULL)
+    {
+        return NULL;
+    }
+    LLVMValueRef existing = LLVMGetNamedFunction(codegen->module, name);
+    if (existing != NULL)
+    {
+        if (name != func->name)
+        {
+            free(name);
+        }
+        return existing;
+    }
+
+    LLVMTypeRef parameter_types[FUNCTION_MAX_PARAMETERS];
+    for (size_t i = 0; i < func->parameter_count; i++)
+    {
+        parameter_types[i] = codegen_type(codegen, ((const ParameterASTNode *)func->parameters[i])->local.type);
+    }
+    LLVMTypeRef func_type = LLVMFunctionType(codegen_type(codegen, func->return_type), parameter_types, (unsigned)func->parameter_count, 0);
+
+    LLVMValueRef llvm_function = LLVMAddFunction(codegen->module, name, func_type);
+    if (name != func->name)
+    {
+        free(name);
+        LLVMSetVisibility(llvm_function, LLVMHiddenVisibility);
+    }
+    else if (is_internal_function(func))
+    {
+        LLVMSetLinkage(llvm_function, LLVMInternalLinkage);
+    }
+    if (func->flags & FUNCTION_INLINE)
+    {
+        add_function_attribute(codegen, llvm_function, LLVMAttributeFunctionIndex, "alwaysinline");
+    }
+    if (func->flags & FUNCTION_NOINLINE)
+    {
+        add_function_attribute(codegen, llvm_function, LLVMAttributeFunctionIndex, "noinline");
+    }
+    if (func->return_type->kind == TYPE_BOOL)
+    {
+        add_function_attribute(codegen, llvm_function, LLVMAttributeReturnIndex, "zeroext");
+    }
+    for (size_t i = 0; i < func->parameter_count; i++)
+    {
+        const LocalSymbol *parameter = &((const ParameterASTNode *)func->parameters[i])->local;
+        LLVMSetValueName2(LLVMGetParam(llvm_function, (unsigned)i), parameter->name, strlen(parameter->name));
+        if (parameter->type->kind == TYPE_BOOL)
+        {
+            add_function_attribute(codegen, llvm_function, (LLVMAttributeIndex)(i + 1), "zeroext");
+        }
+    }
+    return llvm_function;
+}
+
+// An upper bound on the conditional branches codegen_branch emits for a statement:
+// one per if and two per loop, for its guard and its latch.
+static size_t count_branches(const ASTNode *statement)
+{
+    if (statement == NULL)
+    {
+        return 0;
+    }
+    switch (statement->type)
+    {
+    case AST_BLOCK:
+    {
+        const BlockASTNode *block = (const BlockASTNode *)statement;
+        size_t count = 0;
+        for (size_t i = 0; i < block->statement_count; i++)
+        {
+            count += count_branches(block->statements[i]);
+        }
+        return count;
+    }
+    case AST_IF:
+    {
+        const IfASTNode *node = (const IfASTNode *)statement;
+        return 1 + count_branches(node->then_block) + count_branches(node->else_branch);
+    }
+    case AST_WHILE:
+        return 2 + count_branches(((const WhileASTNode *)statement)->body);
+    case AST_FOR:
+        return 2 + count_branches(((const ForASTNode *)statement)->body);
+    default:
+        return 0;
+    }
+}
+
+static int add_profile_record(CodegenContext *codegen, const char *key, LLVMValueRef counters, size_t count)
+{
+    if (codegen->profile_record_count == codegen->profile_record_capacity)
+    {
+        size_t capacity = codegen->profile_record_capacity == 0 ? 64 : codegen->profile_record_capacity * 2;
+        ProfileRecord *records = (ProfileRecord *)realloc(codegen->profile_records, capacity * sizeof(ProfileRecord));
+        if (records == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while instrumenting %s", codegen->module_name);
+            return EXIT_FAILURE;
+        }
+        codegen->profile_records = records;
+        codegen->profile_record_capacity = capacity;
+    }
+    ProfileRecord *record = &codegen->profile_records[codegen->profile_record_count++];
+    memcpy(record->key, key, HASH_HEX_SIZE);
+    record->counters = counters;
+    record->count = count;
+    return EXIT_SUCCESS;
+}
+
+static void apply_function_profile(CodegenContext *codegen, const FunctionASTNode *func, LLVMValueRef llvm_function, const ProfileEntry *entry)
+{
+    codegen->profile_entry = entry;
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+    LLVMMetadataRef operands[2] = {
+        LLVMMDStringInContext2(codegen->context, "function_entry_count", 20),
+        LLVMValueAsMetadata(LLVMConstInt(i64, entry->counts[0], 0))};
+    unsigned kind = LLVMGetMDKindIDInContext(codegen->context, "prof", 4);
+    LLVMGlobalSetMetadata(llvm_function, kind, LLVMMDNodeInContext2(codegen->context, operands, 2));
+
+    // Functions that never ran are optimized for size and kept out of the way of
+    // hot code; those doing a good share of the most busy function's work are
+    // optimized harder.
+    uint64_t total = profile_entry_total(entry);
+    if (entry->counts[0] == 0)
+    {
+        add_function_attribute(codegen, llvm_function, LLVMAttributeFunctionIndex, "cold");
+        log_message(LOG_LEVEL_TRACE, "Function %s is cold", func->name);
+    }
+    else if (total >= codegen->options->profile->max_total / 10)
+    {
+        add_function_attribute(codegen, llvm_function, LLVMAttributeFunctionIndex, "hot");
+        log_message(LOG_LEVEL_TRACE, "Function %s is hot", func->name);
+    }
+}
+
+// Sets up the counters of an instrumented function, or looks up the counts that
+// steer its optimization, and counts the call.
+static int codegen_profile_function(CodegenContext *codegen, const FunctionASTNode *func, LLVMValueRef llvm_function)
+{
+    const CodegenOptions *options = codegen->options;
+    codegen->counters = NULL;
+    codegen->profile_entry = NULL;
+    codegen->branch_index = 0;
+    if (options->profile_generate == NULL && options->profile == NULL)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    char key[HASH_HEX_SIZE];
+    profile_function_key(func, key);
+    size_t counter_count = 1 + 2 * count_branches(func->body);
+    if (options->profile != NULL)
+    {
+        const ProfileEntry *entry = profile_lookup(options->profile, key);
+        if (entry != NULL && entry->count == counter_count)
+        {
+            apply_function_profile(codegen, func, llvm_function, entry);
+        }
+        else
+        {
+            log_message(LOG_LEVEL_TRACE, "No profile for function %s", func->name);
+        }
+    }
+    if (options->profile_generate == NULL)
+    {
+        return EXIT_SUCCESS;
+    }
+
+    char *name = NULL;
+    if (asprintf(&name, "jpp.counters.%s", func->name) < 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while instrumenting %s", func->name);
+        return EXIT_FAILURE;
+    }
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(codegen->context);
+    LLVMTypeRef counters_type = LLVMArrayType(i64, (unsigned)counter_count);
+    codegen->counters = LLVMAddGlobal(codegen->module, counters_type, name);
+    free(name);
+    LLVMSetLinkage(codegen->counters, LLVMInternalLinkage);
+    LLVMSetInitializer(codegen->counters, LLVMConstNull(counters_type));
+    codegen_increment_counter(codegen, LLVMConstInt(i64, 0, 0));
+    return add_profile_record(codegen, key, codegen->counters, counter_count);
+}
+
+LLVMValueRef codegen_function(CodegenContext *codegen, FunctionASTNode *func)
+{
+    log_message(LOG_LEVEL_TRACE, "Generating function: %s", func->name);
+    LLVMValueRef llvm_function = codegen_declare_function(codegen, func);
+    if (llvm_function == NULL)
+    {
+        return NULL;
+    }
+    if (LLVMCountBasicBlocks(llvm_function) > 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Function '%s' is defined more than once", func->name);
+        return NULL;
+    }
+    TimingScope timer = timing_begin("codegen function", func->name);
+
+    LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(codegen->context, llvm_function, "entry");
+    LLVMPositionBuilderAtEnd(codegen->builder, block);
+    codegen->trap_block = NULL;
+
+    if (codegen_locals(codegen, func) != EXIT_SUCCESS || codegen_profile_function(codegen, func, llvm_function) != EXIT_SUCCESS)
+    {
+        timing_end(&timer);
+        return NULL;
+    }
+    for (size_t i = 0; i < func->parameter_count; i++)
+    {
+        const LocalSymbol *parameter = &((const ParameterASTNode *)func->parameters[i])->local;
+        LLVMBuildStore(codegen->builder, LLVMGetParam(llvm_function, (unsigned)i), codegen->locals[parameter->slot]);
+    }
+    if (!codegen_block(codegen, (BlockASTNode *)func->body))
+    {
+        // Sema rejects bodies that can reach their end, so only the exit of a
+        // while true loop without a break gets here.
+        LLVMBuildUnreachable(codegen->builder);
+    }
+    TimingScope verify_timer = timing_begin("verify function", func->name);
+    LLVMVerifyFunction(llvm_function, LLVMAbortProcessAction);
+    timing_end(&verify_timer);
+    timing_end(&timer);
+
+    log_message(LOG_LEVEL_TRACE, "Finished generating function: %s", func->name);
+    return llvm_function;
+}
+
+// Definitions are declared before extern declarations so a definition's linkage
+// wins, and every prototype exists before any body refers to it.
+static int codegen_declare_unit(CodegenContext *codegen, const TranslationUnitASTNode *unit)
+{
+    for (int externs = 0; externs <= 1; externs++)
+    {
+        for (size_t i = 0; i < unit->function_count; i++)
+        {
+            const FunctionASTNode *function = (const FunctionASTNode *)unit->functions[i];
+            if ((function->body == NULL) == externs && codegen_declare_function(codegen, function) == NULL)
+            {
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Emits jpp.profile.record(file, key, counters, count), which appends one line of
+// the profile.
+static LLVMValueRef codegen_profile_record_function(CodegenContext *codegen, LLVMValueRef fprintf_function)
+{
+    LLVMContextRef context = codegen->context;
+    LLVMBuilderRef builder = codegen->builder;
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(context);
+    LLVMTypeRef i8_pointer = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+    LLVMTypeRef fprintf_type = LLVMGlobalGetValueType(fprintf_function);
+    LLVMTypeRef parameters[4] = {i8_pointer, i8_pointer, LLVMPointerType(i64, 0), i64};
+    LLVMValueRef function = LLVMAddFunction(codegen->module, "jpp.profile.record", LLVMFunctionType(LLVMVoidTypeInContext(context), parameters, 4, 0));
+    LLVMSetLinkage(function, LLVMInternalLinkage);
+    LLVMValueRef file = LLVMGetParam(function, 0);
+    LLVMValueRef counters = LLVMGetParam(function, 2);
+    LLVMValueRef count = LLVMGetParam(function, 3);
+
+    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(context, function, "entry");
+    LLVMBasicBlockRef loop = LLVMAppendBasicBlockInContext(context, function, "loop");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlockInContext(context, function, "done");
+    LLVMPositionBuilderAtEnd(builder, entry);
+    LLVMValueRef header[4] = {file, LLVMBuildGlobalStringPtr(builder, "%s %llu", "prof.header"), LLVMGetParam(function, 1), count};
+    LLVMBuildCall2(builder, fprintf_type, fprintf_function, header, 4, "");
+    LLVMBuildBr(builder, loop);
+
+    LLVMPositionBuilderAtEnd(builder, loop);
+    LLVMValueRef index = LLVMBuildPhi(builder, i64, "index");
+    LLVMValueRef slot = LLVMBuildInBoundsGEP2(builder, i64, counters, &index, 1, "slot");
+    LLVMValueRef value[3] = {file, LLVMBuildGlobalStringPtr(builder, " %llu", "prof.counter"), LLVMBuildLoad2(builder, i64, slot, "counter")};
+    LLVMBuildCall2(builder, fprintf_type, fprintf_function, value, 3, "");
+    LLVMValueRef next = LLVMBuildNUWAdd(builder, index, LLVMConstInt(i64, 1, 0), "next");
+    LLVMBuildCondBr(builder, LLVMBuildICmp(builder, LLVMIntULT, next, count, "more"), loop, done);
+    LLVMValueRef incoming_values[2] = {LLVMConstInt(i64, 0, 0), next};
+    LLVMBasicBlockRef incoming_blocks[2] = {entry, loop};
+    LLVMAddIncoming(index, incoming_values, incoming_blocks, 2);
+
+    LLVMPositionBuilderAtEnd(builder, done);
+    LLVMValueRef newline[2] = {file, LLVMBuildGlobalStringPtr(builder, "\n", "prof.newline")};
+    LLVMBuildCall2(builder, fprintf_type, fprintf_function, newline, 2, "");
+    LLVMBuildRetVoid(builder);
+    return function;
+}
+
+// Instrumented programs append the counters of every function of the module to the
+// profile when they exit, from a destructor, so separately compiled files each
+// write their own lines.
+static void codegen_profile_writer(CodegenContext *codegen)
+{
+    if (codegen->profile_record_count == 0)
+    {
+        return;
+    }
+    LLVMContextRef context = codegen->context;
+    LLVMBuilderRef builder = codegen->builder;
+    LLVMTypeRef i32 = LLVMInt32TypeInContext(context);
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(context);
+    LLVMTypeRef i8_pointer = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+    LLVMTypeRef file_parameters[2] = {i8_pointer, i8_pointer};
+    LLVMValueRef fopen_function = codegen_runtime_function(codegen, "fopen", i8_pointer, file_parameters, 2);
+    LLVMValueRef fclose_function = codegen_runtime_function(codegen, "fclose", i32, file_parameters, 1);
+    LLVMValueRef fprintf_function = LLVMGetNamedFunction(codegen->module, "fprintf");
+    if (fprintf_function == NULL)
+    {
+        fprintf_function = LLVMAddFunction(codegen->module, "fprintf", LLVMFunctionType(i32, file_parameters, 2, 1));
+    }
+    LLVMValueRef record_function = codegen_profile_record_function(codegen, fprintf_function);
+
+    LLVMTypeRef writer_type = LLVMFunctionType(LLVMVoidTypeInContext(context), NULL, 0, 0);
+    LLVMValueRef writer = LLVMAddFunction(codegen->module, "jpp.profile.write", writer_type);
+    LLVMSetLinkage(writer, LLVMInternalLinkage);
+    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(context, writer, "entry");
+    LLVMBasicBlockRef write = LLVMAppendBasicBlockInContext(context, writer, "write");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlockInContext(context, writer, "done");
+    LLVMPositionBuilderAtEnd(builder, entry);
+    LLVMValueRef open_arguments[2] = {
+        LLVMBuildGlobalStringPtr(builder, codegen->options->profile_generate, "prof.path"),
+        LLVMBuildGlobalStringPtr(builder, "a", "prof.mode")};
+    LLVMValueRef file = LLVMBuildCall2(builder, LLVMGlobalGetValueType(fopen_function), fopen_function, open_arguments, 2, "file");
+    LLVMBuildCondBr(builder, LLVMBuildIsNull(builder, file, "failed"), done, write);
+
+    LLVMPositionBuilderAtEnd(builder, write);
+    LLVMValueRef zero[2] = {LLVMConstInt(i64, 0, 0), LLVMConstInt(i64, 0, 0)};
+    for (size_t i = 0; i < codegen->profile_record_count; i++)
+    {
+        const ProfileRecord *record = &codegen->profile_records[i];
+        LLVMValueRef arguments[4] = {
+            file,
+            LLVMBuildGlobalStringPtr(builder, record->key, "prof.key"),
+            LLVMBuildInBoundsGEP2(builder, LLVMGlobalGetValueType(record->counters), record->counters, zero, 2, "counters"),
+            LLVMConstInt(i64, record->count, 0)};
+        LLVMBuildCall2(builder, LLVMGlobalGetValueType(record_function), record_function, arguments, 4, "");
+    }
+    LLVMBuildCall2(builder, LLVMGlobalGetValueType(fclose_function), fclose_function, &file, 1, "");
+    LLVMBuildBr(builder, done);
+    LLVMPositionBuilderAtEnd(builder, done);
+    LLVMBuildRetVoid(builder);
+
+    // llvm.global_dtors is an appending array of { priority, function, data }.
+    LLVMTypeRef fields[3] = {i32, LLVMPointerType(writer_type, 0), i8_pointer};
+    LLVMTypeRef dtor_type = LLVMStructTypeInContext(context, fields, 3, 0);
+    LLVMValueRef values[3] = {LLVMConstInt(i32, 65535, 0), writer, LLVMConstNull(i8_pointer)};
+    LLVMValueRef dtor = LLVMConstStructInContext(context, values, 3, 0);
+    LLVMValueRef dtors = LLVMAddGlobal(codegen->module, LLVMArrayType(dtor_type, 1), "llvm.global_dtors");
+    LLVMSetLinkage(dtors, LLVMAppendingLinkage);
+    LLVMSetInitializer(dtors, LLVMConstArray(dtor_type, &dtor, 1));
+}
+
+static int codegen_module(CodegenContext *codegen, ASTNode *root_node)
+{
+    TimingScope timer = timing_begin("codegen", NULL);
+    int result = EXIT_SUCCESS;
+    if (root_node->type == AST_TRANSLATION_UNIT)
+    {
+        TranslationUnitASTNode *unit = (TranslationUnitASTNode *)root_node;
+        result = codegen_declare_unit(codegen, unit);
+        for (size_t i = 0; i < unit->function_count && result == EXIT_SUCCESS; i++)
+        {
+            FunctionASTNode *function = (FunctionASTNode *)unit->functions[i];
+            if (function->body != NULL && codegen_function(codegen, function) == NULL)
+            {
+                result = EXIT_FAILURE;
+            }
+        }
+    }
+    else if (root_node->type == AST_FUNCTION)
+    {
+        if (codegen_function(codegen, (FunctionASTNode *)root_node) == NULL)
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        codegen_profile_writer(codegen);
+    }
+    timing_end(&timer);
+    return result;
+}
+
+// Emits a group of functions, plus private copies of the inline functions they pull
+// in from outside the group so those can still be inlined; every other function of
+// the unit is only declared.
+static int codegen_partition(CodegenContext *codegen, const TranslationUnitASTNode *unit, FunctionASTNode *const *functions, size_t function_count)
+{
+    TimingScope timer = timing_begin("codegen", function_count == 1 ? functions[0]->name : NULL);
+    int result = codegen_declare_unit(codegen, unit);
+    for (size_t i = 0; i < function_count && result == EXIT_SUCCESS; i++)
+    {
+        if (codegen_function(codegen, functions[i]) == NULL)
+        {
+            result = EXIT_FAILURE;
+        }
+    }
+    for (size_t i = 0; i < function_count && result == EXIT_SUCCESS; i++)
+    {
+        for (size_t c = 0; c < functions[i]->inline_callee_count && result == EXIT_SUCCESS; c++)
+        {
+            FunctionASTNode *callee = (FunctionASTNode *)functions[i]->inline_callees[c];
+            LLVMValueRef llvm_callee = codegen_lookup_function(codegen, callee);
+            if (LLVMCountBasicBlocks(llvm_callee) > 0)
+            {
+                continue;
+            }
+            LLVMSetLinkage(llvm_callee, LLVMInternalLinkage);
+            LLVMSetVisibility(llvm_callee, LLVMDefaultVisibility);
+            if (codegen_function(codegen, callee) == NULL)
+            {
+                result = EXIT_FAILURE;
+            }
+        }
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        codegen_profile_writer(codegen);
+    }
+    timing_end(&timer);
+    return result;
+}
+
+static void codegen_context_init(CodegenContext *codegen, LLVMContextRef context, const char *module_name, const CodegenOptions *options, LLVMTargetMachineRef target_machine)
+{
+    codegen->context = context;
+    codegen->module = LLVMModuleCreateWithNameInContext(module_name, context);
+    codegen->builder = LLVMCreateBuilderInContext(context);
+    codegen->locals = NULL;
+    codegen->locals_capacity = 0;
+    codegen->break_block = NULL;
+    codegen->continue_block = NULL;
+    codegen->trap_block = NULL;
+    codegen->symbol_suffix = NULL;
+    codegen->module_name = module_name;
+    codegen->options = options;
+    codegen->counters = NULL;
+    codegen->profile_entry = NULL;
+    codegen->branch_index = 0;
+    codegen->profile_records = NULL;
+    codegen->profile_record_count = 0;
+    codegen->profile_record_capacity = 0;
+    configure_module_for_target(codegen->module, target_machine);
+}
+
+// LTO units only get the pre-link pipeline and are kept as bitcode for
+// link_time_optimize.
+static int finish_object(CodegenContext *codegen, LLVMTargetMachineRef target_machine, const CodegenOptions *options, ObjectBuffer *object)
+{
+    int result = optimize_module(codegen->module, target_machine, options->opt_level, options->lto ? "lto-pre-link" : "default");
+    if (log_enabled(LOG_LEVEL_TRACE))
+    {
+        flush_logger();
+        LLVMDumpModule(codegen->module);
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        result = options->lto ? emit_bitcode(codegen->module, object) : emit_object(codegen->module, target_machine, object);
+    }
+    return result;
+}
+
+static void codegen_context_dispose(CodegenContext *codegen)
+{
+    LLVMDisposeBuilder(codegen->builder);
+    free(codegen->locals);
+    free(codegen->profile_records);
+    LLVMDisposeModule(codegen->module);
+    LLVMContextDispose(codegen->context);
+}
+
+int generate_code_from_ast(ASTNode *root_node, const char *module_name, ObjectBuffer *object, const CodegenOptions *options)
+{
+    log_message(LOG_LEVEL_TRACE, "Starting LLVM code generation for %s...", module_name);
+
+    LLVMTargetMachineRef target_machine = acquire_target_machine(options->opt_level);
+    if (target_machine == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Each call owns its context, so separate translation units can be compiled concurrently.
+    CodegenContext codegen;
+    codegen_context_init(&codegen, LLVMContextCreate(), module_name, options, target_machine);
+
+    int result = codegen_module(&codegen, root_node);
+    if (result == EXIT_SUCCESS)
+    {
+        result = finish_object(&codegen, target_machine, options, object);
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_INFO, "Successfully generated code for: %s", module_name);
+    }
+
+    codegen_context_dispose(&codegen);
+    release_target_machine(options->opt_level, target_machine);
+    return result;
+}
+
+int generate_partition_object(ASTNode *root_node, FunctionASTNode *const *functions, size_t function_count, const char *module_name, ObjectBuffer *object, const CodegenOptions *options)
+{
+    log_message(LOG_LEVEL_TRACE, "Starting LLVM code generation for %zu functions of %s...", function_count, module_name);
+
+    LLVMTargetMachineRef target_machine = acquire_target_machine(options->opt_level);
+    if (target_machine == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    char suffix[HASH_HEX_SIZE];
+    hash_to_hex(hash_bytes(module_name, strlen(module_name)), suffix);
+    suffix[16] = '\0';
+
+    CodegenContext codegen;
+    codegen_context_init(&codegen, LLVMContextCreate(), module_name, options, target_machine);
+    codegen.symbol_suffix = suffix;
+
+    int result = codegen_partition(&codegen, (const TranslationUnitASTNode *)root_node, functions, function_count);
+    if (result == EXIT_SUCCESS)
+    {
+        result = finish_object(&codegen, target_machine, options, object);
+    }
+
+    codegen_context_dispose(&codegen);
+    release_target_machine(options->opt_level, target_machine);
+    return result;
+}
+
+// Only main has to stay visible once every unit is in one module, which lets the
+// optimizer inline across files and drop every function it no longer calls.
+static void internalize_module(LLVMModuleRef module)
+{
+    for (LLVMValueRef function = LLVMGetFirstFunction(module); function != NULL; function = LLVMGetNextFunction(function))
+    {
+        size_t length;
+        const char *name = LLVMGetValueName2(function, &length);
+        if (!LLVMIsDeclaration(function) && strcmp(name, "main") != 0)
+        {
+            LLVMSetLinkage(function, LLVMInternalLinkage);
+            LLVMSetVisibility(function, LLVMDefaultVisibility);
+        }
+    }
+    for (LLVMValueRef global = LLVMGetFirstGlobal(module); global != NULL; global = LLVMGetNextGlobal(global))
+    {
+        size_t length;
+        const char *name = LLVMGetValueName2(global, &length);
+        if (!LLVMIsDeclaration(global) && strncmp(name, "llvm.", 5) != 0)
+        {
+            LLVMSetLinkage(global, LLVMInternalLinkage);
+            LLVMSetVisibility(global, LLVMDefaultVisibility);
+        }
+    }
+}
+
+static int link_bitcode(LLVMContextRef context, const ObjectBuffer *units, size_t unit_count, LLVMModuleRef *module)
+{
+    TimingScope timer = timing_begin("lto link", NULL);
+    int result = EXIT_SUCCESS;
+    *module = NULL;
+    for (size_t i = 0; i < unit_count && result == EXIT_SUCCESS; i++)
+    {
+        LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(units[i].data, units[i].size, "jpp-unit", 0);
+        LLVMModuleRef unit = NULL;
+        if (LLVMParseBitcodeInContext2(context, buffer, &unit))
+        {
+            log_message(LOG_LEVEL_ERROR, "Could not read the bitcode of unit %zu", i);
+            result = EXIT_FAILURE;
+        }
+        else if (*module == NULL)
+        {
+            *module = unit;
+        }
+        else if (LLVMLinkModules2(*module, unit))
+        {
+            log_message(LOG_LEVEL_ERROR, "Could not link unit %zu into the LTO module", i);
+            result = EXIT_FAILURE;
+        }
+        LLVMDisposeMemoryBuffer(buffer);
+    }
+    timing_end(&timer);
+    return *module != NULL ? result : EXIT_FAILURE;
+}
+
+int link_time_optimize(const ObjectBuffer *units, size_t unit_count, ObjectBuffer *object, const CodegenOptions *options)
+{
+    log_message(LOG_LEVEL_TRACE, "Optimizing %zu units together...", unit_count);
+    LLVMTargetMachineRef target_machine = acquire_target_machine(options->opt_level);
+    if (target_machine == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    LLVMContextRef context = LLVMContextCreate();
+    LLVMModuleRef module = NULL;
+    int result = link_bitcode(context, units, unit_count, &module);
+    if (result == EXIT_SUCCESS)
+    {
+        internalize_module(module);
+        configure_module_for_target(module, target_machine);
+        result = optimize_module(module, target_machine, options->opt_level, "lto");
+    }
+    if (result == EXIT_SUCCESS && log_enabled(LOG_LEVEL_TRACE))
+    {
+        flush_logger();
+        LLVMDumpModule(module);
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        result = emit_object(module, target_machine, object);
+    }
+
+    if (module != NULL)
+    {
+        LLVMDisposeModule(module);
+    }
+    LLVMContextDispose(context);
+    release_target_machine(options->opt_level, target_machine);
+    return result;
+}
+
+static int report_orc_error(LLVMErrorRef error, const char *what)
+{
+    char *message = LLVMGetErrorMessage(error);
+    log_message(LOG_LEVEL_ERROR, "%s: %s", what, message);
+    LLVMDisposeErrorMessage(message);
+    return EXIT_FAILURE;
+}
+
+static const Type *find_main_return_type(ASTNode *const *root_nodes, size_t module_count)
+{
+    for (size_t i = 0; i < module_count; i++)
+    {
+        const TranslationUnitASTNode *unit = (const TranslationUnitASTNode *)root_nodes[i];
+        for (size_t f = 0; f < unit->function_count; f++)
+        {
+            const FunctionASTNode *function = (const FunctionASTNode *)unit->functions[f];
+            if (function->body != NULL && strcmp(function->name, "main") == 0)
+            {
+                return function->return_type;
+            }
+        }
+    }
+    return type_get(TYPE_UINT8);
+}
+
+// Calls main through a pointer of its real width and keeps the low 8 bits, which is
+// what the exit status of a linked executable would carry.
+static int call_jit_main(LLVMOrcExecutorAddress main_address, const Type *return_type)
+{
+    uintptr_t address = (uintptr_t)main_address;
+    uint64_t value;
+    switch (return_type->bits)
+    {
+    case 1:
+    case 8:
+        value = ((uint8_t (*)(void))address)();
+        break;
+    case 16:
+        value = ((uint16_t (*)(void))address)();
+        break;
+    case 32:
+        value = ((uint32_t (*)(void))address)();
+        break;
+    default:
+        value = ((uint64_t (*)(void))address)();
+        break;
+    }
+    return (int)(value & 0xFF);
+}
+
+int run_jit_from_asts(ASTNode *const *root_nodes, const char *const *module_names, size_t module_count, const CodegenOptions *options, int *exit_code)
+{
+    LLVMTargetMachineRef target_machine = acquire_target_machine(options->opt_level);
+    LLVMTargetMachineRef jit_target_machine = create_target_machine(options->opt_level);
+    if (target_machine == NULL || jit_target_machine == NULL)
+    {
+        if (target_machine != NULL)
+            release_target_machine(options->opt_level, target_machine);
+        if (jit_target_machine != NULL)
+            LLVMDisposeTargetMachine(jit_target_machine);
+        return EXIT_FAILURE;
+    }
+
+    // The builder takes ownership of jit_target_machine, so the JIT compiles for
+    // exactly the CPU and codegen level the modules were optimized for.
+    LLVMOrcLLJITBuilderRef jit_builder = LLVMOrcCreateLLJITBuilder();
+    LLVMOrcLLJITBuilderSetJITTargetMachineBuilder(jit_builder, LLVMOrcJITTargetMachineBuilderCreateFromTargetMachine(jit_target_machine));
+
+    LLVMOrcLLJITRef jit;
+    LLVMErrorRef error = LLVMOrcCreateLLJIT(&jit, jit_builder);
+    if (error != NULL)
+    {
+        release_target_machine(options->opt_level, target_machine);
+        return report_orc_error(error, "Failed to create JIT");
+    }
+
+    LLVMOrcJITDylibRef main_dylib = LLVMOrcLLJITGetMainJITDylib(jit);
+    LLVMOrcDefinitionGeneratorRef process_symbols;
+    error = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&process_symbols, LLVMOrcLLJITGetGlobalPrefix(jit), NULL, NULL);
+    if (error != NULL)
+    {
+        LLVMOrcDisposeLLJIT(jit);
+        release_target_machine(options->opt_level, target_machine);
+        return report_orc_error(error, "Failed to expose process symbols to the JIT");
+    }
+    LLVMOrcJITDylibAddGenerator(main_dylib, process_symbols);
+
+    int result = EXIT_SUCCESS;
+    LLVMOrcThreadSafeContextRef thread_safe_context = LLVMOrcCreateNewThreadSafeContext();
+    for (size_t i = 0; i < module_count && result == EXIT_SUCCESS; i++)
+    {
+        log_message(LOG_LEVEL_TRACE, "Generating JIT module for %s...", module_names[i]);
+        CodegenContext codegen;
+        codegen_context_init(&codegen, LLVMOrcThreadSafeContextGetContext(thread_safe_context), module_names[i], options, target_machine);
+
+        result = codegen_module(&codegen, root_nodes[i]);
+        LLVMDisposeBuilder(codegen.builder);
+        free(codegen.locals);
+        free(codegen.profile_records);
+
+        if (result == EXIT_SUCCESS)
+        {
+            result = optimize_module(codegen.module, target_machine, options->opt_level, "default");
+        }
+        if (result != EXIT_SUCCESS)
+        {
+            LLVMDisposeModule(codegen.module);
+            break;
+        }
+        if (log_enabled(LOG_LEVEL_TRACE))
+        {
+            flush_logger();
+            LLVMDumpModule(codegen.module);
+        }
+
+        // The JIT owns the module from here on.
+        LLVMOrcThreadSafeModuleRef thread_safe_module = LLVMOrcCreateNewThreadSafeModule(codegen.module, thread_safe_context);
+        error = LLVMOrcLLJITAddLLVMIRModule(jit, main_dylib, thread_safe_module);
+        if (error != NULL)
+        {
+            LLVMOrcDisposeThreadSafeModule(thread_safe_module);
+            result = report_orc_error(error, "Failed to add module to the JIT");
+        }
+    }
+    LLVMOrcDisposeThreadSafeContext(thread_safe_context);
+    release_target_machine(options->opt_level, target_machine);
+
+    if (result == EXIT_SUCCESS)
+    {
+        LLVMOrcExecutorAddress main_address = 0;
+        // Lookup is what triggers JIT compilation of the added modules.
+        TimingScope timer = timing_begin("jit compile", NULL);
+        error = LLVMOrcLLJITLookup(jit, &main_address, "main");
+        timing_end(&timer);
+        if (error != NULL)
+        {
+            result = report_orc_error(error, "Could not find main");
+        }
+        else
+        {
+            log_message(LOG_LEVEL_TRACE, "Running main at 0x%" PRIx64, (uint64_t)main_address);
+            flush_logger();
+            TimingScope timer = timing_begin("run main", NULL);
+            *exit_code = call_jit_main(main_address, find_main_return_type(root_nodes, module_count));
+            timing_end(&timer);
+            log_message(LOG_LEVEL_INFO, "Program exited with code %d", *exit_code);
+        }
+    }
+
+    error = LLVMOrcDisposeLLJIT(jit);
+    if (error != NULL)
+    {
+        report_orc_error(error, "Failed to tear down the JIT");
+    }
+    return result;
 }
@@ -1,3 +1,67 @@
+#pragma once
+#include <stddef.h>
 #include "ast.h"
+#include "hash.h"
+#include "profile.h"
 
-void generate_code_from_ast(ASTNode *root_node, const char *output_name);
\ No newline at end of file
+typedef enum
+{
+    OPT_LEVEL_O0,
+    OPT_LEVEL_O1,
+    OPT_LEVEL_O2,
+    OPT_LEVEL_O3,
+    OPT_LEVEL_OS
+} OptLevel;
+
+typedef struct
+{
+    OptLevel opt_level;
+    // Counts how often every function runs and every branch goes each way, and
+    // appends the counts to this file when the program exits. NULL turns it off.
+    const char *profile_generate;
+    // Counts of an earlier instrumented run that set branch weights, function entry
+    // counts and hot and cold functions, or NULL.
+    const Profile *profile;
+    // Emit LLVM bitcode for link_time_optimize instead of native objects.
+    uint8_t lto;
+} CodegenOptions;
+
+// An object file held in memory. handle owns the bytes and is released by object_buffer_dispose.
+// An object that already lives in a file, such as a cached function object, has no
+// bytes and only an owned path, which is handed to the linker as is.
+typedef struct
+{
+    const char *data;
+    size_t size;
+    void *handle;
+    char *path;
+} ObjectBuffer;
+
+// Registers the native target and queries the host once per process; later calls
+// do nothing. Call it before any compile starts.
+void initialize_llvm_target();
+
+// Releases what initialize_llvm_target and later compiles kept for reuse.
+void shutdown_llvm_target();
+
+void ensure_build_directory_exists();
+
+void hash_target_description(Hasher *hasher);
+
+int generate_code_from_ast(ASTNode *root_node, const char *module_name, ObjectBuffer *object, const CodegenOptions *options);
+
+// Emits some functions of a unit into an object of their own, for incremental builds
+// and for splitting a unit across threads. Functions internal to the unit are
+// referenced through hidden symbols derived from module_name, which the objects of
+// its other functions define.
+int generate_partition_object(ASTNode *root_node, FunctionASTNode *const *functions, size_t function_count, const char *module_name, ObjectBuffer *object, const CodegenOptions *options);
+
+// Links the bitcode of every unit into one module, keeps only main visible, runs
+// the LTO pipeline over the whole program and emits it as a single object.
+int link_time_optimize(const ObjectBuffer *units, size_t unit_count, ObjectBuffer *object, const CodegenOptions *options);
+
+int object_buffer_load(const char *path, ObjectBuffer *object);
+
+void object_buffer_dispose(ObjectBuffer *object);
+
+int run_jit_from_asts(ASTNode *const *root_nodes, const char *const *module_names, size_t module_count, const CodegenOptions *options, int *exit_code);
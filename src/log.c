@@ -3,31 +3,57 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #ifdef _WIN32
 #include <windows.h>
 #endif
 
-static LoggerConfig log_config = {LOG_LEVEL_TRACE};
+#if defined(_MSC_VER) && !defined(__clang__)
+#define LOG_THREAD_LOCAL __declspec(thread)
+#else
+#define LOG_THREAD_LOCAL _Thread_local
+#endif
+
+#define LOG_OUTPUT_BUFFER_SIZE (64 * 1024)
+#define LOG_LINE_SIZE 1024
+
+LoggerConfig log_config = {LOG_LEVEL_INFO};
+
+static LogSink log_sink = NULL;
+static void *log_sink_data = NULL;
+
+static char output_buffer[LOG_OUTPUT_BUFFER_SIZE];
 
-void get_timestamp(char *buffer, size_t size)
+// localtime/strftime only run when the wall clock second changes.
+static LOG_THREAD_LOCAL time_t cached_time = (time_t)-1;
+static LOG_THREAD_LOCAL char cached_timestamp[20];
+
+static const char *get_timestamp(void)
 {
     time_t now = time(NULL);
+    if (now == cached_time)
+    {
+        return cached_timestamp;
+    }
+
     struct tm *t = localtime(&now);
     if (t == NULL)
     {
         // Fallback in case localtime fails
-        snprintf(buffer, size, "Unknown Time");
-        return;
+        snprintf(cached_timestamp, sizeof(cached_timestamp), "Unknown Time");
+        return cached_timestamp;
     }
-    strftime(buffer, size, "%Y-%m-%d %H:%M:%S", t);
+    strftime(cached_timestamp, sizeof(cached_timestamp), "%Y-%m-%d %H:%M:%S", t);
+    cached_time = now;
+    return cached_timestamp;
 }
 
 uint8_t init_logger(LogLevel level)
 {
 #ifdef _WIN32
-    HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    HANDLE hOut = GetStdHandle(STD_ERROR_HANDLE);
     if (hOut == INVALID_HANDLE_VALUE)
         return 0;
 
@@ -38,6 +64,8 @@ uint8_t init_logger(LogLevel level)
     dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
     SetConsoleMode(hOut, dwMode);
 #endif
+    setvbuf(stderr, output_buffer, _IOFBF, sizeof(output_buffer));
+    atexit(flush_logger);
     log_config.level = level;
     return 1;
 }
@@ -47,46 +75,76 @@ void set_logger_level(LogLevel level)
     log_config.level = level;
 }
 
-void log_message(LogLevel level, const char *format, ...)
+void flush_logger(void)
 {
-    if (level < log_config.level)
-        return;
+    fflush(stderr);
+}
 
-    char timestamp[20];
-    get_timestamp(timestamp, sizeof(timestamp));
+void set_log_sink(LogSink sink, void *user_data)
+{
+    log_sink = sink;
+    log_sink_data = user_data;
+}
 
-    const char *color;
-    const char *level_str;
+const char *log_level_name(LogLevel level)
+{
+    switch (level)
+    {
+    case LOG_LEVEL_TRACE:
+        return "TRACE";
+    case LOG_LEVEL_INFO:
+        return "INFO";
+    case LOG_LEVEL_WARN:
+        return "WARNING";
+    case LOG_LEVEL_ERROR:
+        return "ERROR";
+    default:
+        return "UNKNOWN";
+    }
+}
 
+void log_write(LogLevel level, const char *format, ...)
+{
+    const char *color;
     switch (level)
     {
     case LOG_LEVEL_TRACE:
         color = BLUE;
-        level_str = "TRACE";
         break;
     case LOG_LEVEL_INFO:
         color = GREEN;
-        level_str = "INFO";
         break;
     case LOG_LEVEL_WARN:
         color = YELLOW;
-        level_str = "WARNING";
         break;
     case LOG_LEVEL_ERROR:
         color = RED;
-        level_str = "ERROR";
         break;
     default:
         color = RESET;
-        level_str = "UNKNOWN";
     }
-    printf("[%s] ", timestamp);
-    printf("%s[%s] ", color, level_str);
+
+    char message[LOG_LINE_SIZE];
     va_list args;
     va_start(args, format);
-    vprintf(format, args);
+    int length = vsnprintf(message, sizeof(message), format, args);
     va_end(args);
+    if (length >= (int)sizeof(message))
+    {
+        memcpy(message + sizeof(message) - 4, "...", 4);
+    }
+
+    if (log_sink != NULL)
+    {
+        log_sink(level, message, log_sink_data);
+        return;
+    }
 
-    // Reset color
-    printf(RESET "\n");
-}
\ No newline at end of file
+    // One call per line keeps messages from different threads from interleaving.
+    fprintf(stderr, "[%s] %s[%s] %s" RESET "\n", get_timestamp(), color, log_level_name(level), message);
+
+    if (level >= LOG_LEVEL_WARN)
+    {
+        fflush(stderr);
+    }
+}
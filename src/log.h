@@ -15,13 +15,50 @@ typedef enum
     LOG_LEVEL_ERROR
 } LogLevel;
 
+// Messages below this level are compiled out entirely. Release builds keep INFO and
+// above; define JPP_LOG_MIN_LEVEL to override.
+#ifndef JPP_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define JPP_LOG_MIN_LEVEL LOG_LEVEL_INFO
+#else
+#define JPP_LOG_MIN_LEVEL LOG_LEVEL_TRACE
+#endif
+#endif
+
 typedef struct
 {
     LogLevel level;
 } LoggerConfig;
 
+extern LoggerConfig log_config;
+
 uint8_t init_logger(LogLevel level);
 
 void set_logger_level(LogLevel level);
 
-void log_message(LogLevel level, const char *format, ...);
\ No newline at end of file
+void flush_logger(void);
+
+// Receives every message that passes the level check in place of stderr, such as
+// the diagnostics the compile server returns to its clients. It may be called from
+// several threads at once.
+typedef void (*LogSink)(LogLevel level, const char *message, void *user_data);
+
+// Installs `sink`, or restores stderr output when it is NULL.
+void set_log_sink(LogSink sink, void *user_data);
+
+const char *log_level_name(LogLevel level);
+
+void log_write(LogLevel level, const char *format, ...);
+
+#define log_enabled(message_level) ((message_level) >= JPP_LOG_MIN_LEVEL && (message_level) >= log_config.level)
+
+// The level check happens before any argument is evaluated, so disabled messages
+// cost a compare (or nothing at all when below JPP_LOG_MIN_LEVEL).
+#define log_message(level, ...)              \
+    do                                       \
+    {                                        \
+        if (log_enabled(level))              \
+        {                                    \
+            log_write((level), __VA_ARGS__); \
+        }                                    \
+    } while (0)
@@ -5,11 +5,11 @@
 
 int main(int argc, char *argv[])
 {
-    if (!init_logger(LOG_LEVEL_TRACE))
+    if (!init_logger(LOG_LEVEL_INFO))
     {
         printf("Logger could not be initialized :(");
         return EXIT_FAILURE;
     }
-    log_message(LOG_LEVEL_INFO, "Logger initialized");
+    log_message(LOG_LEVEL_TRACE, "Logger initialized");
     return jpp_cli_init(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "profile.h"
+#include "log.h"
+#include "source.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+void profile_function_key(const FunctionASTNode *function, char key[HASH_HEX_SIZE])
+{
+    Hasher hasher;
+    hasher_init(&hasher);
+    hasher_update_string(&hasher, function->name);
+    hasher_update(&hasher, &function->source_hash, sizeof(function->source_hash));
+    hash_to_hex(hasher_finish(&hasher), key);
+}
+
+static size_t profile_slot(const Profile *profile, const char *key)
+{
+    Hash128 hash = hash_bytes(key, HASH_HEX_SIZE - 1);
+    size_t slot = (size_t)hash.low & (profile->capacity - 1);
+    while (profile->entries[slot].counts != NULL && memcmp(profile->entries[slot].key, key, HASH_HEX_SIZE) != 0)
+    {
+        slot = (slot + 1) & (profile->capacity - 1);
+    }
+    return slot;
+}
+
+static int profile_grow(Profile *profile)
+{
+    size_t capacity = profile->capacity == 0 ? 256 : profile->capacity * 2;
+    ProfileEntry *entries = (ProfileEntry *)calloc(capacity, sizeof(ProfileEntry));
+    if (entries == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    ProfileEntry *old_entries = profile->entries;
+    size_t old_capacity = profile->capacity;
+    profile->entries = entries;
+    profile->capacity = capacity;
+    for (size_t i = 0; i < old_capacity; i++)
+    {
+        if (old_entries[i].counts != NULL)
+        {
+            profile->entries[profile_slot(profile, old_entries[i].key)] = old_entries[i];
+        }
+    }
+    free(old_entries);
+    return EXIT_SUCCESS;
+}
+
+// Adds one line's counts, summing them into an earlier line of the same function.
+static int profile_add(Profile *profile, const char *key, const uint64_t *counts, size_t count)
+{
+    if ((profile->entry_count + 1) * 4 > profile->capacity * 3 && profile_grow(profile) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    ProfileEntry *entry = &profile->entries[profile_slot(profile, key)];
+    if (entry->counts != NULL)
+    {
+        if (entry->count != count)
+        {
+            log_message(LOG_LEVEL_WARN, "Ignoring counts of %s with %zu instead of %zu counters", key, count, entry->count);
+            return EXIT_SUCCESS;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            entry->counts[i] += counts[i];
+        }
+        return EXIT_SUCCESS;
+    }
+    entry->counts = (uint64_t *)malloc(count * sizeof(uint64_t));
+    if (entry->counts == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    memcpy(entry->key, key, HASH_HEX_SIZE);
+    memcpy(entry->counts, counts, count * sizeof(uint64_t));
+    entry->count = count;
+    profile->entry_count++;
+    return EXIT_SUCCESS;
+}
+
+static uint64_t parse_count(const char **cursor, const char *end, int *valid)
+{
+    const char *text = *cursor;
+    while (text < end && (*text == ' ' || *text == '\t'))
+    {
+        text++;
+    }
+    uint64_t value = 0;
+    const char *digits = text;
+    while (text < end && isdigit((unsigned char)*text))
+    {
+        uint64_t digit = (uint64_t)(*text - '0');
+        if (value > (UINT64_MAX - digit) / 10)
+        {
+            *valid = 0;
+            return 0;
+        }
+        value = value * 10 + digit;
+        text++;
+    }
+    *valid = text > digits;
+    *cursor = text;
+    return value;
+}
+
+// Each line is "<key> <counter count> <counter>...".
+static int profile_parse_line(Profile *profile, const char *line, const char *end, uint64_t **scratch, size_t *scratch_capacity)
+{
+    char key[HASH_HEX_SIZE];
+    if (end - line < HASH_HEX_SIZE - 1)
+    {
+        return EXIT_FAILURE;
+    }
+    memcpy(key, line, HASH_HEX_SIZE - 1);
+    key[HASH_HEX_SIZE - 1] = '\0';
+    const char *cursor = line + HASH_HEX_SIZE - 1;
+
+    int valid;
+    uint64_t count = parse_count(&cursor, end, &valid);
+    if (!valid || count == 0 || count > (uint64_t)(end - cursor))
+    {
+        return EXIT_FAILURE;
+    }
+    if (count > *scratch_capacity)
+    {
+        uint64_t *counts = (uint64_t *)realloc(*scratch, (size_t)count * sizeof(uint64_t));
+        if (counts == NULL)
+        {
+            return EXIT_FAILURE;
+        }
+        *scratch = counts;
+        *scratch_capacity = (size_t)count;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        (*scratch)[i] = parse_count(&cursor, end, &valid);
+        if (!valid)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+    return profile_add(profile, key, *scratch, (size_t)count);
+}
+
+int profile_load(const char *path, Profile *profile)
+{
+    memset(profile, 0, sizeof(*profile));
+    SourceBuffer file;
+    if (source_buffer_open(path, &file) != EXIT_SUCCESS)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not read profile %s", path);
+        return EXIT_FAILURE;
+    }
+    profile->hash = hash_bytes(file.data, file.size);
+
+    int result = EXIT_SUCCESS;
+    uint64_t *scratch = NULL;
+    size_t scratch_capacity = 0;
+    unsigned line_number = 1;
+    const char *end = file.data + file.size;
+    for (const char *line = file.data; line < end && result == EXIT_SUCCESS; line_number++)
+    {
+        const char *line_end = (const char *)memchr(line, '\n', (size_t)(end - line));
+        if (line_end == NULL)
+        {
+            // Every record ends with a newline, so this one was cut short, for
+            // example by a run that was killed while writing it.
+            log_message(LOG_LEVEL_WARN, "Skipping the truncated last line %u of profile %s", line_number, path);
+            break;
+        }
+        if (line_end > line && profile_parse_line(profile, line, line_end, &scratch, &scratch_capacity) != EXIT_SUCCESS)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Malformed profile %s at line %u", path, line_number);
+            result = EXIT_FAILURE;
+        }
+        line = line_end + 1;
+    }
+    free(scratch);
+    source_buffer_close(&file);
+    if (result != EXIT_SUCCESS)
+    {
+        profile_destroy(profile);
+        return result;
+    }
+
+    for (size_t i = 0; i < profile->capacity; i++)
+    {
+        if (profile->entries[i].counts != NULL)
+        {
+            uint64_t total = profile_entry_total(&profile->entries[i]);
+            profile->max_total = total > profile->max_total ? total : profile->max_total;
+        }
+    }
+    log_message(LOG_LEVEL_TRACE, "Loaded the counts of %zu functions from %s", profile->entry_count, path);
+    return EXIT_SUCCESS;
+}
+
+const ProfileEntry *profile_lookup(const Profile *profile, const char *key)
+{
+    if (profile->capacity == 0)
+    {
+        return NULL;
+    }
+    const ProfileEntry *entry = &profile->entries[profile_slot(profile, key)];
+    return entry->counts != NULL ? entry : NULL;
+}
+
+uint64_t profile_entry_total(const ProfileEntry *entry)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < entry->count; i++)
+    {
+        total += entry->counts[i];
+    }
+    return total;
+}
+
+void profile_destroy(Profile *profile)
+{
+    for (size_t i = 0; i < profile->capacity; i++)
+    {
+        free(profile->entries[i].counts);
+    }
+    free(profile->entries);
+    memset(profile, 0, sizeof(*profile));
+}
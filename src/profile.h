@@ -0,0 +1,40 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+#include "hash.h"
+
+// The counters of one function: how often it was entered, then how often each of
+// its conditional branches went each way, in codegen order.
+typedef struct
+{
+    char key[HASH_HEX_SIZE];
+    uint64_t *counts;
+    size_t count;
+} ProfileEntry;
+
+// Counts written by programs built with --profile-generate. Every run appends a
+// line per function, and lines with the same key are summed on load.
+typedef struct
+{
+    ProfileEntry *entries;
+    size_t capacity;
+    size_t entry_count;
+    // The largest sum of counters of any function, to judge which ones are hot.
+    uint64_t max_total;
+    // Hash of the whole file, so cached objects follow profile changes.
+    Hash128 hash;
+} Profile;
+
+// Names a function across runs by its name and source text, so the key does not
+// depend on how the path of its file was spelled. An edited function gets a new
+// key, so stale counts are never applied to it.
+void profile_function_key(const FunctionASTNode *function, char key[HASH_HEX_SIZE]);
+
+int profile_load(const char *path, Profile *profile);
+
+const ProfileEntry *profile_lookup(const Profile *profile, const char *key);
+
+uint64_t profile_entry_total(const ProfileEntry *entry);
+
+void profile_destroy(Profile *profile);
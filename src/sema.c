@@ -0,0 +1,1217 @@
+#include "sema.h"
+#include "log.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    LocalSymbol **items;
+    size_t count;
+    size_t capacity;
+} SymbolList;
+
+// The functions of the translation unit by name, open-addressed on the interned
+// name pointer so calls resolve in constant time even in very large units.
+typedef struct
+{
+    FunctionASTNode **slots;
+    size_t capacity;
+} FunctionTable;
+
+typedef struct
+{
+    AST *ast;
+    FunctionTable functions;
+    const FunctionASTNode *function;
+    // Symbols currently in scope, innermost last; blocks truncate it on exit.
+    SymbolList scope;
+    // Every local of the current function, in slot order.
+    SymbolList locals;
+    // The distinct functions the current function calls.
+    const FunctionASTNode **callees;
+    size_t callee_count;
+    size_t callee_capacity;
+    size_t loop_depth;
+    int result;
+} SemaContext;
+
+static int symbol_list_push(SymbolList *list, LocalSymbol *symbol)
+{
+    if (list->count == list->capacity)
+    {
+        size_t capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+        LocalSymbol **items = (LocalSymbol **)realloc(list->items, capacity * sizeof(LocalSymbol *));
+        if (items == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while checking types");
+            return EXIT_FAILURE;
+        }
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = symbol;
+    return EXIT_SUCCESS;
+}
+
+// Names are interned, so pointer equality is name equality.
+static LocalSymbol *lookup_symbol(const SemaContext *context, const char *name)
+{
+    for (size_t i = context->scope.count; i > 0; i--)
+    {
+        if (context->scope.items[i - 1]->name == name)
+        {
+            return context->scope.items[i - 1];
+        }
+    }
+    return NULL;
+}
+
+static int declare_symbol(SemaContext *context, LocalSymbol *symbol)
+{
+    symbol->slot = (uint32_t)context->locals.count;
+    if (symbol_list_push(&context->locals, symbol) != EXIT_SUCCESS || symbol_list_push(&context->scope, symbol) != EXIT_SUCCESS)
+    {
+        context->result = EXIT_FAILURE;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+static size_t function_slot(const FunctionTable *table, const char *name)
+{
+    size_t mask = table->capacity - 1;
+    size_t slot = (size_t)(((uintptr_t)name >> 3) * UINT64_C(0x9E3779B97F4A7C15) >> 32) & mask;
+    while (table->slots[slot] != NULL && table->slots[slot]->name != name)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static const FunctionASTNode *lookup_function(const SemaContext *context, const char *name)
+{
+    return context->functions.slots[function_slot(&context->functions, name)];
+}
+
+static void add_callee(SemaContext *context, const FunctionASTNode *function)
+{
+    for (size_t i = 0; i < context->callee_count; i++)
+    {
+        if (context->callees[i] == function)
+        {
+            return;
+        }
+    }
+    if (context->callee_count == context->callee_capacity)
+    {
+        size_t capacity = context->callee_capacity == 0 ? 16 : context->callee_capacity * 2;
+        const FunctionASTNode **callees = (const FunctionASTNode **)realloc((void *)context->callees, capacity * sizeof(FunctionASTNode *));
+        if (callees == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while checking types");
+            context->result = EXIT_FAILURE;
+            return;
+        }
+        context->callees = callees;
+        context->callee_capacity = capacity;
+    }
+    context->callees[context->callee_count++] = function;
+}
+
+static void add_inline_callees(SemaContext *context, const FunctionASTNode *root, const FunctionASTNode *function)
+{
+    for (size_t i = 0; i < function->callee_count; i++)
+    {
+        const FunctionASTNode *callee = function->callees[i];
+        if ((callee->flags & FUNCTION_INLINE) && callee->body != NULL && callee != root)
+        {
+            add_callee(context, callee);
+        }
+    }
+}
+
+// Follows calls through inline functions, whose bodies end up in every caller.
+static void collect_inline_callees(SemaContext *context, FunctionASTNode *function)
+{
+    context->callee_count = 0;
+    add_inline_callees(context, function, function);
+    for (size_t i = 0; i < context->callee_count; i++)
+    {
+        add_inline_callees(context, function, context->callees[i]);
+    }
+    function->inline_callee_count = context->callee_count;
+    if (function->inline_callee_count > 0)
+    {
+        function->inline_callees = (const FunctionASTNode **)arena_alloc(&context->ast->arena, function->inline_callee_count * sizeof(FunctionASTNode *));
+        memcpy((void *)function->inline_callees, (const void *)context->callees, function->inline_callee_count * sizeof(FunctionASTNode *));
+    }
+}
+
+// Builtins resolve only when no function of the unit has the name, and functions
+// may not take these names.
+static const struct
+{
+    const char *name;
+    Builtin builtin;
+} builtin_names[] = {
+    {"len", BUILTIN_LEN},
+    {"shuffle", BUILTIN_SHUFFLE},
+    {"select", BUILTIN_SELECT},
+    {"reduce_add", BUILTIN_REDUCE_ADD},
+    {"reduce_mul", BUILTIN_REDUCE_MUL},
+    {"reduce_min", BUILTIN_REDUCE_MIN},
+    {"reduce_max", BUILTIN_REDUCE_MAX},
+    {"reduce_and", BUILTIN_REDUCE_AND},
+    {"reduce_or", BUILTIN_REDUCE_OR},
+    {"reduce_xor", BUILTIN_REDUCE_XOR},
+    {"vload", BUILTIN_VLOAD},
+    {"vstore", BUILTIN_VSTORE},
+};
+
+static Builtin lookup_builtin(const char *name)
+{
+    for (size_t i = 0; i < sizeof(builtin_names) / sizeof(builtin_names[0]); i++)
+    {
+        if (strcmp(builtin_names[i].name, name) == 0)
+        {
+            return builtin_names[i].builtin;
+        }
+    }
+    return BUILTIN_NONE;
+}
+
+int sema_is_builtin(const char *name)
+{
+    return lookup_builtin(name) != BUILTIN_NONE;
+}
+
+static int same_signature(const FunctionASTNode *a, const FunctionASTNode *b)
+{
+    if (a->return_type != b->return_type || a->parameter_count != b->parameter_count)
+    {
+        return 0;
+    }
+    for (size_t i = 0; i < a->parameter_count; i++)
+    {
+        if (((const ParameterASTNode *)a->parameters[i])->local.type != ((const ParameterASTNode *)b->parameters[i])->local.type)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void check_signature(SemaContext *context, const FunctionASTNode *function)
+{
+    int is_main = strcmp(function->name, "main") == 0;
+    // main's result becomes the process exit status.
+    if (is_main && !type_is_integer(function->return_type) && function->return_type->kind != TYPE_BOOL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: main must return an integer type, not %s", function->return_type->name);
+        context->result = EXIT_FAILURE;
+    }
+    if (is_main && function->parameter_count > 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: main takes no parameters at line %u", function->base.line);
+        context->result = EXIT_FAILURE;
+    }
+    if (lookup_builtin(function->name) != BUILTIN_NONE)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: '%s' is a builtin function and cannot be redefined at line %u", function->name, function->base.line);
+        context->result = EXIT_FAILURE;
+    }
+    if ((function->flags & FUNCTION_INLINE) && (function->flags & FUNCTION_NOINLINE))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Function '%s' cannot be both inline and noinline", function->name);
+        context->result = EXIT_FAILURE;
+    }
+    if ((function->flags & FUNCTION_EXTERN) && (function->flags & (FUNCTION_INLINE | FUNCTION_NOINLINE | FUNCTION_EXPORT)))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: extern function '%s' cannot be export, inline or noinline", function->name);
+        context->result = EXIT_FAILURE;
+    }
+    // Arrays are values without a register representation; slices are passed instead.
+    if (function->return_type->kind == TYPE_ARRAY)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Function '%s' cannot return the array type %s; return a slice instead", function->name, function->return_type->name);
+        context->result = EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < function->parameter_count; i++)
+    {
+        const LocalSymbol *parameter = &((const ParameterASTNode *)function->parameters[i])->local;
+        if (parameter->type->kind == TYPE_ARRAY)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Parameter '%s' cannot have the array type %s at line %u; pass a slice instead", parameter->name, parameter->type->name, parameter->line);
+            context->result = EXIT_FAILURE;
+        }
+    }
+}
+
+// Collects every signature before any body is checked, so functions can call each
+// other regardless of their order in the file. An extern declaration may be
+// repeated or followed by the definition if the signatures agree.
+static int collect_functions(SemaContext *context, TranslationUnitASTNode *unit)
+{
+    FunctionTable *table = &context->functions;
+    table->capacity = 16;
+    while (table->capacity < unit->function_count * 2)
+    {
+        table->capacity *= 2;
+    }
+    table->slots = (FunctionASTNode **)calloc(table->capacity, sizeof(FunctionASTNode *));
+    if (table->slots == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while checking types");
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < unit->function_count; i++)
+    {
+        FunctionASTNode *function = (FunctionASTNode *)unit->functions[i];
+        check_signature(context, function);
+        size_t slot = function_slot(table, function->name);
+        FunctionASTNode *previous = table->slots[slot];
+        if (previous == NULL)
+        {
+            table->slots[slot] = function;
+            continue;
+        }
+        if ((previous->body != NULL && function->body != NULL) || !same_signature(previous, function))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Function '%s' at line %u conflicts with its definition at line %u", function->name, function->base.line, previous->base.line);
+            context->result = EXIT_FAILURE;
+        }
+        else if (function->body != NULL)
+        {
+            table->slots[slot] = function;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+static const Type *check_expression(SemaContext *context, ASTNode *node, const Type *expected);
+
+static const Type *infer_expression(SemaContext *context, ASTNode *node, const Type *expected);
+
+static const Type *sema_error_type(SemaContext *context)
+{
+    context->result = EXIT_FAILURE;
+    return NULL;
+}
+
+static int is_comparison(BinaryOperator op)
+{
+    return op >= BINARY_EQ;
+}
+
+// Literal arithmetic with no typed operand anywhere, such as 2 * (3 + 4). These take
+// their type from the other operand or the context instead of imposing one.
+static int is_untyped_constant(const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_LITERAL:
+        return ((const LiteralASTNode *)node)->kind != LITERAL_BOOL;
+    case AST_UNARY:
+    {
+        const UnaryASTNode *unary = (const UnaryASTNode *)node;
+        return unary->op != UNARY_NOT && is_untyped_constant(unary->operand);
+    }
+    case AST_BINARY:
+    {
+        const BinaryASTNode *binary = (const BinaryASTNode *)node;
+        return !is_comparison(binary->op) && is_untyped_constant(binary->left) && is_untyped_constant(binary->right);
+    }
+    default:
+        return 0;
+    }
+}
+
+static int contains_float_literal(const ASTNode *node)
+{
+    switch (node->type)
+    {
+    case AST_LITERAL:
+        return ((const LiteralASTNode *)node)->kind == LITERAL_FLOAT;
+    case AST_UNARY:
+        return contains_float_literal(((const UnaryASTNode *)node)->operand);
+    case AST_BINARY:
+        return contains_float_literal(((const BinaryASTNode *)node)->left) || contains_float_literal(((const BinaryASTNode *)node)->right);
+    default:
+        return 0;
+    }
+}
+
+static const Type *check_literal(SemaContext *context, LiteralASTNode *literal, const Type *expected, int negated)
+{
+    if (literal->kind == LITERAL_BOOL)
+    {
+        return type_get(TYPE_BOOL);
+    }
+    if (literal->kind == LITERAL_FLOAT)
+    {
+        return expected != NULL && type_is_float(expected) ? expected : type_get(TYPE_F64);
+    }
+
+    const Type *type = expected != NULL && type_is_numeric(expected) ? expected : type_get(TYPE_INT32);
+    if (type_is_float(type))
+    {
+        literal->kind = LITERAL_FLOAT;
+        literal->float_value = (double)literal->value;
+        return type;
+    }
+
+    // A negated literal may reach one past the positive range of a signed type.
+    uint64_t limit = type->is_signed ? (UINT64_C(1) << (type->bits - 1)) - (negated ? 0 : 1) : (type->bits == 64 ? UINT64_MAX : (UINT64_C(1) << type->bits) - 1);
+    if (literal->value > limit)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Literal %s%llu does not fit in %s at line %u", negated ? "-" : "", (unsigned long long)literal->value, type->name, literal->base.line);
+        return sema_error_type(context);
+    }
+    literal->value = type_wrap_integer(type, literal->value);
+    return type;
+}
+
+static const Type *check_unary(SemaContext *context, UnaryASTNode *unary, const Type *expected)
+{
+    if (unary->op == UNARY_NOT)
+    {
+        const Type *type = check_expression(context, unary->operand, NULL);
+        if (type != NULL && type_lane(type)->kind != TYPE_BOOL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Operator '!' cannot be applied to %s at line %u", type->name, unary->base.line);
+            return sema_error_type(context);
+        }
+        return type;
+    }
+
+    const Type *type;
+    if (unary->op == UNARY_NEGATE && unary->operand->type == AST_LITERAL)
+    {
+        type = check_literal(context, (LiteralASTNode *)unary->operand, expected, 1);
+        unary->operand->value_type = type;
+    }
+    else
+    {
+        type = check_expression(context, unary->operand, expected);
+    }
+    if (type == NULL)
+    {
+        return NULL;
+    }
+    if (unary->op == UNARY_NEGATE ? !type_is_numeric(type_lane(type)) : !type_is_integer(type_lane(type)))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Operator '%c' cannot be applied to %s at line %u", unary->op == UNARY_NEGATE ? '-' : '~', type->name, unary->base.line);
+        return sema_error_type(context);
+    }
+    return type;
+}
+
+// Types two operands that must share a type. The operand with a type of its own is
+// checked first, so literals on either side adapt to it. A vector may be paired with
+// a scalar of its lane type, which is broadcast to every lane.
+static const Type *check_operand_pair(SemaContext *context, ASTNode *left, ASTNode *right, const Type *expected)
+{
+    ASTNode *first = left;
+    ASTNode *second = right;
+    if (is_untyped_constant(first) && !is_untyped_constant(second))
+    {
+        first = right;
+        second = left;
+    }
+    // With nothing else to go by, constants default to int32, or f64 if any
+    // literal involved is a float.
+    if (expected == NULL && is_untyped_constant(first))
+    {
+        expected = type_get(contains_float_literal(left) || contains_float_literal(right) ? TYPE_F64 : TYPE_INT32);
+    }
+    if (expected != NULL && expected->kind == TYPE_VECTOR)
+    {
+        expected = is_untyped_constant(first) ? expected->element : NULL;
+    }
+    const Type *type = check_expression(context, first, expected);
+    if (type == NULL)
+    {
+        return NULL;
+    }
+    if (is_untyped_constant(second))
+    {
+        return check_expression(context, second, type_lane(type)) != NULL ? type : NULL;
+    }
+    // `expected` only guides literals here, so a vector second operand is accepted
+    // and reconciled below.
+    const Type *other = infer_expression(context, second, type->kind == TYPE_VECTOR ? NULL : type);
+    if (other == NULL || other == type || other == type_lane(type))
+    {
+        return other != NULL ? type : NULL;
+    }
+    if (other->kind == TYPE_VECTOR && other->element == type)
+    {
+        return other;
+    }
+    log_message(LOG_LEVEL_ERROR, "Error: Type mismatch at line %u: expected %s, found %s", second->line, type->name, other->name);
+    return sema_error_type(context);
+}
+
+static const Type *check_binary(SemaContext *context, BinaryASTNode *binary, const Type *expected)
+{
+    const Type *type = check_operand_pair(context, binary->left, binary->right, is_comparison(binary->op) ? NULL : expected);
+    if (type == NULL)
+    {
+        return NULL;
+    }
+
+    const Type *lane = type_lane(type);
+    int valid;
+    switch (binary->op)
+    {
+    case BINARY_AND:
+    case BINARY_OR:
+    case BINARY_XOR:
+        valid = type_is_integer(lane) || lane->kind == TYPE_BOOL;
+        break;
+    case BINARY_SHL:
+    case BINARY_SHR:
+        valid = type_is_integer(lane);
+        break;
+    case BINARY_EQ:
+    case BINARY_NE:
+        valid = type_is_scalar(lane);
+        break;
+    default:
+        valid = type_is_numeric(lane);
+        break;
+    }
+    if (!valid)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Operands of type %s are not valid for this operator at line %u", type->name, binary->base.line);
+        return sema_error_type(context);
+    }
+    if (!is_comparison(binary->op))
+    {
+        return type;
+    }
+    // Vectors compare lane by lane into a mask.
+    return type->kind == TYPE_VECTOR ? type_vector(&context->ast->types, type_get(TYPE_BOOL), type->length) : type_get(TYPE_BOOL);
+}
+
+static const Type *check_cast(SemaContext *context, CastASTNode *cast)
+{
+    const Type *source = check_expression(context, cast->operand, NULL);
+    if (source == NULL)
+    {
+        return NULL;
+    }
+    const Type *target = cast->target_type;
+    // Vectors convert lane by lane between vectors with the same number of lanes.
+    const Type *from = type_lane(source);
+    const Type *to = type_lane(target);
+    int same_shape = source->kind == TYPE_VECTOR ? target->kind == TYPE_VECTOR && target->length == source->length : target->kind != TYPE_VECTOR;
+    int valid = same_shape && type_is_numeric(to) && (type_is_numeric(from) || (from->kind == TYPE_BOOL && type_is_integer(to)));
+    if (!valid && source != target)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot convert %s to %s at line %u", source->name, target->name, cast->base.line);
+        return sema_error_type(context);
+    }
+    return target;
+}
+
+// Expressions with a storage location: variables, elements of arrays and lanes of
+// vectors that have one, and elements of any slice.
+static int is_addressable(const ASTNode *node)
+{
+    if (node->type == AST_VARIABLE)
+    {
+        return 1;
+    }
+    if (node->type == AST_INDEX)
+    {
+        const ASTNode *sequence = ((const IndexASTNode *)node)->sequence;
+        return sequence->value_type->kind == TYPE_SLICE || is_addressable(sequence);
+    }
+    return 0;
+}
+
+// Indices and counts may be any integer type; untyped constants become uint64.
+static const Type *check_integer_operand(SemaContext *context, ASTNode *node, const char *what)
+{
+    const Type *type = check_expression(context, node, is_untyped_constant(node) ? type_get(TYPE_UINT64) : NULL);
+    if (type != NULL && !type_is_integer(type))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s must be an integer, not %s, at line %u", what, type->name, node->line);
+        return sema_error_type(context);
+    }
+    return type;
+}
+
+// Checks the sequence operand of an index, slice or len, which must be an array, a
+// slice or a vector. Arrays are never copied for these, so `needs_address` rejects
+// temporaries; vectors are indexed as values.
+static const Type *check_sequence(SemaContext *context, ASTNode *node, int needs_address)
+{
+    const Type *type = check_expression(context, node, NULL);
+    if (type == NULL)
+    {
+        return NULL;
+    }
+    if (type->kind != TYPE_ARRAY && type->kind != TYPE_SLICE && type->kind != TYPE_VECTOR)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot index a value of type %s at line %u", type->name, node->line);
+        return sema_error_type(context);
+    }
+    if (needs_address && type->kind == TYPE_ARRAY && !is_addressable(node))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot index a temporary array at line %u; bind it with let first", node->line);
+        return sema_error_type(context);
+    }
+    return type;
+}
+
+static const Type *check_index(SemaContext *context, IndexASTNode *index)
+{
+    const Type *type = check_sequence(context, index->sequence, 1);
+    if (check_integer_operand(context, index->index, "An index") == NULL || type == NULL)
+    {
+        return NULL;
+    }
+    return type->element;
+}
+
+static const Type *check_slice(SemaContext *context, SliceASTNode *slice)
+{
+    const Type *type = check_sequence(context, slice->sequence, 1);
+    if (type != NULL && type->kind == TYPE_VECTOR)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Cannot slice the vector type %s at line %u", type->name, slice->base.line);
+        type = sema_error_type(context);
+    }
+    int valid = type != NULL;
+    if (slice->start != NULL && check_integer_operand(context, slice->start, "A slice bound") == NULL)
+    {
+        valid = 0;
+    }
+    if (slice->end != NULL && check_integer_operand(context, slice->end, "A slice bound") == NULL)
+    {
+        valid = 0;
+    }
+    return valid ? type_slice(&context->ast->types, type->element) : NULL;
+}
+
+// The element type comes from the expected array type if there is one, and
+// otherwise from the first element.
+static const Type *check_array_literal(SemaContext *context, ArrayLiteralASTNode *array, const Type *expected)
+{
+    const Type *element = expected != NULL && expected->kind == TYPE_ARRAY ? expected->element : NULL;
+    if (array->repeat_value != NULL)
+    {
+        element = check_expression(context, array->repeat_value, element);
+        return element != NULL ? type_array(&context->ast->types, element, array->repeat_count) : NULL;
+    }
+    // As with operand pairs, a typed element decides the type of untyped ones.
+    size_t first = 0;
+    if (element == NULL)
+    {
+        while (first < array->element_count && is_untyped_constant(array->elements[first]))
+        {
+            first++;
+        }
+        if (first == array->element_count)
+        {
+            first = 0;
+            element = type_get(TYPE_INT32);
+            for (size_t i = 0; i < array->element_count; i++)
+            {
+                if (contains_float_literal(array->elements[i]))
+                {
+                    element = type_get(TYPE_F64);
+                }
+            }
+        }
+    }
+    element = check_expression(context, array->elements[first], element);
+    if (element == NULL)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < array->element_count; i++)
+    {
+        if (i != first && check_expression(context, array->elements[i], element) == NULL)
+        {
+            return NULL;
+        }
+    }
+    return type_array(&context->ast->types, element, array->element_count);
+}
+
+static const Type *check_new(SemaContext *context, NewASTNode *node)
+{
+    if (check_integer_operand(context, node->count, "An array length") == NULL)
+    {
+        return NULL;
+    }
+    return type_slice(&context->ast->types, node->element_type);
+}
+
+// vecN<T>(x) broadcasts x; otherwise there is one value per lane.
+static const Type *check_vector(SemaContext *context, VectorASTNode *vector)
+{
+    const Type *type = vector->vector_type;
+    if (vector->element_count != 1 && vector->element_count != type->length)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s takes 1 or %llu values, not %zu, at line %u", type->name, (unsigned long long)type->length, vector->element_count, vector->base.line);
+        return sema_error_type(context);
+    }
+    int valid = 1;
+    for (size_t i = 0; i < vector->element_count; i++)
+    {
+        if (check_expression(context, vector->elements[i], type->element) == NULL)
+        {
+            valid = 0;
+        }
+    }
+    return valid ? type : NULL;
+}
+
+static const Type *check_vector_operand(SemaContext *context, const CallASTNode *call, ASTNode *node, const Type *expected)
+{
+    const Type *type = check_expression(context, node, expected);
+    if (type != NULL && type->kind != TYPE_VECTOR)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s expects a vector, not %s, at line %u", call->name, type->name, node->line);
+        return sema_error_type(context);
+    }
+    return type;
+}
+
+// A lane count or shuffle index, which must be an integer literal.
+static int check_constant_argument(SemaContext *context, const CallASTNode *call, ASTNode *node, uint64_t limit, uint64_t *value)
+{
+    if (node->type != AST_LITERAL || ((LiteralASTNode *)node)->kind != LITERAL_INTEGER || check_expression(context, node, type_get(TYPE_UINT32)) == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s expects an integer literal at line %u", call->name, node->line);
+        context->result = EXIT_FAILURE;
+        return EXIT_FAILURE;
+    }
+    *value = ((LiteralASTNode *)node)->value;
+    if (*value >= limit)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s argument %llu is out of range at line %u", call->name, (unsigned long long)*value, node->line);
+        context->result = EXIT_FAILURE;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// shuffle(a, indices...) or shuffle(a, b, indices...) picks lanes of a, then of b,
+// by constant index into a vector with one lane per index.
+static const Type *check_shuffle(SemaContext *context, CallASTNode *call)
+{
+    if (call->argument_count < 3)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: shuffle takes a vector and at least two lane indices at line %u", call->base.line);
+        return sema_error_type(context);
+    }
+    const Type *type = check_vector_operand(context, call, call->arguments[0], NULL);
+    if (type == NULL)
+    {
+        return NULL;
+    }
+    size_t first_index = 1;
+    uint64_t limit = type->length;
+    if (call->arguments[1]->type != AST_LITERAL)
+    {
+        if (check_expression(context, call->arguments[1], type) == NULL)
+        {
+            return NULL;
+        }
+        first_index = 2;
+        limit *= 2;
+    }
+    size_t lanes = call->argument_count - first_index;
+    if (!type_is_valid_lane_count(lanes))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: shuffle cannot make a vector of %zu lanes at line %u", lanes, call->base.line);
+        return sema_error_type(context);
+    }
+    for (size_t i = first_index; i < call->argument_count; i++)
+    {
+        uint64_t index;
+        if (check_constant_argument(context, call, call->arguments[i], limit, &index) != EXIT_SUCCESS)
+        {
+            return NULL;
+        }
+    }
+    return type_vector(&context->ast->types, type->element, lanes);
+}
+
+// select(mask, a, b) takes a where mask is true and b elsewhere, lane by lane for
+// vectors.
+static const Type *check_select(SemaContext *context, CallASTNode *call, const Type *expected)
+{
+    if (call->argument_count != 3)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: select takes a mask and two values at line %u", call->base.line);
+        return sema_error_type(context);
+    }
+    const Type *type = check_operand_pair(context, call->arguments[1], call->arguments[2], expected);
+    if (type == NULL)
+    {
+        return NULL;
+    }
+    if (call->arguments[1]->value_type != call->arguments[2]->value_type)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: select needs two values of the same type at line %u", call->base.line);
+        return sema_error_type(context);
+    }
+    const Type *mask = type->kind == TYPE_VECTOR ? type_vector(&context->ast->types, type_get(TYPE_BOOL), type->length) : type_get(TYPE_BOOL);
+    return check_expression(context, call->arguments[0], mask) != NULL ? type : NULL;
+}
+
+static const Type *check_reduce(SemaContext *context, CallASTNode *call)
+{
+    if (call->argument_count != 1)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s takes one vector at line %u", call->name, call->base.line);
+        return sema_error_type(context);
+    }
+    const Type *type = check_vector_operand(context, call, call->arguments[0], NULL);
+    if (type == NULL)
+    {
+        return NULL;
+    }
+    int bitwise = call->builtin == BUILTIN_REDUCE_AND || call->builtin == BUILTIN_REDUCE_OR || call->builtin == BUILTIN_REDUCE_XOR;
+    if (bitwise ? !type_is_integer(type->element) && type->element->kind != TYPE_BOOL : !type_is_numeric(type->element))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s cannot be applied to %s at line %u", call->name, type->name, call->base.line);
+        return sema_error_type(context);
+    }
+    return type->element;
+}
+
+// vload(s, i, N) reads the N elements of s starting at i as one vector and
+// vstore(s, i, v) writes them back; both trap unless all of them are in range.
+static const Type *check_vector_memory(SemaContext *context, CallASTNode *call)
+{
+    if (call->argument_count != 3)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s takes three arguments, not %zu, at line %u", call->name, call->argument_count, call->base.line);
+        return sema_error_type(context);
+    }
+    const Type *sequence = check_sequence(context, call->arguments[0], 1);
+    if (check_integer_operand(context, call->arguments[1], "An index") == NULL || sequence == NULL)
+    {
+        return NULL;
+    }
+    if (sequence->kind == TYPE_VECTOR || sequence->element->kind == TYPE_BOOL || !type_is_scalar(sequence->element))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: %s needs an array or slice of numbers, not %s, at line %u", call->name, sequence->name, call->base.line);
+        return sema_error_type(context);
+    }
+    if (call->builtin == BUILTIN_VSTORE)
+    {
+        const Type *type = check_vector_operand(context, call, call->arguments[2], NULL);
+        if (type != NULL && type->element != sequence->element)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Cannot store %s into %s at line %u", type->name, sequence->name, call->base.line);
+            return sema_error_type(context);
+        }
+        return type;
+    }
+    uint64_t lanes;
+    if (check_constant_argument(context, call, call->arguments[2], 65, &lanes) != EXIT_SUCCESS)
+    {
+        return NULL;
+    }
+    if (!type_is_valid_lane_count(lanes))
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Vectors have 2, 4, 8, 16, 32 or 64 lanes, not %llu, at line %u", (unsigned long long)lanes, call->base.line);
+        return sema_error_type(context);
+    }
+    return type_vector(&context->ast->types, sequence->element, lanes);
+}
+
+static const Type *check_call(SemaContext *context, CallASTNode *call, const Type *expected)
+{
+    const FunctionASTNode *function = lookup_function(context, call->name);
+    if (function != NULL)
+    {
+        call->function = function;
+        add_callee(context, function);
+        if (call->argument_count != function->parameter_count)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: '%s' takes %zu arguments, not %zu, at line %u", function->name, function->parameter_count, call->argument_count, call->base.line);
+            return sema_error_type(context);
+        }
+        int valid = 1;
+        for (size_t i = 0; i < call->argument_count; i++)
+        {
+            if (check_expression(context, call->arguments[i], ((const ParameterASTNode *)function->parameters[i])->local.type) == NULL)
+            {
+                valid = 0;
+            }
+        }
+        return valid ? function->return_type : NULL;
+    }
+
+    call->builtin = lookup_builtin(call->name);
+    switch (call->builtin)
+    {
+    case BUILTIN_NONE:
+        log_message(LOG_LEVEL_ERROR, "Error: Unknown function '%s' at line %u", call->name, call->base.line);
+        return sema_error_type(context);
+    case BUILTIN_SHUFFLE:
+        return check_shuffle(context, call);
+    case BUILTIN_SELECT:
+        return check_select(context, call, expected);
+    case BUILTIN_VLOAD:
+    case BUILTIN_VSTORE:
+        return check_vector_memory(context, call);
+    case BUILTIN_LEN:
+        break;
+    default:
+        return check_reduce(context, call);
+    }
+    if (call->argument_count != 1)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: len takes one argument, not %zu, at line %u", call->argument_count, call->base.line);
+        return sema_error_type(context);
+    }
+    return check_sequence(context, call->arguments[0], 0) != NULL ? type_get(TYPE_UINT64) : NULL;
+}
+
+// Types an expression, using `expected` only as a hint for literals.
+static const Type *infer_expression(SemaContext *context, ASTNode *node, const Type *expected)
+{
+    const Type *type = NULL;
+    switch (node->type)
+    {
+    case AST_LITERAL:
+        type = check_literal(context, (LiteralASTNode *)node, expected, 0);
+        break;
+    case AST_UNARY:
+        type = check_unary(context, (UnaryASTNode *)node, expected);
+        break;
+    case AST_BINARY:
+        type = check_binary(context, (BinaryASTNode *)node, expected);
+        break;
+    case AST_CAST:
+        type = check_cast(context, (CastASTNode *)node);
+        break;
+    case AST_INDEX:
+        type = check_index(context, (IndexASTNode *)node);
+        break;
+    case AST_SLICE:
+        type = check_slice(context, (SliceASTNode *)node);
+        break;
+    case AST_ARRAY_LITERAL:
+        type = check_array_literal(context, (ArrayLiteralASTNode *)node, expected);
+        break;
+    case AST_NEW:
+        type = check_new(context, (NewASTNode *)node);
+        break;
+    case AST_CALL:
+        type = check_call(context, (CallASTNode *)node, expected);
+        break;
+    case AST_VECTOR:
+        type = check_vector(context, (VectorASTNode *)node);
+        break;
+    case AST_VARIABLE:
+    {
+        VariableASTNode *variable = (VariableASTNode *)node;
+        variable->symbol = lookup_symbol(context, variable->name);
+        if (variable->symbol == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Unknown variable '%s' at line %u", variable->name, node->line);
+            return sema_error_type(context);
+        }
+        type = variable->symbol->type;
+        break;
+    }
+    default:
+        log_message(LOG_LEVEL_ERROR, "Error: Expected an expression at line %u", node->line);
+        return sema_error_type(context);
+    }
+    node->value_type = type;
+    return type;
+}
+
+static const Type *check_expression(SemaContext *context, ASTNode *node, const Type *expected)
+{
+    const Type *type = infer_expression(context, node, expected);
+    if (type != NULL && expected != NULL && type != expected)
+    {
+        log_message(LOG_LEVEL_ERROR, "Error: Type mismatch at line %u: expected %s, found %s", node->line, expected->name, type->name);
+        return sema_error_type(context);
+    }
+    return type;
+}
+
+static void check_statement(SemaContext *context, ASTNode *statement);
+
+static void check_block(SemaContext *context, BlockASTNode *block)
+{
+    size_t scope_start = context->scope.count;
+    for (size_t i = 0; i < block->statement_count; i++)
+    {
+        check_statement(context, block->statements[i]);
+    }
+    context->scope.count = scope_start;
+}
+
+static void check_statement(SemaContext *context, ASTNode *statement)
+{
+    switch (statement->type)
+    {
+    case AST_RETURN:
+        check_expression(context, ((ReturnASTNode *)statement)->value, context->function->return_type);
+        break;
+    case AST_LET:
+    {
+        LetASTNode *let = (LetASTNode *)statement;
+        // The initializer is checked before the name is visible, so let x = x + 1
+        // refers to an outer x.
+        let->local.type = check_expression(context, let->value, let->declared_type);
+        if (let->local.type == NULL)
+        {
+            // Declare it anyway so later uses do not cascade into more errors.
+            let->local.type = let->declared_type != NULL ? let->declared_type : type_get(TYPE_INT32);
+        }
+        declare_symbol(context, &let->local);
+        break;
+    }
+    case AST_ASSIGN:
+    {
+        AssignASTNode *assign = (AssignASTNode *)statement;
+        const Type *type = check_expression(context, assign->target, NULL);
+        if (type == NULL)
+        {
+            break;
+        }
+        if (!is_addressable(assign->target))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Cannot assign to this expression at line %u", statement->line);
+            context->result = EXIT_FAILURE;
+            break;
+        }
+        if (assign->target->type == AST_VARIABLE && !((VariableASTNode *)assign->target)->symbol->is_mutable)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Cannot assign to loop variable '%s' at line %u", ((VariableASTNode *)assign->target)->name, statement->line);
+            context->result = EXIT_FAILURE;
+            break;
+        }
+        check_expression(context, assign->value, type);
+        break;
+    }
+    case AST_IF:
+    {
+        IfASTNode *node = (IfASTNode *)statement;
+        check_expression(context, node->condition, type_get(TYPE_BOOL));
+        check_block(context, (BlockASTNode *)node->then_block);
+        if (node->else_branch != NULL)
+        {
+            check_statement(context, node->else_branch);
+        }
+        break;
+    }
+    case AST_WHILE:
+    {
+        WhileASTNode *node = (WhileASTNode *)statement;
+        check_expression(context, node->condition, type_get(TYPE_BOOL));
+        context->loop_depth++;
+        check_block(context, (BlockASTNode *)node->body);
+        context->loop_depth--;
+        break;
+    }
+    case AST_FOR:
+    {
+        ForASTNode *node = (ForASTNode *)statement;
+        const Type *type = check_operand_pair(context, node->start, node->end, NULL);
+        if (type != NULL && !type_is_integer(type))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Range bounds must be integers, not %s, at line %u", type->name, statement->line);
+            context->result = EXIT_FAILURE;
+        }
+        node->variable.type = type != NULL ? type : type_get(TYPE_INT32);
+
+        // The loop variable is scoped to the body.
+        size_t scope_start = context->scope.count;
+        declare_symbol(context, &node->variable);
+        context->loop_depth++;
+        check_block(context, (BlockASTNode *)node->body);
+        context->loop_depth--;
+        context->scope.count = scope_start;
+        break;
+    }
+    case AST_BREAK:
+    case AST_CONTINUE:
+        if (context->loop_depth == 0)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: '%s' outside of a loop at line %u", statement->type == AST_BREAK ? "break" : "continue", statement->line);
+            context->result = EXIT_FAILURE;
+        }
+        break;
+    case AST_EXPRESSION:
+    {
+        ASTNode *expression = ((ExpressionASTNode *)statement)->expression;
+        if (check_expression(context, expression, NULL) == NULL)
+        {
+            break;
+        }
+        // Calls to functions and vstore have effects; anything else would be dead.
+        if (expression->type != AST_CALL || (((CallASTNode *)expression)->function == NULL && ((CallASTNode *)expression)->builtin != BUILTIN_VSTORE))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Expression result unused at line %u", statement->line);
+            context->result = EXIT_FAILURE;
+        }
+        break;
+    }
+    case AST_DELETE:
+    {
+        const Type *type = check_expression(context, ((DeleteASTNode *)statement)->value, NULL);
+        if (type != NULL && type->kind != TYPE_SLICE)
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: delete expects a slice, not %s, at line %u", type->name, statement->line);
+            context->result = EXIT_FAILURE;
+        }
+        break;
+    }
+    case AST_BLOCK:
+        check_block(context, (BlockASTNode *)statement);
+        break;
+    default:
+        log_message(LOG_LEVEL_ERROR, "Error: Unexpected statement at line %u", statement->line);
+        context->result = EXIT_FAILURE;
+        break;
+    }
+}
+
+// Whether a break in this statement leaves the loop it is in, rather than one
+// nested inside it.
+static int breaks_out(const ASTNode *statement)
+{
+    switch (statement->type)
+    {
+    case AST_BREAK:
+        return 1;
+    case AST_IF:
+    {
+        const IfASTNode *node = (const IfASTNode *)statement;
+        return breaks_out(node->then_block) || (node->else_branch != NULL && breaks_out(node->else_branch));
+    }
+    case AST_BLOCK:
+    {
+        const BlockASTNode *block = (const BlockASTNode *)statement;
+        for (size_t i = 0; i < block->statement_count; i++)
+        {
+            if (breaks_out(block->statements[i]))
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+// Whether control can never continue past this statement: it returns on every
+// path or is a while true loop without a break.
+static int never_falls_through(const ASTNode *statement)
+{
+    switch (statement->type)
+    {
+    case AST_RETURN:
+        return 1;
+    case AST_IF:
+    {
+        const IfASTNode *node = (const IfASTNode *)statement;
+        return node->else_branch != NULL && never_falls_through(node->then_block) && never_falls_through(node->else_branch);
+    }
+    case AST_WHILE:
+    {
+        const WhileASTNode *node = (const WhileASTNode *)statement;
+        const LiteralASTNode *condition = (const LiteralASTNode *)node->condition;
+        return node->condition->type == AST_LITERAL && condition->kind == LITERAL_BOOL && condition->value != 0 && !breaks_out(node->body);
+    }
+    case AST_BLOCK:
+    {
+        const BlockASTNode *block = (const BlockASTNode *)statement;
+        for (size_t i = 0; i < block->statement_count; i++)
+        {
+            if (never_falls_through(block->statements[i]))
+            {
+                return 1;
+            }
+        }
+        return 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+int sema_check(AST *ast)
+{
+    SemaContext context;
+    memset(&context, 0, sizeof(context));
+    context.ast = ast;
+    context.result = EXIT_SUCCESS;
+
+    TranslationUnitASTNode *unit = (TranslationUnitASTNode *)ast->root;
+    if (collect_functions(&context, unit) != EXIT_SUCCESS)
+    {
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < unit->function_count; i++)
+    {
+        FunctionASTNode *function = (FunctionASTNode *)unit->functions[i];
+        if (function->body == NULL)
+        {
+            continue;
+        }
+        context.function = function;
+        context.scope.count = 0;
+        context.locals.count = 0;
+        context.callee_count = 0;
+        // Parameters take the first slots.
+        for (size_t p = 0; p < function->parameter_count; p++)
+        {
+            LocalSymbol *parameter = &((ParameterASTNode *)function->parameters[p])->local;
+            if (lookup_symbol(&context, parameter->name) != NULL)
+            {
+                log_message(LOG_LEVEL_ERROR, "Error: Duplicate parameter '%s' at line %u", parameter->name, parameter->line);
+                context.result = EXIT_FAILURE;
+            }
+            declare_symbol(&context, parameter);
+        }
+        check_block(&context, (BlockASTNode *)function->body);
+        if (!never_falls_through(function->body))
+        {
+            log_message(LOG_LEVEL_ERROR, "Error: Function '%s' can reach its end without returning a value at line %u", function->name, function->base.line);
+            context.result = EXIT_FAILURE;
+        }
+
+        function->local_count = context.locals.count;
+        if (function->local_count > 0)
+        {
+            function->locals = (LocalSymbol **)arena_alloc(&ast->arena, function->local_count * sizeof(LocalSymbol *));
+            memcpy(function->locals, context.locals.items, function->local_count * sizeof(LocalSymbol *));
+        }
+        function->callee_count = context.callee_count;
+        if (function->callee_count > 0)
+        {
+            function->callees = (const FunctionASTNode **)arena_alloc(&ast->arena, function->callee_count * sizeof(FunctionASTNode *));
+            memcpy((void *)function->callees, (const void *)context.callees, function->callee_count * sizeof(FunctionASTNode *));
+        }
+    }
+    for (size_t i = 0; i < unit->function_count && context.result == EXIT_SUCCESS; i++)
+    {
+        collect_inline_callees(&context, (FunctionASTNode *)unit->functions[i]);
+    }
+    free(context.functions.slots);
+    free(context.scope.items);
+    free(context.locals.items);
+    free((void *)context.callees);
+    return context.result;
+}
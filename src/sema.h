@@ -0,0 +1,9 @@
+#pragma once
+#include "ast.h"
+
+// Resolves the type of every expression, converting untyped literals to the type
+// their context expects, and reports type errors. Must run before fold_constants
+// and codegen, which rely on ASTNode.value_type.
+int sema_check(AST *ast);
+
+int sema_is_builtin(const char *name);
@@ -0,0 +1,292 @@
+#include "server.h"
+#include "cli.h"
+#include "driver.h"
+#include "llvm.h"
+#include "log.h"
+#include "thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef PLATFORM_WINDOWS
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#define SERVER_MAX_ARGUMENTS 256
+
+typedef struct
+{
+    FILE *output;
+    // Jobs compile files on several threads, and each of them may log.
+    Mutex lock;
+} ServerConnection;
+
+// Diagnostics are answered one per line, so line breaks inside them become spaces.
+static void server_log_sink(LogLevel level, const char *message, void *user_data)
+{
+    ServerConnection *connection = (ServerConnection *)user_data;
+    mutex_lock(&connection->lock);
+    fprintf(connection->output, "%s ", log_level_name(level));
+    for (const char *c = message; *c != '\0'; c++)
+    {
+        fputc(*c == '\n' || *c == '\r' ? ' ' : *c, connection->output);
+    }
+    fputc('\n', connection->output);
+    mutex_unlock(&connection->lock);
+}
+
+// Reads a line of any length without its line break. Returns 0 at the end of input.
+static int read_line(FILE *input, char **buffer, size_t *capacity)
+{
+    size_t length = 0;
+    for (;;)
+    {
+        if (length + 1 >= *capacity)
+        {
+            size_t new_capacity = *capacity == 0 ? 256 : *capacity * 2;
+            char *new_buffer = (char *)realloc(*buffer, new_capacity);
+            if (new_buffer == NULL)
+            {
+                log_message(LOG_LEVEL_ERROR, "Out of memory while reading a job");
+                return 0;
+            }
+            *buffer = new_buffer;
+            *capacity = new_capacity;
+        }
+        if (fgets(*buffer + length, (int)(*capacity - length), input) == NULL)
+        {
+            return length > 0;
+        }
+        length += strlen(*buffer + length);
+        if (length > 0 && (*buffer)[length - 1] == '\n')
+        {
+            (*buffer)[--length] = '\0';
+            if (length > 0 && (*buffer)[length - 1] == '\r')
+            {
+                (*buffer)[--length] = '\0';
+            }
+            return 1;
+        }
+    }
+}
+
+#ifdef PLATFORM_WINDOWS
+static int run_isolated(ServerConnection *connection, const DriverOptions *options)
+{
+    (void)connection;
+    (void)options;
+    log_message(LOG_LEVEL_ERROR, "--run is not supported in server mode on Windows");
+    return EXIT_FAILURE;
+}
+#else
+// --run executes the program inside the compiler, where a trap or crash would take
+// the server down with it, so the job runs in a child process. A child killed by a
+// signal is reported as 128 plus the signal number, like a shell does.
+static int run_isolated(ServerConnection *connection, const DriverOptions *options)
+{
+    // Pending output would otherwise be written by both processes.
+    fflush(NULL);
+    pid_t child = fork();
+    if (child < 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Failed to start a process for the job: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (child == 0)
+    {
+        // Flush every diagnostic as it is logged, in case the program dies.
+        setvbuf(connection->output, NULL, _IOLBF, BUFSIZ);
+        int result = driver_compile(options);
+        fflush(connection->output);
+        _exit(result);
+    }
+    int status;
+    while (waitpid(child, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            log_message(LOG_LEVEL_ERROR, "Failed to wait for the job: %s", strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+    if (WIFSIGNALED(status))
+    {
+        log_message(LOG_LEVEL_ERROR, "The program was terminated by signal %d", WTERMSIG(status));
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+#endif
+
+static void serve_job(ServerConnection *connection, int default_count, char *defaults[], char *line)
+{
+    char *arguments[SERVER_MAX_ARGUMENTS];
+    int count = 0;
+    for (; count < default_count && count < SERVER_MAX_ARGUMENTS; count++)
+    {
+        arguments[count] = defaults[count];
+    }
+    int result = EXIT_SUCCESS;
+    for (char *token = strtok(line, " \t"); token != NULL; token = strtok(NULL, " \t"))
+    {
+        if (count == SERVER_MAX_ARGUMENTS)
+        {
+            log_message(LOG_LEVEL_ERROR, "A job takes at most %d arguments", SERVER_MAX_ARGUMENTS);
+            result = EXIT_FAILURE;
+            break;
+        }
+        arguments[count++] = token;
+    }
+
+    // -v and -q only apply to the job that passes them.
+    LogLevel level = log_config.level;
+    DriverOptions options;
+    options.inputs = NULL;
+    options.output = NULL;
+    options.run = 0;
+    if (result == EXIT_SUCCESS)
+    {
+        result = cli_parse_arguments(count, arguments, &options);
+    }
+    if (result == EXIT_SUCCESS)
+    {
+        result = options.run ? run_isolated(connection, &options) : driver_compile(&options);
+    }
+    set_logger_level(level);
+
+    mutex_lock(&connection->lock);
+    if (result == EXIT_SUCCESS && !options.run)
+        fprintf(connection->output, "done %d build/%s\n", result, options.output);
+    else
+        fprintf(connection->output, "done %d\n", result);
+    fflush(connection->output);
+    mutex_unlock(&connection->lock);
+    free(options.inputs);
+}
+
+// Answers every job on `input`. Returns 1 if the client asked the server to quit.
+static int serve_stream(FILE *input, FILE *output, int default_count, char *defaults[])
+{
+    ServerConnection connection;
+    connection.output = output;
+    mutex_init(&connection.lock);
+    set_log_sink(server_log_sink, &connection);
+
+    char *line = NULL;
+    size_t capacity = 0;
+    int quit = 0;
+    while (!quit && read_line(input, &line, &capacity))
+    {
+        if (strcmp(line, "quit") == 0)
+        {
+            quit = 1;
+        }
+        else if (line[strspn(line, " \t")] != '\0')
+        {
+            serve_job(&connection, default_count, defaults, line);
+        }
+    }
+
+    set_log_sink(NULL, NULL);
+    free(line);
+    mutex_destroy(&connection.lock);
+    return quit;
+}
+
+#ifdef PLATFORM_WINDOWS
+static int serve_socket(const char *socket_path, int default_count, char *defaults[])
+{
+    (void)default_count;
+    (void)defaults;
+    log_message(LOG_LEVEL_ERROR, "Cannot listen on %s: socket mode is not supported on Windows, use --server with stdin", socket_path);
+    return EXIT_FAILURE;
+}
+#else
+// Clients are served one at a time, each until it closes its end.
+static int serve_socket(const char *socket_path, int default_count, char *defaults[])
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        log_message(LOG_LEVEL_ERROR, "Socket path is too long: %s", socket_path);
+        return EXIT_FAILURE;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    // A client that disconnects early must not kill the server.
+    signal(SIGPIPE, SIG_IGN);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Failed to create a socket: %s", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    // A socket left behind by an earlier server would make bind fail.
+    unlink(socket_path);
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Failed to listen on %s: %s", socket_path, strerror(errno));
+        close(listener);
+        return EXIT_FAILURE;
+    }
+    log_message(LOG_LEVEL_INFO, "Listening for compile jobs on %s", socket_path);
+
+    int result = EXIT_SUCCESS;
+    int quit = 0;
+    while (!quit)
+    {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_message(LOG_LEVEL_ERROR, "Failed to accept a client: %s", strerror(errno));
+            result = EXIT_FAILURE;
+            break;
+        }
+        int output_fd = dup(client);
+        FILE *input = fdopen(client, "r");
+        FILE *output = output_fd >= 0 ? fdopen(output_fd, "w") : NULL;
+        if (input != NULL && output != NULL)
+        {
+            quit = serve_stream(input, output, default_count, defaults);
+        }
+        else
+        {
+            log_message(LOG_LEVEL_ERROR, "Failed to open a client connection: %s", strerror(errno));
+        }
+        if (input != NULL)
+            fclose(input);
+        else
+            close(client);
+        if (output != NULL)
+            fclose(output);
+        else if (output_fd >= 0)
+            close(output_fd);
+    }
+    close(listener);
+    unlink(socket_path);
+    return result;
+}
+#endif
+
+int server_run(int argc, char *args[], const char *socket_path)
+{
+    // Paid once here rather than by every job.
+    initialize_llvm_target();
+    if (socket_path != NULL)
+    {
+        return serve_socket(socket_path, argc, args);
+    }
+    serve_stream(stdin, stdout, argc, args);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+// Serves compile jobs until end of input or a "quit" line. Each job is one line
+// of whitespace-separated arguments, as on the command line and appended to
+// `args`, which hold the server's own defaults. Diagnostics come back as
+// "<LEVEL> <message>" lines and each job ends with "done <status>", followed by
+// the executable's path when one was linked. Jobs are read from stdin and
+// answered on stdout, or from clients of a Unix socket at `socket_path`.
+int server_run(int argc, char *args[], const char *socket_path);
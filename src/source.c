@@ -0,0 +1,200 @@
+#include "source.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <sys/stat.h>
+#include <windows.h>
+#endif
+
+#ifdef PLATFORM_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Reads the whole file into one heap allocation. Used where mmap is not available
+// and as a fallback when mapping fails.
+static int source_buffer_read(const char *file, SourceBuffer *buffer)
+{
+    FILE *file_ptr = fopen(file, "rb");
+    if (file_ptr == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not open file %s", file);
+        return EXIT_FAILURE;
+    }
+
+    if (fseek(file_ptr, 0, SEEK_END) != 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not seek in file %s", file);
+        fclose(file_ptr);
+        return EXIT_FAILURE;
+    }
+    long size = ftell(file_ptr);
+    if (size < 0 || fseek(file_ptr, 0, SEEK_SET) != 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not determine the size of file %s", file);
+        fclose(file_ptr);
+        return EXIT_FAILURE;
+    }
+
+    char *data = (char *)malloc((size_t)size + 1);
+    if (data == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Out of memory while reading file %s", file);
+        fclose(file_ptr);
+        return EXIT_FAILURE;
+    }
+    size_t read = fread(data, 1, (size_t)size, file_ptr);
+    fclose(file_ptr);
+    if (read != (size_t)size)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not read file %s", file);
+        free(data);
+        return EXIT_FAILURE;
+    }
+    data[size] = '\0';
+
+    if (size == 0)
+    {
+        free(data);
+        buffer->data = "";
+        return EXIT_SUCCESS;
+    }
+    buffer->data = data;
+    buffer->size = (size_t)size;
+    buffer->mapped = 0;
+    return EXIT_SUCCESS;
+}
+
+int source_buffer_open(const char *file, SourceBuffer *buffer)
+{
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->mapped = 0;
+
+#ifdef PLATFORM_UNIX
+    int fd = open(file, O_RDONLY);
+    if (fd < 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not open file %s", file);
+        return EXIT_FAILURE;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not stat file %s", file);
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    if (info.st_size == 0)
+    {
+        close(fd);
+        buffer->data = "";
+        return EXIT_SUCCESS;
+    }
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data != MAP_FAILED)
+    {
+        madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+        buffer->data = (const char *)data;
+        buffer->size = (size_t)info.st_size;
+        buffer->mapped = 1;
+        log_message(LOG_LEVEL_TRACE, "Mapped %zu bytes from %s", buffer->size, file);
+        return EXIT_SUCCESS;
+    }
+    log_message(LOG_LEVEL_TRACE, "Could not map %s, falling back to reading it", file);
+#endif
+
+    return source_buffer_read(file, buffer);
+}
+
+void source_buffer_close(SourceBuffer *buffer)
+{
+    if (buffer->size > 0)
+    {
+#ifdef PLATFORM_UNIX
+        if (buffer->mapped)
+        {
+            munmap((void *)buffer->data, buffer->size);
+        }
+        else
+#endif
+        {
+            free((void *)buffer->data);
+        }
+    }
+    buffer->data = NULL;
+    buffer->size = 0;
+    buffer->mapped = 0;
+}
+
+int file_stamp(const char *path, FileStamp *stamp)
+{
+#ifdef PLATFORM_WINDOWS
+    struct _stat64 info;
+    if (_stat64(path, &info) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    stamp->modified = (int64_t)info.st_mtime * 1000000000;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0)
+    {
+        return EXIT_FAILURE;
+    }
+    stamp->modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+    stamp->size = (uint64_t)info.st_size;
+    return EXIT_SUCCESS;
+}
+
+static unsigned long current_process_id(void)
+{
+#ifdef PLATFORM_WINDOWS
+    return (unsigned long)GetCurrentProcessId();
+#else
+    return (unsigned long)getpid();
+#endif
+}
+
+int file_write_atomic(const char *path, const void *data, size_t size)
+{
+    char temporary_path[4096];
+    if (snprintf(temporary_path, sizeof(temporary_path), "%s.%lu.%p.tmp", path, current_process_id(), data) >= (int)sizeof(temporary_path))
+    {
+        return EXIT_FAILURE;
+    }
+
+    FILE *file = fopen(temporary_path, "wb");
+    if (file == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+    size_t written = fwrite(data, 1, size, file);
+    if (fclose(file) != 0 || written != size)
+    {
+        remove(temporary_path);
+        return EXIT_FAILURE;
+    }
+
+#ifdef PLATFORM_WINDOWS
+    int renamed = MoveFileExA(temporary_path, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    int renamed = rename(temporary_path, path) == 0;
+#endif
+    if (!renamed)
+    {
+        remove(temporary_path);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct
+{
+    const char *data;
+    size_t size;
+    uint8_t mapped;
+} SourceBuffer;
+
+// Size and modification time of a file, which tell cheaply whether it changed
+// since a file derived from it was written.
+typedef struct
+{
+    uint64_t size;
+    int64_t modified;
+} FileStamp;
+
+int source_buffer_open(const char *file, SourceBuffer *buffer);
+
+void source_buffer_close(SourceBuffer *buffer);
+
+int file_stamp(const char *path, FileStamp *stamp);
+
+// Writes under a unique temporary name and renames into place, so concurrent
+// readers and writers never observe a partially written file.
+int file_write_atomic(const char *path, const void *data, size_t size);
@@ -0,0 +1,158 @@
+#include "thread.h"
+#include "log.h"
+#include <stdlib.h>
+
+#ifndef PLATFORM_WINDOWS
+#include <unistd.h>
+#endif
+
+void mutex_init(Mutex *mutex)
+{
+#ifdef PLATFORM_WINDOWS
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutex_lock(Mutex *mutex)
+{
+#ifdef PLATFORM_WINDOWS
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void mutex_unlock(Mutex *mutex)
+{
+#ifdef PLATFORM_WINDOWS
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void mutex_destroy(Mutex *mutex)
+{
+#ifdef PLATFORM_WINDOWS
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+size_t hardware_thread_count(void)
+{
+#ifdef PLATFORM_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+#endif
+}
+
+typedef struct
+{
+    Mutex lock;
+    size_t next_job;
+    size_t job_count;
+    ThreadPoolJob job;
+    void *user_data;
+} ThreadPool;
+
+static void thread_pool_work(ThreadPool *pool)
+{
+    while (1)
+    {
+        mutex_lock(&pool->lock);
+        size_t index = pool->next_job++;
+        mutex_unlock(&pool->lock);
+
+        if (index >= pool->job_count)
+        {
+            return;
+        }
+        pool->job(index, pool->user_data);
+    }
+}
+
+#ifdef PLATFORM_WINDOWS
+static DWORD WINAPI thread_pool_entry(LPVOID argument)
+{
+    thread_pool_work((ThreadPool *)argument);
+    return 0;
+}
+#else
+static void *thread_pool_entry(void *argument)
+{
+    thread_pool_work((ThreadPool *)argument);
+    return NULL;
+}
+#endif
+
+void thread_pool_run(size_t job_count, size_t thread_count, ThreadPoolJob job, void *user_data)
+{
+    if (thread_count > job_count)
+    {
+        thread_count = job_count;
+    }
+    if (thread_count <= 1)
+    {
+        for (size_t i = 0; i < job_count; i++)
+        {
+            job(i, user_data);
+        }
+        return;
+    }
+
+    ThreadPool pool;
+    mutex_init(&pool.lock);
+    pool.next_job = 0;
+    pool.job_count = job_count;
+    pool.job = job;
+    pool.user_data = user_data;
+
+    size_t worker_count = thread_count - 1;
+#ifdef PLATFORM_WINDOWS
+    HANDLE *workers = (HANDLE *)malloc(worker_count * sizeof(HANDLE));
+#else
+    pthread_t *workers = (pthread_t *)malloc(worker_count * sizeof(pthread_t));
+#endif
+    size_t started = 0;
+    if (workers != NULL)
+    {
+        for (; started < worker_count; started++)
+        {
+#ifdef PLATFORM_WINDOWS
+            workers[started] = CreateThread(NULL, 0, thread_pool_entry, &pool, 0, NULL);
+            if (workers[started] == NULL)
+                break;
+#else
+            if (pthread_create(&workers[started], NULL, thread_pool_entry, &pool) != 0)
+                break;
+#endif
+        }
+    }
+    if (started < worker_count)
+    {
+        log_message(LOG_LEVEL_WARN, "Could only start %zu of %zu worker threads", started, worker_count);
+    }
+    log_message(LOG_LEVEL_TRACE, "Running %zu jobs on %zu threads", job_count, started + 1);
+
+    thread_pool_work(&pool);
+
+    for (size_t i = 0; i < started; i++)
+    {
+#ifdef PLATFORM_WINDOWS
+        WaitForSingleObject(workers[i], INFINITE);
+        CloseHandle(workers[i]);
+#else
+        pthread_join(workers[i], NULL);
+#endif
+    }
+    free(workers);
+    mutex_destroy(&pool.lock);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+typedef CRITICAL_SECTION Mutex;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t Mutex;
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+void mutex_init(Mutex *mutex);
+
+void mutex_lock(Mutex *mutex);
+
+void mutex_unlock(Mutex *mutex);
+
+void mutex_destroy(Mutex *mutex);
+
+size_t hardware_thread_count(void);
+
+typedef void (*ThreadPoolJob)(size_t index, void *user_data);
+
+// Runs job(0..job_count-1) on up to thread_count threads and returns once all of
+// them finished. The calling thread takes part in the work.
+void thread_pool_run(size_t job_count, size_t thread_count, ThreadPoolJob job, void *user_data);
@@ -0,0 +1,359 @@
+#include "timing.h"
+#include "log.h"
+#include "thread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef PLATFORM_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define TIMING_MAX_PHASES 64
+#define TIMING_TOP_FUNCTIONS 20
+
+typedef struct
+{
+    const char *phase;
+    char *detail;
+    double wall_start;
+    double wall_duration;
+    double cpu_duration;
+    uint64_t peak_rss_kb;
+    uint32_t thread;
+} TimingEvent;
+
+typedef struct
+{
+    uint8_t enabled;
+    uint8_t report;
+    const char *trace_path;
+    double origin;
+    Mutex lock;
+    TimingEvent *events;
+    size_t count;
+    size_t capacity;
+    uint32_t thread_count;
+} TimingState;
+
+static TimingState timing = {0};
+static THREAD_LOCAL uint32_t thread_index = 0;
+
+static double wall_seconds(void)
+{
+#ifdef PLATFORM_WINDOWS
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+// CPU time of the calling thread, so phases running on workers are attributed correctly.
+static double cpu_seconds(void)
+{
+#ifdef PLATFORM_WINDOWS
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+static uint64_t peak_rss_kb(void)
+{
+#ifdef PLATFORM_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (uint64_t)counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss / 1024;
+#else
+    return (uint64_t)usage.ru_maxrss;
+#endif
+#endif
+}
+
+void timing_enable(uint8_t report, const char *trace_path)
+{
+    if (timing.enabled)
+    {
+        return;
+    }
+    mutex_init(&timing.lock);
+    timing.enabled = 1;
+    timing.report = report;
+    timing.trace_path = trace_path;
+    timing.origin = wall_seconds();
+}
+
+uint8_t timing_enabled(void)
+{
+    return timing.enabled;
+}
+
+TimingScope timing_begin(const char *phase, const char *detail)
+{
+    TimingScope scope;
+    scope.phase = phase;
+    scope.detail = detail;
+    scope.active = timing.enabled;
+    if (scope.active)
+    {
+        scope.wall_start = wall_seconds();
+        scope.cpu_start = cpu_seconds();
+    }
+    return scope;
+}
+
+static char *copy_detail(const char *detail)
+{
+    if (detail == NULL)
+    {
+        return NULL;
+    }
+    size_t length = strlen(detail);
+    char *copy = (char *)malloc(length + 1);
+    if (copy != NULL)
+    {
+        memcpy(copy, detail, length + 1);
+    }
+    return copy;
+}
+
+void timing_end(TimingScope *scope)
+{
+    if (!scope->active)
+    {
+        return;
+    }
+    scope->active = 0;
+
+    TimingEvent event;
+    event.phase = scope->phase;
+    event.detail = copy_detail(scope->detail);
+    event.wall_start = scope->wall_start - timing.origin;
+    event.wall_duration = wall_seconds() - scope->wall_start;
+    event.cpu_duration = cpu_seconds() - scope->cpu_start;
+    event.peak_rss_kb = peak_rss_kb();
+
+    mutex_lock(&timing.lock);
+    if (thread_index == 0)
+    {
+        thread_index = ++timing.thread_count;
+    }
+    event.thread = thread_index;
+    if (timing.count == timing.capacity)
+    {
+        size_t capacity = timing.capacity == 0 ? 256 : timing.capacity * 2;
+        TimingEvent *events = (TimingEvent *)realloc(timing.events, capacity * sizeof(TimingEvent));
+        if (events == NULL)
+        {
+            mutex_unlock(&timing.lock);
+            free(event.detail);
+            return;
+        }
+        timing.events = events;
+        timing.capacity = capacity;
+    }
+    timing.events[timing.count++] = event;
+    mutex_unlock(&timing.lock);
+}
+
+typedef struct
+{
+    const char *phase;
+    size_t count;
+    double wall;
+    double cpu;
+    uint64_t peak_rss_kb;
+} PhaseSummary;
+
+static int compare_events_by_wall(const void *left, const void *right)
+{
+    const TimingEvent *a = *(const TimingEvent *const *)left;
+    const TimingEvent *b = *(const TimingEvent *const *)right;
+    return (a->wall_duration < b->wall_duration) - (a->wall_duration > b->wall_duration);
+}
+
+static void print_report(void)
+{
+    PhaseSummary phases[TIMING_MAX_PHASES];
+    size_t phase_count = 0;
+    size_t function_count = 0;
+
+    for (size_t i = 0; i < timing.count; i++)
+    {
+        TimingEvent *event = &timing.events[i];
+        if (strcmp(event->phase, "codegen function") == 0)
+        {
+            function_count++;
+        }
+        size_t p = 0;
+        while (p < phase_count && strcmp(phases[p].phase, event->phase) != 0)
+        {
+            p++;
+        }
+        if (p == phase_count)
+        {
+            if (phase_count == TIMING_MAX_PHASES)
+                continue;
+            phases[p].phase = event->phase;
+            phases[p].count = 0;
+            phases[p].wall = 0.0;
+            phases[p].cpu = 0.0;
+            phases[p].peak_rss_kb = 0;
+            phase_count++;
+        }
+        phases[p].count++;
+        phases[p].wall += event->wall_duration;
+        phases[p].cpu += event->cpu_duration;
+        if (event->peak_rss_kb > phases[p].peak_rss_kb)
+        {
+            phases[p].peak_rss_kb = event->peak_rss_kb;
+        }
+    }
+
+    flush_logger();
+    fprintf(stderr, "===-------------------------------------------------------------------------===\n");
+    fprintf(stderr, "                          jpp time report\n");
+    fprintf(stderr, "===-------------------------------------------------------------------------===\n");
+    fprintf(stderr, "  %-22s %8s %12s %12s %14s\n", "Phase", "Count", "Wall (ms)", "CPU (ms)", "Peak RSS (KB)");
+    for (size_t p = 0; p < phase_count; p++)
+    {
+        fprintf(stderr, "  %-22s %8zu %12.3f %12.3f %14llu\n", phases[p].phase, phases[p].count,
+                phases[p].wall * 1e3, phases[p].cpu * 1e3, (unsigned long long)phases[p].peak_rss_kb);
+    }
+
+    if (function_count > 0)
+    {
+        const TimingEvent **functions = (const TimingEvent **)malloc(function_count * sizeof(TimingEvent *));
+        if (functions != NULL)
+        {
+            size_t f = 0;
+            for (size_t i = 0; i < timing.count; i++)
+            {
+                if (strcmp(timing.events[i].phase, "codegen function") == 0)
+                {
+                    functions[f++] = &timing.events[i];
+                }
+            }
+            qsort(functions, function_count, sizeof(TimingEvent *), compare_events_by_wall);
+
+            size_t shown = function_count < TIMING_TOP_FUNCTIONS ? function_count : TIMING_TOP_FUNCTIONS;
+            fprintf(stderr, "\n  Slowest functions (%zu of %zu)\n", shown, function_count);
+            fprintf(stderr, "  %-40s %12s %12s\n", "Function", "Wall (ms)", "CPU (ms)");
+            for (size_t i = 0; i < shown; i++)
+            {
+                fprintf(stderr, "  %-40s %12.3f %12.3f\n", functions[i]->detail != NULL ? functions[i]->detail : "?",
+                        functions[i]->wall_duration * 1e3, functions[i]->cpu_duration * 1e3);
+            }
+            free(functions);
+        }
+    }
+    fprintf(stderr, "\n  Peak RSS: %llu KB\n", (unsigned long long)peak_rss_kb());
+    fflush(stderr);
+}
+
+static void write_json_string(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (; text != NULL && *text != '\0'; text++)
+    {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\')
+        {
+            fputc('\\', file);
+            fputc(c, file);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(file, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void write_trace(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not write trace file %s", path);
+        return;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < timing.count; i++)
+    {
+        TimingEvent *event = &timing.events[i];
+        fprintf(file, "{\"name\":");
+        write_json_string(file, event->detail != NULL ? event->detail : event->phase);
+        fprintf(file, ",\"cat\":");
+        write_json_string(file, event->phase);
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"cpu_us\":%.3f,\"peak_rss_kb\":%llu}}%s\n",
+                event->thread, event->wall_start * 1e6, event->wall_duration * 1e6, event->cpu_duration * 1e6,
+                (unsigned long long)event->peak_rss_kb, i + 1 < timing.count ? "," : "");
+    }
+    fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    if (fclose(file) != 0)
+    {
+        log_message(LOG_LEVEL_ERROR, "Could not write trace file %s", path);
+        return;
+    }
+    log_message(LOG_LEVEL_INFO, "Wrote trace to %s", path);
+}
+
+void timing_finish(void)
+{
+    if (!timing.enabled)
+    {
+        return;
+    }
+    if (timing.report)
+    {
+        print_report();
+    }
+    if (timing.trace_path != NULL)
+    {
+        write_trace(timing.trace_path);
+    }
+
+    for (size_t i = 0; i < timing.count; i++)
+    {
+        free(timing.events[i].detail);
+    }
+    free(timing.events);
+    timing.events = NULL;
+    timing.count = 0;
+    timing.capacity = 0;
+    mutex_destroy(&timing.lock);
+    timing.enabled = 0;
+}
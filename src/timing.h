@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+
+typedef struct
+{
+    const char *phase;
+    const char *detail;
+    double wall_start;
+    double cpu_start;
+    uint8_t active;
+} TimingScope;
+
+// Starts recording phase timings. report prints a summary table at timing_finish,
+// trace_path (may be NULL) receives a Chrome trace (chrome://tracing, Perfetto).
+void timing_enable(uint8_t report, const char *trace_path);
+
+uint8_t timing_enabled(void);
+
+// phase must be a string literal; detail (may be NULL) is copied.
+TimingScope timing_begin(const char *phase, const char *detail);
+
+void timing_end(TimingScope *scope);
+
+void timing_finish(void);
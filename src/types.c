@@ -0,0 +1,126 @@
+#include "types.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const Type builtin_types[TYPE_BUILTIN_COUNT] = {
+    {TYPE_BOOL, "bool", 1, 0, 0, NULL, 0},
+    {TYPE_INT8, "int8", 8, 1, 0, NULL, 0},
+    {TYPE_INT16, "int16", 16, 1, 0, NULL, 0},
+    {TYPE_INT32, "int32", 32, 1, 0, NULL, 0},
+    {TYPE_INT64, "int64", 64, 1, 0, NULL, 0},
+    {TYPE_UINT8, "uint8", 8, 0, 0, NULL, 0},
+    {TYPE_UINT16, "uint16", 16, 0, 0, NULL, 0},
+    {TYPE_UINT32, "uint32", 32, 0, 0, NULL, 0},
+    {TYPE_UINT64, "uint64", 64, 0, 0, NULL, 0},
+    {TYPE_F32, "f32", 32, 1, 1, NULL, 0},
+    {TYPE_F64, "f64", 64, 1, 1, NULL, 0},
+};
+
+const Type *type_lookup(const char *name, size_t length)
+{
+    for (size_t i = 0; i < TYPE_BUILTIN_COUNT; i++)
+    {
+        if (strlen(builtin_types[i].name) == length && memcmp(builtin_types[i].name, name, length) == 0)
+        {
+            return &builtin_types[i];
+        }
+    }
+    return NULL;
+}
+
+const Type *type_get(TypeKind kind)
+{
+    return &builtin_types[kind];
+}
+
+void type_table_init(TypeTable *table, Arena *arena)
+{
+    table->arena = arena;
+    table->types = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+static const Type *type_table_intern(TypeTable *table, TypeKind kind, const Type *element, uint64_t length)
+{
+    // Programs use a handful of composite types, so a linear scan beats hashing.
+    for (size_t i = 0; i < table->count; i++)
+    {
+        const Type *type = table->types[i];
+        if (type->kind == kind && type->element == element && type->length == length)
+        {
+            return type;
+        }
+    }
+    if (table->count == table->capacity)
+    {
+        size_t capacity = table->capacity == 0 ? 8 : table->capacity * 2;
+        Type **types = (Type **)realloc(table->types, capacity * sizeof(Type *));
+        if (types == NULL)
+        {
+            log_message(LOG_LEVEL_ERROR, "Out of memory while creating a type");
+            return NULL;
+        }
+        table->types = types;
+        table->capacity = capacity;
+    }
+
+    char name[256];
+    if (kind == TYPE_ARRAY)
+        snprintf(name, sizeof(name), "[%s; %llu]", element->name, (unsigned long long)length);
+    else if (kind == TYPE_VECTOR)
+        snprintf(name, sizeof(name), "vec%llu<%s>", (unsigned long long)length, element->name);
+    else
+        snprintf(name, sizeof(name), "[%s]", element->name);
+
+    Type *type = (Type *)arena_alloc(table->arena, sizeof(Type));
+    type->kind = kind;
+    type->name = arena_strndup(table->arena, name, strlen(name));
+    type->bits = 0;
+    type->is_signed = 0;
+    type->is_float = 0;
+    type->element = element;
+    type->length = length;
+    table->types[table->count++] = type;
+    return type;
+}
+
+const Type *type_array(TypeTable *table, const Type *element, uint64_t length)
+{
+    return type_table_intern(table, TYPE_ARRAY, element, length);
+}
+
+const Type *type_slice(TypeTable *table, const Type *element)
+{
+    return type_table_intern(table, TYPE_SLICE, element, 0);
+}
+
+const Type *type_vector(TypeTable *table, const Type *element, uint64_t lanes)
+{
+    return type_table_intern(table, TYPE_VECTOR, element, lanes);
+}
+
+void type_table_destroy(TypeTable *table)
+{
+    free(table->types);
+    table->types = NULL;
+    table->count = 0;
+    table->capacity = 0;
+}
+
+uint64_t type_wrap_integer(const Type *type, uint64_t value)
+{
+    if (type->bits >= 64)
+    {
+        return value;
+    }
+    uint64_t mask = (UINT64_C(1) << type->bits) - 1;
+    value &= mask;
+    if (type->is_signed && (value >> (type->bits - 1)) != 0)
+    {
+        value |= ~mask;
+    }
+    return value;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+typedef enum
+{
+    TYPE_BOOL,
+    TYPE_INT8,
+    TYPE_INT16,
+    TYPE_INT32,
+    TYPE_INT64,
+    TYPE_UINT8,
+    TYPE_UINT16,
+    TYPE_UINT32,
+    TYPE_UINT64,
+    TYPE_F32,
+    TYPE_F64,
+    TYPE_ARRAY,
+    TYPE_SLICE,
+    TYPE_VECTOR
+} TypeKind;
+
+#define TYPE_BUILTIN_COUNT (TYPE_F64 + 1)
+
+// Types are canonical: each builtin type has exactly one Type object and composite
+// types are unique within their TypeTable, so types can be compared with ==.
+typedef struct Type
+{
+    TypeKind kind;
+    const char *name;
+    uint8_t bits;
+    uint8_t is_signed;
+    uint8_t is_float;
+    // Arrays ([element; length]), slices ([element]) and vectors (vecN<element>,
+    // with N in length) only.
+    const struct Type *element;
+    uint64_t length;
+} Type;
+
+// Owns the array, slice and vector types of one translation unit.
+typedef struct
+{
+    Arena *arena;
+    Type **types;
+    size_t count;
+    size_t capacity;
+} TypeTable;
+
+// Resolves a type keyword, or returns NULL if the text does not name a type.
+const Type *type_lookup(const char *name, size_t length);
+
+const Type *type_get(TypeKind kind);
+
+void type_table_init(TypeTable *table, Arena *arena);
+
+const Type *type_array(TypeTable *table, const Type *element, uint64_t length);
+
+const Type *type_slice(TypeTable *table, const Type *element);
+
+// Vectors hold 2 to 64 lanes of a scalar type, a power of two.
+const Type *type_vector(TypeTable *table, const Type *element, uint64_t lanes);
+
+static inline int type_is_valid_lane_count(uint64_t lanes)
+{
+    return lanes >= 2 && lanes <= 64 && (lanes & (lanes - 1)) == 0;
+}
+
+void type_table_destroy(TypeTable *table);
+
+static inline int type_is_integer(const Type *type)
+{
+    return type->kind >= TYPE_INT8 && type->kind <= TYPE_UINT64;
+}
+
+static inline int type_is_float(const Type *type)
+{
+    return type->is_float;
+}
+
+static inline int type_is_numeric(const Type *type)
+{
+    return type_is_integer(type) || type_is_float(type);
+}
+
+// Numbers and bool: the types that fit in a register and support comparison.
+static inline int type_is_scalar(const Type *type)
+{
+    return type->kind <= TYPE_F64;
+}
+
+// The element type of a vector and the type itself otherwise; vector operations
+// are checked and lowered lane by lane.
+static inline const Type *type_lane(const Type *type)
+{
+    return type->kind == TYPE_VECTOR ? type->element : type;
+}
+
+// Arrays and vectors, whose length is part of the type.
+static inline int type_has_fixed_length(const Type *type)
+{
+    return type->kind == TYPE_ARRAY || type->kind == TYPE_VECTOR;
+}
+
+// Wraps an integer to the width of `type`: sign-extended for signed types and
+// zero-extended otherwise, so equal values always have equal bit patterns.
+uint64_t type_wrap_integer(const Type *type, uint64_t value);
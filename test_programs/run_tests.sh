@@ -0,0 +1,92 @@
+#!/bin/bash
+# Runs every program in expected.txt with --run and as -O2 executables built
+# with and without --codegen-partitions, builds them all again through one
+# --server process and compares the exit codes. Usage: run_tests.sh <path to jpp_compiler>
+if [ $# -ne 1 ]; then
+  echo "Usage: $0 <path to jpp_compiler>"
+  exit 1
+fi
+
+compiler=$(realpath "$1")
+source_dir=$(cd "$(dirname "$0")" && pwd)
+
+# Work on a copy so the executables and .jppi files stay out of the tree.
+work_dir=$(mktemp -d)
+trap 'rm -rf "$work_dir"' EXIT
+cp -r "$source_dir"/. "$work_dir"
+cd "$work_dir" || exit 1
+mkdir -p build
+
+expected=()
+inputs=()
+while read -r value files; do
+  case "$value" in
+    "" | \#*) continue ;;
+  esac
+  expected+=("$value")
+  inputs+=("$files")
+done < expected.txt
+
+matches() {
+  case "$1" in
+    trap) [ "$2" != error ] && [ "$2" -gt 128 ] ;;
+    error) [ "$2" = error ] ;;
+    *) [ "$2" = "$1" ] ;;
+  esac
+}
+
+# Prints the exit code of an executable, or "error" if it was not linked.
+# Braces keep the shell's report of a trapped program out of the output.
+run_executable() {
+  if [ -x "$1" ]; then
+    { "./$1"; } > /dev/null 2>&1
+    echo $?
+    rm -f "$1"
+  else
+    echo error
+  fi
+}
+
+failures=0
+report() {
+  if matches "$1" "$3"; then
+    echo "PASS $2"
+  else
+    echo "FAIL $2: expected $1, got $3"
+    failures=$((failures + 1))
+  fi
+}
+
+for i in "${!inputs[@]}"; do
+  { "$compiler" -q --run ${inputs[$i]}; } > /dev/null 2>&1
+  result=$?
+  # The compiler exits with 1 on errors, which a program could return as well.
+  if [ "${expected[$i]}" = error ] && [ $result -eq 1 ]; then
+    result=error
+  fi
+  report "${expected[$i]}" "--run ${inputs[$i]}" $result
+
+  "$compiler" -q -O2 --no-cache ${inputs[$i]} program > /dev/null 2>&1
+  report "${expected[$i]}" "-O2 ${inputs[$i]}" "$(run_executable build/program)"
+
+  "$compiler" -q -O2 --no-cache --codegen-partitions=4 ${inputs[$i]} program > /dev/null 2>&1
+  report "${expected[$i]}" "--codegen-partitions=4 ${inputs[$i]}" "$(run_executable build/program)"
+done
+
+for i in "${!inputs[@]}"; do
+  echo "-O2 --no-cache ${inputs[$i]} server$i"
+done | "$compiler" -q --server > server.txt 2>&1
+answers=$(grep -c '^done' server.txt)
+if [ "$answers" -ne ${#inputs[@]} ]; then
+  echo "FAIL --server: answered $answers of ${#inputs[@]} jobs"
+  failures=$((failures + 1))
+fi
+for i in "${!inputs[@]}"; do
+  report "${expected[$i]}" "--server ${inputs[$i]}" "$(run_executable build/server$i)"
+done
+
+if [ $failures -ne 0 ]; then
+  echo "$failures check(s) failed"
+  exit 1
+fi
+echo "All programs passed"